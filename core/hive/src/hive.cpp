@@ -186,7 +186,10 @@ void hive_app::run() {
 	//begin worker操作接口
 	hive.set_function("worker_update", [&](size_t to) { m_schedulor.update(); });
 	hive.set_function("worker_shutdown", [&]() { m_schedulor.shutdown(); });
+	hive.set_function("worker_wakeup_fd", [&]() { return m_schedulor.wakeup_fd(); });
 	hive.set_function("worker_broadcast", [&](lua_State* L) { return m_schedulor.broadcast(L); });
+	hive.set_function("worker_lazy_decode", [&](size_t size) { m_schedulor.lazy_decode(size); });
+	hive.set_function("worker_lazy_load", [](lua_State* L) { lworker::lazy_load_all(L, 1, 0); lua_settop(L, 1); return 1; });
 	hive.set_function("worker_setup", [&](lua_State* L, std::string_view service) {
 		m_schedulor.setup(L, service);
 		return 0;
@@ -197,6 +200,12 @@ void hive_app::run() {
 	hive.set_function("worker_call", [&](lua_State* L, std::string_view name) {
 		return m_schedulor.call(L, name);
 		});
+	hive.set_function("worker_pool_startup", [&](std::string_view name, std::string_view entry, uint32_t count) {
+		return m_schedulor.startup_pool(name, entry, count);
+		});
+	hive.set_function("worker_pool_call", [&](lua_State* L, std::string_view name, uint8_t mode, uint64_t key) {
+		return m_schedulor.pool_call(L, name, mode, key, "master");
+		});
 	
 	//end worker接口
 
@@ -0,0 +1,83 @@
+#ifndef __MPSC_RING_H__
+#define __MPSC_RING_H__
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace lworker {
+
+    //有界无锁多生产者单消费者队列(每个槽位带序号,生产者CAS抢占写入位置)
+    template<typename T>
+    class mpsc_ring {
+    public:
+        mpsc_ring(size_t capacity) {
+            size_t size = 2;
+            while (size < capacity) size <<= 1;
+            m_mask = size - 1;
+            m_cells = std::make_unique<cell[]>(size);
+            for (size_t i = 0; i < size; ++i) {
+                m_cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+        mpsc_ring(const mpsc_ring&) = delete;
+        mpsc_ring& operator = (const mpsc_ring&) = delete;
+
+        //队列满时返回false,由调用方处理背压
+        bool push(T&& value) {
+            cell* c;
+            size_t pos = m_tail.load(std::memory_order_relaxed);
+            while (true) {
+                c = &m_cells[pos & m_mask];
+                size_t seq = c->seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if (diff == 0) {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+            c->value = std::move(value);
+            c->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        //只能在消费线程调用
+        bool pop(T& value) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            cell* c = &m_cells[head & m_mask];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            if ((intptr_t)seq - (intptr_t)(head + 1) < 0) {
+                return false;
+            }
+            value = std::move(c->value);
+            c->seq.store(head + m_mask + 1, std::memory_order_release);
+            m_head.store(head + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        //近似长度,仅用于统计和背压判断
+        size_t size() {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t head = m_head.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0;
+        }
+
+        size_t capacity() { return m_mask + 1; }
+
+    private:
+        struct cell {
+            std::atomic<size_t> seq;
+            T value;
+        };
+        size_t m_mask = 0;
+        std::unique_ptr<cell[]> m_cells;
+        alignas(64) std::atomic<size_t> m_tail = 0;
+        alignas(64) std::atomic<size_t> m_head = 0;
+    };
+}
+
+#endif
@@ -1,5 +1,6 @@
 #ifndef __SCHEDULER_H__
 #define __SCHEDULER_H__
+#include <algorithm>
 #include <condition_variable>
 
 #include "worker.h"
@@ -8,13 +9,18 @@ using namespace std::chrono;
 
 namespace lworker {
 
+    //同一入口启动的一组线程
+    struct worker_pool {
+        uint32_t index = 0;
+        std::vector<std::shared_ptr<worker>> workers;
+    };
+
     class scheduler : public ischeduler
     {
     public:
         void setup(lua_State* L, std::string_view service) {
             m_service = service;
             m_lua = std::make_shared<kit_state>(L);
-            m_codec = m_lua->create_codec();
         }
 
         std::shared_ptr<worker> find_worker(std::string_view name) {
@@ -39,23 +45,134 @@ namespace lworker {
             return false;
         }
 
+        //启动count个相同入口的线程,名字为name_1...name_count
+        bool startup_pool(std::string_view name, std::string_view entry, uint32_t count) {
+            std::unique_lock<spin_mutex> lock(m_mutex);
+            if (count == 0 || m_pool_map.find(name) != m_pool_map.end()) {
+                LOG_ERROR(fmt::format("thread pool [{}] is repeat startup or empty", name));
+                return false;
+            }
+            //先检查全部线程名,避免启动一部分后失败
+            std::vector<std::string> names;
+            for (uint32_t i = 1; i <= count; ++i) {
+                auto wname = fmt::format("{}_{}", name, i);
+                if (m_worker_map.find(wname) != m_worker_map.end()) {
+                    LOG_ERROR(fmt::format("thread [{}] work is repeat startup", wname));
+                    return false;
+                }
+                names.push_back(wname);
+            }
+            auto pool = std::make_shared<worker_pool>();
+            for (auto& wname : names) {
+                auto workor = std::make_shared<worker>(this, wname, entry, m_service);
+                m_worker_map.insert(std::make_pair(wname, workor));
+                pool->workers.push_back(workor);
+                workor->startup();
+            }
+            m_pool_map.insert(std::make_pair(name, pool));
+            return true;
+        }
+
+        //按派发方式选出线程池中的一个线程,没有线程池时使用同名线程
+        //round/idle跳过发起调用的线程, hash选中自身时由调用方拒绝
+        std::shared_ptr<worker> choose_worker(std::string_view name, dispatch_mode mode, uint64_t key, std::string_view caller) {
+            std::unique_lock<spin_mutex> lock(m_mutex);
+            auto it = m_pool_map.find(name);
+            if (it == m_pool_map.end()) {
+                auto wit = m_worker_map.find(name);
+                return wit != m_worker_map.end() ? wit->second : nullptr;
+            }
+            if (it->second->workers.empty()) {
+                return nullptr;
+            }
+            auto& workers = it->second->workers;
+            size_t count = workers.size();
+            switch (mode) {
+            case dispatch_mode::round: {
+                auto target = workers[it->second->index++ % count];
+                if (count > 1 && target->name() == caller) {
+                    target = workers[it->second->index++ % count];
+                }
+                return target;
+            }
+            case dispatch_mode::idle: {
+                //从轮询位置开始找,积压相同时分散到不同线程
+                size_t start = it->second->index++ % count;
+                if (count > 1 && workers[start]->name() == caller) {
+                    start = (start + 1) % count;
+                }
+                auto target = workers[start];
+                size_t pending = target->pending();
+                for (size_t i = 1; i < count && pending > 0; ++i) {
+                    auto& workor = workers[(start + i) % count];
+                    if (workor->name() == caller) {
+                        continue;
+                    }
+                    size_t wpending = workor->pending();
+                    if (wpending < pending) {
+                        target = workor;
+                        pending = wpending;
+                    }
+                }
+                return target;
+            }
+            default:
+                return workers[key % count];
+            }
+        }
+
+        int pool_call(lua_State* L, std::string_view name, uint8_t mode, uint64_t key, std::string_view caller) {
+            auto workor = choose_worker(name, (dispatch_mode)mode, key, caller);
+            if (workor && workor->name() == caller) {
+                //线程不能派发给自己,call会等待自己的回复
+                LOG_ERROR(fmt::format("thread pool call [{}] can't dispatch to self [{}]", name, caller));
+                lua_pushboolean(L, false);
+                return 1;
+            }
+            if (workor) {
+                bool ok = workor->push(encode_msg(L, 4));
+                if (!ok) {
+                    LOG_ERROR(fmt::format("thread pool call [{}] queue is full!,pending:{}", name, workor->pending()));
+                }
+                lua_pushboolean(L, ok);
+                lua_pushinteger(L, workor->pending());
+                return 2;
+            }
+            LOG_ERROR(fmt::format("thread pool call [{}] work is not exist", name));
+            lua_pushboolean(L, false);
+            return 1;
+        }
+
+        //消息只编码一次,再拷贝到每个线程的队列
         int broadcast(lua_State* L) {
+            size_t data_len;
+            worker_msg msg = encode_msg(L, 1);
+            uint8_t* data = msg.data(&data_len);
             std::unique_lock<spin_mutex> lock(m_mutex);
             for (auto it : m_worker_map) {
-                it.second->call(L);
+                if (!it.second->push(worker_msg(data, data_len))) {
+                    LOG_ERROR(fmt::format("thread broadcast [{}] queue is full!,pending:{}", it.first, it.second->pending()));
+                }
             }
             return 0;
         }
-        
+
+        //返回是否投递成功和目标队列积压的消息数,供lua做背压判断
         int call(lua_State* L, std::string_view name) {
             if (name == "master") {
                 lua_pushboolean(L, call(L));
-                return 1;
+                lua_pushinteger(L, m_queue.size());
+                return 2;
             }
             auto workor = find_worker(name);
             if (workor) {
-                lua_pushboolean(L, workor->call(L));
-                return 1;
+                bool ok = workor->call(L);
+                if (!ok) {
+                    LOG_ERROR(fmt::format("thread call [{}] queue is full!,pending:{}", name, workor->pending()));
+                }
+                lua_pushboolean(L, ok);
+                lua_pushinteger(L, workor->pending());
+                return 2;
             }
             LOG_ERROR(fmt::format("thread call [{}] work is not exist", name));
             lua_pushboolean(L, false);
@@ -63,52 +180,47 @@ namespace lworker {
         }
 
         bool call(lua_State* L) {
-            size_t data_len;
-            std::unique_lock<spin_mutex> lock(m_mutex);
-            uint8_t* data = m_codec->encode(L, 2, &data_len);
-            uint8_t* target = m_write_buf->peek_space(data_len + sizeof(uint32_t));
-            if (target) {
-                m_write_buf->write<uint32_t>(data_len);
-                m_write_buf->push_data(data, data_len);
+            if (m_queue.push(encode_msg(L, 2))) {
+                m_wakeup.notify();
                 return true;
             }
-            LOG_ERROR(fmt::format("thread call buffer is full!,size:{}",m_write_buf->size()));
+            LOG_ERROR(fmt::format("thread call queue is full!,pending:{}", m_queue.size()));
             return false;
         }
 
         void update() {
             uint64_t clock_ms = ltimer::steady_ms();
-            if (m_read_buf->empty()) {
-                if (m_write_buf->empty()) {
-                    return;
-                }
-                std::unique_lock<spin_mutex> lock(m_mutex);
-                m_read_buf.swap(m_write_buf);
-            }
-            size_t plen = 0;
             const char* service = m_service.c_str();
-            slice* slice = read_slice(m_read_buf, &plen);
-            while (slice) {
-                m_codec->set_slice(slice);
-                m_lua->table_call(service, "on_scheduler", nullptr, m_codec, std::tie());
-                if (m_codec->failed()) {
-                    m_read_buf->clean();
-                    break;
-                }
-                m_read_buf->pop_size(plen);
+            worker_msg msg;
+            m_wakeup.reset();
+            while (m_queue.pop(msg)) {
+                m_codec.set_msg(&msg);
+                m_lua->table_call(service, "on_scheduler", nullptr, &m_codec, std::tie());
                 if (ltimer::steady_ms() - clock_ms > 100) {
-                    LOG_WARN(fmt::format("on_scheduler is busy,remain:{}", m_read_buf->size()));
+                    LOG_WARN(fmt::format("on_scheduler is busy,remain:{}", m_queue.size()));
                     break;
                 }
-                slice = read_slice(m_read_buf, &plen);
             }
         }
 
+        void lazy_decode(size_t size) {
+            m_codec.set_lazy(size);
+        }
+
+        int wakeup_fd() {
+            return m_wakeup.fd();
+        }
+
         void destory(std::string_view name) {
             std::unique_lock<spin_mutex> lock(m_mutex);
             auto it = m_worker_map.find(name);
             if (it != m_worker_map.end()) {
+                auto workor = it->second;
                 m_worker_map.erase(it);
+                for (auto& [_, pool] : m_pool_map) {
+                    auto& workers = pool->workers;
+                    workers.erase(std::remove(workers.begin(), workers.end(), workor), workers.end());
+                }
             }
         }
 
@@ -118,16 +230,18 @@ namespace lworker {
                 it.second->stop();
             }
             m_worker_map.clear();
+            m_pool_map.clear();
         }
 
     private:
         spin_mutex m_mutex;
         std::string m_service;
-        codec_base* m_codec = nullptr;
+        lazy_codec m_codec;
         std::shared_ptr<kit_state> m_lua = nullptr;        
-        std::shared_ptr<luabuf> m_read_buf = std::make_shared<luabuf>();
-        std::shared_ptr<luabuf> m_write_buf = std::make_shared<luabuf>();
+        worker_queue m_queue = worker_queue(WORKER_QUEUE_SIZE);
+        wakeup_event m_wakeup;
         std::map<std::string, std::shared_ptr<worker>, std::less<>> m_worker_map;
+        std::map<std::string, std::shared_ptr<worker_pool>, std::less<>> m_pool_map;
     };
 }
 
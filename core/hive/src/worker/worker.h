@@ -9,6 +9,13 @@
 #include "thread_name.hpp"
 #include "lua_kit.h"
 #include "../lualog/logger.h"
+#include "mpsc_ring.h"
+#include "worker_msg.h"
+
+#ifdef __linux
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
 
 using namespace luakit;
 
@@ -16,18 +23,10 @@ extern "C" void open_custom_libs(lua_State * L);
 
 namespace lworker {
 
-    static slice* read_slice(std::shared_ptr<luabuf> buff, size_t* pack_len) {
-        uint8_t* plen = buff->peek_data(sizeof(uint32_t));
-        if (plen) {
-            uint32_t len = *(uint32_t*)plen;
-            uint8_t* pdata = buff->peek_data(len);
-            if (pdata) {
-                *pack_len = sizeof(uint32_t) + len;
-                return buff->get_slice(len, sizeof(uint32_t));
-            }
-        }
-        return nullptr;
-    }
+    //线程消息队列长度
+    constexpr size_t WORKER_QUEUE_SIZE = 65536;
+
+    using worker_queue = mpsc_ring<worker_msg>;
 
     class spin_mutex {
     public:
@@ -44,11 +43,51 @@ namespace lworker {
         std::atomic_flag flag = ATOMIC_FLAG_INIT;
     }; //spin_mutex
 
+    //跨线程唤醒,linux下为eventfd,由消费线程的luabus监听
+    //只在消费线程未被唤醒时写入,消费线程取消息前复位
+    class wakeup_event {
+    public:
+        wakeup_event() {
+#ifdef __linux
+            m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+        }
+        ~wakeup_event() {
+#ifdef __linux
+            if (m_fd >= 0) ::close(m_fd);
+#endif
+        }
+        int fd() { return m_fd; }
+        void notify() {
+#ifdef __linux
+            if (m_fd >= 0 && !m_signaled.exchange(true, std::memory_order_acq_rel)) {
+                uint64_t value = 1;
+                while (::write(m_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+            }
+#endif
+        }
+        void reset() {
+            m_signaled.exchange(false, std::memory_order_acq_rel);
+        }
+
+    private:
+        int m_fd = -1;
+        std::atomic<bool> m_signaled = false;
+    };
+
+    //线程池派发方式
+    enum class dispatch_mode : uint8_t {
+        hash    = 0,    //按key取模,同一key有序
+        round   = 1,    //轮询
+        idle    = 2,    //积压最少
+    };
+
     class worker;
     class ischeduler {
     public:
         virtual int broadcast(lua_State* L) = 0;
         virtual int call(lua_State* L, std::string_view name) = 0;
+        virtual int pool_call(lua_State* L, std::string_view name, uint8_t mode, uint64_t key, std::string_view caller) = 0;
         virtual void destory(std::string_view name) = 0;
     };
 
@@ -71,46 +110,38 @@ namespace lworker {
         }
 
         bool call(lua_State* L) {
-            size_t data_len;
-            std::unique_lock<spin_mutex> lock(m_mutex);
-            uint8_t* data = m_codec->encode(L, 2, &data_len);
-            if (data == nullptr) {
-                return false;
-            }
-            uint8_t* target = m_write_buf->peek_space(data_len + sizeof(uint32_t));
-            if (target) {
-                m_write_buf->write<uint32_t>(data_len);
-                m_write_buf->push_data(data, data_len);
+            return push(encode_msg(L, 2));
+        }
+
+        //队列满时返回false
+        bool push(worker_msg&& msg) {
+            if (m_queue.push(std::move(msg))) {
+                m_wakeup.notify();
                 return true;
             }
             return false;
         }
 
+        const std::string& name() {
+            return m_name;
+        }
+
+        size_t pending() {
+            return m_queue.size();
+        }
+
         void update() {
             uint64_t clock_ms = ltimer::steady_ms();
-            if (m_read_buf->empty()) {
-                if (m_write_buf->empty()) {
-                    return;
-                }
-                std::unique_lock<spin_mutex> lock(m_mutex);
-                m_read_buf.swap(m_write_buf);
-            }
-            size_t plen = 0;
             const char* service = m_service.c_str();
-            slice* slice = read_slice(m_read_buf, &plen);
-            while (slice) {
-                m_codec->set_slice(slice);
-                m_lua->table_call(service, "on_worker", nullptr, m_codec, std::tie());
-                if (m_codec->failed()) {
-                    m_read_buf->clean();
-                    break;
-                }
-                m_read_buf->pop_size(plen);
+            worker_msg msg;
+            m_wakeup.reset();
+            while (m_queue.pop(msg)) {
+                m_codec.set_msg(&msg);
+                m_lua->table_call(service, "on_worker", nullptr, &m_codec, std::tie());
                 if (ltimer::steady_ms() - clock_ms > 100) {
-                    LOG_WARN(fmt::format("on_worker [{}]  is busy,remain:{}", m_name, m_read_buf->size()));
+                    LOG_WARN(fmt::format("on_worker [{}]  is busy,remain:{}", m_name, m_queue.size()));
                     break;
                 }
-                slice = read_slice(m_read_buf, &plen);
             }
         }
 
@@ -121,14 +152,17 @@ namespace lworker {
         }
 
         void run(){
-            m_codec = m_lua->create_codec();
             auto hive = m_lua->new_table(m_service.c_str());
             hive.set("pid", ::getpid());
             hive.set("title", m_name);
             hive.set_function("stop", [&]() { m_running = false; });
             hive.set_function("update", [&]() { update(); });
+            hive.set_function("wakeup_fd", [&]() { return m_wakeup.fd(); });
             hive.set_function("getenv", [&](const char* key) { return get_env(key); });
+            hive.set_function("lazy_decode", [&](size_t size) { m_codec.set_lazy(size); });
+            hive.set_function("lazy_load", [](lua_State* L) { lazy_load_all(L, 1, 0); lua_settop(L, 1); return 1; });
             hive.set_function("call", [&](lua_State* L, std::string_view name) { return m_schedulor->call(L, name); });
+            hive.set_function("pool_call", [&](lua_State* L, std::string_view name, uint8_t mode, uint64_t key) { return m_schedulor->pool_call(L, name, mode, key, m_name); });
             m_lua->run_script(g_sandbox, [&](std::string_view err) {
                 printf("worker load sandbox failed, because: %s", err.data());
                 m_schedulor->destory(m_name);
@@ -155,16 +189,15 @@ namespace lworker {
         }
 
     private:
-        spin_mutex m_mutex;
         std::thread m_thread;
         bool m_stop = false;
         bool m_running = false;
-        codec_base* m_codec = nullptr;
+        lazy_codec m_codec;
         ischeduler* m_schedulor = nullptr;
         std::string m_name, m_entry, m_service;
         std::shared_ptr<kit_state> m_lua = std::make_shared<kit_state>();
-        std::shared_ptr<luabuf> m_read_buf = std::make_shared<luabuf>();
-        std::shared_ptr<luabuf> m_write_buf = std::make_shared<luabuf>();
+        worker_queue m_queue = worker_queue(WORKER_QUEUE_SIZE);
+        wakeup_event m_wakeup;
     };
 }
 
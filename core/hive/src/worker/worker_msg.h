@@ -0,0 +1,364 @@
+#ifndef __WORKER_MSG_H__
+#define __WORKER_MSG_H__
+#include <new>
+#include <memory>
+#include <vector>
+#include "lua_kit.h"
+
+using namespace luakit;
+
+namespace lworker {
+
+    //超过该长度的消息直接接管编码缓冲,不再拷贝
+    constexpr size_t WORKER_MOVE_SIZE = 16 * 1024;
+    //编码后小于该长度的table直接解码,代理的开销比解码更大
+    constexpr size_t LAZY_TABLE_SIZE = 512;
+
+    //线程消息,只能移动: 小消息拷贝到自有内存,大消息持有编码时的luabuf
+    class worker_msg {
+    public:
+        worker_msg() = default;
+        worker_msg(const uint8_t* data, size_t len) : m_data(data, data + len) { }
+        worker_msg(std::unique_ptr<luabuf>&& buf) : m_buf(std::move(buf)) { }
+        worker_msg(worker_msg&&) = default;
+        worker_msg& operator = (worker_msg&&) = default;
+        worker_msg(const worker_msg&) = delete;
+        worker_msg& operator = (const worker_msg&) = delete;
+
+        uint8_t* data(size_t* len) {
+            if (m_buf) {
+                return m_buf->data(len);
+            }
+            *len = m_data.size();
+            return m_data.data();
+        }
+
+        size_t size() {
+            return m_buf ? m_buf->size() : m_data.size();
+        }
+
+    private:
+        std::vector<uint8_t> m_data;
+        std::unique_ptr<luabuf> m_buf;
+    };
+
+    //使用调用线程自己的codec编码,入队时无需加锁
+    inline worker_msg encode_msg(lua_State* L, int index) {
+        thread_local std::unique_ptr<luabuf> buf = std::make_unique<luabuf>();
+        thread_local luacodec codec;
+        size_t len;
+        //延迟解码需要单独解码每个字段,不复用字符串
+        codec.set_intern(false);
+        codec.set_buff(buf.get());
+        uint8_t* data = codec.encode(L, index, &len);
+        if (len < WORKER_MOVE_SIZE) {
+            return worker_msg(data, len);
+        }
+        //大消息把缓冲整个交给接收方,本线程换一块新的
+        worker_msg msg(std::move(buf));
+        buf = std::make_unique<luabuf>();
+        return msg;
+    }
+
+    //跳过一个已编码的值
+    inline void skip_value(slice* slice, uint8_t type) {
+        size_t len = 0;
+        switch (type) {
+        case type_number: len = sizeof(double); break;
+        case type_int16: len = sizeof(int16_t); break;
+        case type_int32: len = sizeof(int32_t); break;
+        case type_int64: len = sizeof(int64_t); break;
+        case type_string: len = value_decode<uint16_t>(nullptr, slice); break;
+        case type_long_string: len = value_decode<uint32_t>(nullptr, slice); break;
+        case type_string_ref: len = sizeof(uint8_t); break;
+        case type_varint: varint_decode(nullptr, slice); break;
+        case type_int_array:
+        case type_array:
+        case type_tab_head:
+            if (type == type_array) {
+                uint32_t count = value_decode<uint32_t>(nullptr, slice);
+                for (uint32_t i = 0; i < count; ++i) {
+                    skip_value(slice, value_decode<uint8_t>(nullptr, slice));
+                }
+            }
+            if (type == type_int_array) {
+                uint8_t width = value_decode<uint8_t>(nullptr, slice);
+                if (slice->erase(width * varint_decode(nullptr, slice)) == nullptr) {
+                    throw std::invalid_argument("decode skip value is out of range");
+                }
+            }
+            while (true) {
+                uint8_t ktype = value_decode<uint8_t>(nullptr, slice);
+                if (ktype == type_tab_tail) break;
+                skip_value(slice, ktype);
+                skip_value(slice, value_decode<uint8_t>(nullptr, slice));
+            }
+            break;
+        default: break;
+        }
+        if (len > 0 && slice->erase(len) == nullptr) {
+            throw std::invalid_argument("decode skip value is out of range");
+        }
+    }
+
+    //延迟解码: table只记录在消息中的位置,字段在第一次访问时才解码
+    //代理table的元表: [1]消息holder(元表为LAZY_MSG_META),[2]table内容的偏移,[3]key->值偏移的索引,[4]未解码的字段数
+    //字段全部解码或被pairs/#访问后移除元表,成为普通table
+
+    inline worker_msg* lazy_msg(lua_State* L, int mt) {
+        lua_rawgeti(L, mt, 1);
+        auto msg = (worker_msg*)luaL_testudata(L, -1, LAZY_MSG_META);
+        lua_pop(L, 1);
+        return msg;
+    }
+
+    inline int lazy_index(lua_State* L);
+    inline int lazy_pairs(lua_State* L);
+    inline int lazy_len(lua_State* L);
+
+    //创建代理table,holder为消息userdata的栈位置
+    inline void lazy_table(lua_State* L, int holder, size_t pos) {
+        lua_createtable(L, 0, 0);
+        lua_createtable(L, 4, 3);
+        lua_pushvalue(L, holder);
+        lua_rawseti(L, -2, 1);
+        lua_pushinteger(L, pos);
+        lua_rawseti(L, -2, 2);
+        lua_pushcfunction(L, lazy_index);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, lazy_pairs);
+        lua_setfield(L, -2, "__pairs");
+        lua_pushcfunction(L, lazy_len);
+        lua_setfield(L, -2, "__len");
+        lua_setmetatable(L, -2);
+    }
+
+    //解码pos处的值,较大的table仍然延迟解码,整数数组直接解码
+    inline void lazy_value(lua_State* L, int mt, size_t pos) {
+        size_t len;
+        uint8_t* data = lazy_msg(L, mt)->data(&len);
+        slice mslice(data + pos, len - pos);
+        uint8_t type = value_decode<uint8_t>(L, &mslice);
+        if (type == type_tab_head || type == type_array) {
+            slice tslice = mslice.clone();
+            skip_value(&tslice, type);
+            if (tslice.head() - mslice.head() >= LAZY_TABLE_SIZE) {
+                lua_rawgeti(L, mt, 1);
+                lazy_table(L, lua_gettop(L), pos + 1);
+                lua_remove(L, -2);
+                return;
+            }
+        }
+        decode_value(L, &mslice, type);
+    }
+
+    //第一次访问时扫描一遍key,建立索引
+    inline void lazy_keys(lua_State* L, int mt) {
+        if (lua_rawgeti(L, mt, 3) == LUA_TTABLE) return;
+        lua_pop(L, 1);
+        size_t len;
+        lua_Integer count = 0;
+        uint8_t* data = lazy_msg(L, mt)->data(&len);
+        lua_rawgeti(L, mt, 2);
+        size_t pos = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        slice mslice(data + pos, len - pos);
+        lua_createtable(L, 0, 8);
+        //序列部分没有key,按顺序记录值的位置
+        if (data[pos - 1] == type_array) {
+            uint32_t size = value_decode<uint32_t>(L, &mslice);
+            for (uint32_t i = 1; i <= size; ++i, ++count) {
+                lua_pushinteger(L, mslice.head() - data);
+                skip_value(&mslice, value_decode<uint8_t>(L, &mslice));
+                lua_rawseti(L, -2, i);
+            }
+        }
+        while (true) {
+            uint8_t type = value_decode<uint8_t>(L, &mslice);
+            if (type == type_tab_tail) break;
+            decode_value(L, &mslice, type);
+            lua_pushinteger(L, mslice.head() - data);
+            skip_value(&mslice, value_decode<uint8_t>(L, &mslice));
+            lua_rawset(L, -3);
+            count++;
+        }
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, mt, 3);
+        lua_pushinteger(L, count);
+        lua_rawseti(L, mt, 4);
+    }
+
+    //解码一个字段写回代理table,栈顶为值
+    inline void lazy_field(lua_State* L, int t, int mt, int keys, int key, size_t pos) {
+        lazy_value(L, mt, pos);
+        lua_pushvalue(L, key);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, t);
+        lua_pushvalue(L, key);
+        lua_pushnil(L);
+        lua_rawset(L, keys);
+        lua_rawgeti(L, mt, 4);
+        lua_Integer left = lua_tointeger(L, -1) - 1;
+        lua_pop(L, 1);
+        lua_pushinteger(L, left);
+        lua_rawseti(L, mt, 4);
+    }
+
+    //解码全部未访问的字段并移除元表
+    inline void lazy_load(lua_State* L, int t) {
+        t = lua_absindex(L, t);
+        if (!lua_getmetatable(L, t)) return;
+        int mt = lua_gettop(L);
+        if (lazy_msg(L, mt) == nullptr) {
+            lua_pop(L, 1);
+            return;
+        }
+        lazy_keys(L, mt);
+        int keys = lua_gettop(L);
+        lua_pushnil(L);
+        while (lua_next(L, keys)) {
+            size_t pos = lua_tointeger(L, -1);
+            lua_pop(L, 1);
+            //已被lua重新赋值的字段不覆盖
+            lua_pushvalue(L, -1);
+            if (lua_rawget(L, t) != LUA_TNIL) {
+                lua_pop(L, 1);
+                continue;
+            }
+            lua_pop(L, 1);
+            lazy_value(L, mt, pos);
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, t);
+        }
+        lua_pop(L, 2);
+        lua_pushnil(L);
+        lua_setmetatable(L, t);
+    }
+
+    inline int lazy_index(lua_State* L) {
+        try {
+            lua_getmetatable(L, 1);
+            int mt = lua_gettop(L);
+            lazy_keys(L, mt);
+            int keys = lua_gettop(L);
+            lua_pushvalue(L, 2);
+            if (lua_rawget(L, keys) == LUA_TNIL) {
+                return 1;
+            }
+            size_t pos = lua_tointeger(L, -1);
+            lua_pop(L, 1);
+            lazy_field(L, 1, mt, keys, 2, pos);
+            lua_rawgeti(L, mt, 4);
+            if (lua_tointeger(L, -1) <= 0) {
+                lua_pushnil(L);
+                lua_setmetatable(L, 1);
+            }
+            lua_pop(L, 1);
+            return 1;
+        } catch (const std::exception& e) {
+            return luaL_error(L, e.what());
+        }
+    }
+
+    inline int lazy_pairs(lua_State* L) {
+        try {
+            lazy_load(L, 1);
+        } catch (const std::exception& e) {
+            return luaL_error(L, e.what());
+        }
+        lua_getglobal(L, "next");
+        lua_pushvalue(L, 1);
+        lua_pushnil(L);
+        return 3;
+    }
+
+    //长度只查索引,不解码字段
+    inline int lazy_len(lua_State* L) {
+        try {
+            lua_getmetatable(L, 1);
+            lazy_keys(L, lua_gettop(L));
+        } catch (const std::exception& e) {
+            return luaL_error(L, e.what());
+        }
+        int keys = lua_gettop(L);
+        lua_Integer len = lua_rawlen(L, 1);
+        while (lua_rawgeti(L, keys, len + 1) != LUA_TNIL || lua_rawgeti(L, 1, len + 1) != LUA_TNIL) {
+            lua_settop(L, keys);
+            len++;
+        }
+        lua_pushinteger(L, len);
+        return 1;
+    }
+
+    //递归解码全部字段,交给C模块(如bson/json编码)前使用
+    inline int lazy_load_all(lua_State* L, int t, int depth) {
+        if (depth > max_encode_depth || lua_type(L, t) != LUA_TTABLE) {
+            return 0;
+        }
+        t = lua_absindex(L, t);
+        lazy_load(L, t);
+        lua_pushnil(L);
+        while (lua_next(L, t)) {
+            lazy_load_all(L, -1, depth + 1);
+            lua_pop(L, 1);
+        }
+        return 0;
+    }
+
+    //worker消息的解码器,消息长度达到阈值时参数中的table延迟解码
+    class lazy_codec : public luacodec {
+    public:
+        void set_lazy(size_t size) { m_lazy_size = size; }
+
+        void set_msg(worker_msg* msg) {
+            size_t len;
+            uint8_t* data = msg->data(&len);
+            m_mslice.attach(data, len);
+            set_slice(&m_mslice);
+            m_msg = (m_lazy_size > 0 && len >= m_lazy_size) ? msg : nullptr;
+        }
+
+        virtual size_t decode(lua_State* L) {
+            if (!m_msg) {
+                return luacodec::decode(L);
+            }
+            int top = lua_gettop(L);
+            //消息移入holder,由代理table引用,全部释放后随gc回收
+            size_t len;
+            uint8_t* data = m_msg->data(&len);
+            auto holder = lua_newuserdata(L, sizeof(worker_msg));
+            new (holder) worker_msg(std::move(*m_msg));
+            if (luaL_newmetatable(L, LAZY_MSG_META)) {
+                lua_pushcfunction(L, [](lua_State* L) {
+                    ((worker_msg*)lua_touserdata(L, 1))->~worker_msg();
+                    return 0;
+                });
+                lua_setfield(L, -2, "__gc");
+            }
+            lua_setmetatable(L, -2);
+            m_msg = nullptr;
+            int hidx = lua_gettop(L);
+            while (1) {
+                uint8_t* type = m_slice->read();
+                if (type == nullptr) break;
+                if (*type == type_tab_head || *type == type_array) {
+                    lazy_table(L, hidx, m_slice->head() - data);
+                    skip_value(m_slice, *type);
+                    continue;
+                }
+                decode_value(L, m_slice, *type);
+            }
+            lua_remove(L, hidx);
+            m_slice = nullptr;
+            return lua_gettop(L) - top;
+        }
+
+    protected:
+        slice m_mslice;
+        size_t m_lazy_size = 0;
+        worker_msg* m_msg = nullptr;
+    };
+}
+
+#endif
@@ -2,12 +2,13 @@
 #include "lua_socket_mgr.h"
 #include "lua_socket_node.h"
 
-bool lua_socket_mgr::setup(lua_State* L, uint32_t max_fd) {
+bool lua_socket_mgr::setup(lua_State* L, uint32_t max_fd, bool edge_mode, bool io_uring) {
 	m_luakit = std::make_shared<kit_state>(L);
 	m_mgr = std::make_shared<socket_mgr>();
 	m_codec = m_luakit->create_codec();
 	m_router = std::make_shared<socket_router>(m_mgr);
-	return m_mgr->setup(max_fd);
+	set_rpc_key(m_mgr->get_handshake_verify());
+	return m_mgr->setup(max_fd, edge_mode, io_uring);
 }
 
 int lua_socket_mgr::listen(lua_State* L, const char* ip, int port) {
@@ -16,7 +17,8 @@ int lua_socket_mgr::listen(lua_State* L, const char* ip, int port) {
 	}
 	std::string err;
 	eproto_type proto_type = (eproto_type)luaL_optinteger(L, 3, 0);
-	auto token = m_mgr->listen(err, ip, port, proto_type);
+	bool reuse = lua_toboolean(L, 4);
+	auto token = m_mgr->listen(err, ip, port, proto_type, reuse);
 	if (token == 0) {
 		return luakit::variadic_return(L, nullptr, err);
 	}
@@ -47,6 +49,48 @@ int lua_socket_mgr::connect(lua_State* L, const char* ip, const char* port, int
 	return luakit::variadic_return(L, stream, "ok");
 }
 
+//向一组token广播同一个消息体,消息体只拷贝一次
+//返回成功数量和发送失败的token列表
+int lua_socket_mgr::broadcast_head(lua_State* L) {
+	luaL_checktype(L, 1, LUA_TTABLE);
+	uint32_t cmd_id = (uint32_t)luaL_checkinteger(L, 2);
+	uint8_t flag = (uint8_t)luaL_checkinteger(L, 3);
+	uint32_t session_id = (uint32_t)luaL_checkinteger(L, 4);
+	size_t data_len = 0;
+	const char* data = luaL_checklstring(L, 5, &data_len);
+	if (data_len + sizeof(socket_header) >= NET_PACKET_MAX_LEN) {
+		lua_pushinteger(L, -2);
+		return 1;
+	}
+
+	socket_header header;
+	header.cmd_id = cmd_id;
+	header.flag = flag;
+	header.session_id = session_id;
+	header.len = data_len + sizeof(socket_header);
+	auto body = make_shared_buffer(data, data_len);
+
+	int send_count = 0, fail_count = 0;
+	lua_createtable(L, 0, 0);
+	size_t count = lua_rawlen(L, 1);
+	for (size_t i = 1; i <= count; i++) {
+		lua_rawgeti(L, 1, i);
+		uint32_t token = (uint32_t)lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		if (token > 0 && m_mgr->send_head_shared(token, header, body) > 0) {
+			send_count++;
+			continue;
+		}
+		lua_pushinteger(L, token);
+		lua_rawseti(L, -2, ++fail_count);
+	}
+	lua_pushinteger(L, send_count);
+	lua_insert(L, -2);
+	//单个连接的发送长度(含包头)
+	lua_pushinteger(L, header.len);
+	return 3;
+}
+
 int lua_socket_mgr::map_token(uint32_t node_id, uint32_t token,uint16_t hash) {
 	return m_router->map_token(node_id, token, hash);
 }
@@ -67,11 +111,25 @@ void lua_socket_mgr::set_service_name(uint32_t service_id, std::string service_n
 	m_router->set_service_name(service_id, service_name);
 }
 
+void lua_socket_mgr::set_hash_mode(uint32_t service_id, uint8_t mode) {
+	m_router->set_hash_mode(service_id, mode);
+}
+
+uint32_t lua_socket_mgr::hash_target(uint32_t service_id, uint16_t hash) {
+	return m_router->hash_target(service_id, hash);
+}
+
+std::map<uint32_t, uint32_t> lua_socket_mgr::hash_ring(uint32_t service_id) {
+	return m_router->hash_ring(service_id);
+}
+
+//握手串以编码格式版本开头,格式不兼容的节点在第一个字节就握手失败,不会错误解码
 void lua_socket_mgr::set_rpc_key(std::string key) {
-	m_mgr->set_handshake_verify(key);
+	m_rpc_key = key;
+	m_mgr->set_handshake_verify("v" + std::to_string(luakit::codec_version) + ":" + key);
 }
 
 const std::string lua_socket_mgr::get_rpc_key() {
-	return m_mgr->get_handshake_verify();
+	return m_rpc_key;
 }
 
@@ -9,15 +9,20 @@ struct lua_socket_mgr final
 {
 public:
 	~lua_socket_mgr() {};
-	bool setup(lua_State* L, uint32_t max_fd);
+	bool setup(lua_State* L, uint32_t max_fd, bool edge_mode, bool io_uring);
 	int wait(int ms) { return m_mgr->wait(ms); }
+	bool watch_wakeup(int fd) { return m_mgr->watch_wakeup(fd) > 0; }
 	int listen(lua_State* L, const char* ip, int port);
 	int connect(lua_State* L, const char* ip, const char* port, int timeout);
+	int broadcast_head(lua_State* L);
 	int map_token(uint32_t node_id, uint32_t token, uint16_t hash);
 	int set_node_status(uint32_t node_id, uint8_t status);
 	void map_router_node(uint32_t router_id, uint32_t target_id, uint8_t status);
 	void set_router_id(int id);
 	void set_service_name(uint32_t service_id, std::string service_name);
+	void set_hash_mode(uint32_t service_id, uint8_t mode);
+	uint32_t hash_target(uint32_t service_id, uint16_t hash);
+	std::map<uint32_t, uint32_t> hash_ring(uint32_t service_id);
 	void set_rpc_key(std::string key);
 	const std::string get_rpc_key();
 
@@ -26,5 +31,6 @@ private:
 	stdsptr<socket_mgr> m_mgr;
 	codec_base* m_codec = nullptr;
 	stdsptr<socket_router> m_router;
+	std::string m_rpc_key;
 };
 
@@ -59,10 +59,7 @@ int lua_socket_node::call_head(lua_State* L,uint32_t cmd_id,uint8_t flag,uint32_
 		return 1;
 	}
 	header.len = data_len + sizeof(socket_header);
-	header.seq_id = m_send_seq_id++;
-
-	sendv_item items[] = { { &header, sizeof(socket_header) }, {buff.data(), data_len} };
-	auto send_len = m_mgr->sendv(m_token, items, _countof(items));
+	auto send_len = m_mgr->send_head(m_token, header, buff.data(), data_len);
 
 	lua_pushinteger(L, send_len);
 	return 1;
@@ -24,6 +24,8 @@ struct lua_socket_node final
 		m_mgr->set_codec(m_token, codec);
 	}
 	void set_flow_ctrl(int ctrl_package, int ctrl_bytes) { m_mgr->set_flow_ctrl(m_token, ctrl_package, ctrl_bytes); }
+	void set_delay_send(int delay_time, int delay_bytes) { m_mgr->set_delay_send(m_token, delay_time, delay_bytes); }
+	void set_recv_limit(size_t limit) { m_mgr->set_recv_limit(m_token, limit); }
 	bool can_send() { return m_mgr->can_send(m_token); }
 
 	int forward_target(lua_State* L, uint32_t session_id, uint8_t flag, uint32_t source_id,uint32_t target);
@@ -67,6 +69,5 @@ private:
 	stdsptr<socket_router> m_router;
 	eproto_type m_proto_type;
 	std::string m_error_msg;
-	uint8_t m_send_seq_id = 0;
 };
 
@@ -9,7 +9,9 @@ namespace luabus {
     thread_local lua_socket_mgr socket_mgr;
 
 	static bool init_socket_mgr(lua_State* L, uint32_t max_fd) {
-        return socket_mgr.setup(L, max_fd);
+        bool edge_mode = lua_toboolean(L, 2);
+        bool io_uring = lua_toboolean(L, 3);
+        return socket_mgr.setup(L, max_fd, edge_mode, io_uring);
 	}
 
 	static socket_udp* create_udp() {
@@ -37,6 +39,9 @@ namespace luabus {
     static int connect(lua_State* L, const char* ip, const char* port, int timeout) {
         return socket_mgr.connect(L, ip, port, timeout);
     }
+    static int broadcast_head(lua_State* L) {
+        return socket_mgr.broadcast_head(L);
+    }
 
     luakit::lua_table open_luabus(lua_State* L) {
         luakit::kit_state kit_state(L);
@@ -51,8 +56,10 @@ namespace luabus {
 
         //管理器接口
         lluabus.set_function("wait", [](int ms) { return socket_mgr.wait(ms); });
+        lluabus.set_function("watch_wakeup", [](int fd) { return socket_mgr.watch_wakeup(fd); });
         lluabus.set_function("listen", listen);
         lluabus.set_function("connect", connect);
+        lluabus.set_function("broadcast_head", broadcast_head);
         lluabus.set_function("map_token", [](uint32_t node_id, uint32_t token, uint16_t hash) { return socket_mgr.map_token(node_id, token, hash); });
         lluabus.set_function("set_node_status", [](uint32_t node_id, uint8_t status) { return socket_mgr.set_node_status(node_id, status); });
         lluabus.set_function("map_router_node", [](uint32_t router_id, uint32_t target_id, uint8_t status) { return socket_mgr.map_router_node(router_id, target_id, status); });
@@ -60,12 +67,19 @@ namespace luabus {
         lluabus.set_function("set_rpc_key", [](std::string key) { return socket_mgr.set_rpc_key(key); });
         lluabus.set_function("get_rpc_key", []() { return socket_mgr.get_rpc_key(); });
         lluabus.set_function("set_service_name", [](uint32_t service_id, std::string service_name) { return socket_mgr.set_service_name(service_id,service_name); });
+        lluabus.set_function("set_hash_mode", [](uint32_t service_id, uint8_t mode) { return socket_mgr.set_hash_mode(service_id, mode); });
+        lluabus.set_function("hash_target", [](uint32_t service_id, uint16_t hash) { return socket_mgr.hash_target(service_id, hash); });
+        lluabus.set_function("hash_ring", [](uint32_t service_id) { return socket_mgr.hash_ring(service_id); });
 
         lluabus.new_enum("eproto_type",
             "rpc", eproto_type::proto_rpc,
             "head", eproto_type::proto_head,
             "text", eproto_type::proto_text
         );
+        lluabus.new_enum("hash_mode",
+            "modulo", hash_mode::modulo,
+            "consistent", hash_mode::consistent
+        );
         kit_state.new_class<socket_udp>(
             "send", &socket_udp::send,
             "recv", &socket_udp::recv,
@@ -97,6 +111,8 @@ namespace luabus {
             "set_timeout", &lua_socket_node::set_timeout,
             "set_codec", &lua_socket_node::set_codec,
             "set_flow_ctrl",&lua_socket_node::set_flow_ctrl,
+            "set_delay_send",&lua_socket_node::set_delay_send,
+            "set_recv_limit",&lua_socket_node::set_recv_limit,
             "can_send",&lua_socket_node::can_send
             );
         return lluabus;
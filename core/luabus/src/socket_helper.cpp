@@ -26,6 +26,16 @@ void set_reuseaddr(socket_t fd) {
 #endif
 }
 
+bool set_reuseport(socket_t fd) {
+#ifdef SO_REUSEPORT
+	int one = 1;
+	return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == 0;
+#else
+	//win不支持,多个线程不能共享监听端口
+	return false;
+#endif
+}
+
 #if defined(__linux) || defined(__APPLE__)
 void set_no_block(socket_t fd) {
 	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
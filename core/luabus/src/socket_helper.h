@@ -8,7 +8,10 @@ using namespace std::chrono;
 
 constexpr int NET_PACKET_MAX_LEN	= (64 * 1024 - 1);
 constexpr int SOCKET_RECV_LEN		= 16*1024;
+constexpr int SOCKET_RECV_MAX		= 256*1024;  //单次recv的最大长度
 constexpr int IO_BUFFER_SEND		= 8*1024;
+constexpr int SENDV_MAX_ITEMS		= 64;   //单次writev的最大分段数
+constexpr int SHARED_SEND_MIN		= 256;  //小于该长度的共享数据直接拷贝
 constexpr int SOCKET_PACKET_MAX		= 1024 * 1024 * 16; //16m
 
 #pragma pack(1)
@@ -35,6 +38,7 @@ struct socket_header {
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
 #include <sys/sysinfo.h>
 #include <sys/resource.h>
@@ -77,6 +81,8 @@ void set_no_delay(socket_t fd, int enable);
 void set_close_on_exec(socket_t fd);
 void set_keepalive(socket_t fd, int enable);
 void set_reuseaddr(socket_t fd);
+// 多个线程(各自的socket_mgr)监听同一端口,由内核分发连接
+bool set_reuseport(socket_t fd);
 
 #define MAX_ERROR_TXT 128
 
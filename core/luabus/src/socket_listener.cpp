@@ -56,6 +56,13 @@ bool socket_listener::update(int64_t, bool check_timeout) {
 		m_socket = INVALID_SOCKET;
 	}
 
+#ifdef SOCKET_URING
+	if (m_accept_retry && m_link_status == elink_status::link_connected) {
+		m_accept_retry = false;
+		rearm_accept();
+	}
+#endif
+
 #ifdef _MSC_VER
 	if (m_ovl_ref == 0 && m_link_status == elink_status::link_connected) {
 		for (auto& node : m_nodes) {
@@ -68,7 +75,11 @@ bool socket_listener::update(int64_t, bool check_timeout) {
 
 	if (m_link_status == elink_status::link_closed) {
 #ifdef _MSC_VER
-		return m_ovl_ref != 0;
+		if (m_ovl_ref != 0) {
+			m_mgr->mark_dirty(this);
+			return true;
+		}
+		return false;
 #endif
 
 #if defined(__linux) || defined(__APPLE__)
@@ -130,6 +141,7 @@ void socket_listener::queue_accept(WSAOVERLAPPED* ovl) {
 		node->fd = socket(listen_addr.ss_family, SOCK_STREAM, IPPROTO_IP);
 		if (node->fd == INVALID_SOCKET) {
 			m_link_status = elink_status::link_closed;
+			m_mgr->mark_dirty(this);
 			m_error_cb("new-socket-failed");
 			return;
 		}
@@ -147,6 +159,7 @@ void socket_listener::queue_accept(WSAOVERLAPPED* ovl) {
 				closesocket(node->fd);
 				node->fd = INVALID_SOCKET;
 				m_link_status = elink_status::link_closed;
+				m_mgr->mark_dirty(this);
 				m_error_cb(txt);
 				return;
 			}
@@ -168,6 +181,7 @@ void socket_listener::queue_accept(WSAOVERLAPPED* ovl) {
 			closesocket(node->fd);
 			node->fd = INVALID_SOCKET;
 			m_link_status = elink_status::link_closed;
+			m_mgr->mark_dirty(this);
 			m_error_cb("new-stream-failed");
 			return;
 		}
@@ -204,3 +218,44 @@ void socket_listener::on_can_recv(size_t max_len, bool is_eof) {
 }
 #endif
 
+#ifdef SOCKET_URING
+//multishot accept: 每个新连接一个完成事件,res为新连接的fd
+void socket_listener::on_uring(uring_op op, int res, bool more, const char* data) {
+	if (res >= 0) {
+		socket_t fd = res;
+		if (m_link_status != elink_status::link_connected || m_mgr->is_full()) {
+			closesocket(fd);
+		} else {
+			sockaddr_storage addr;
+			socklen_t addr_len = (socklen_t)sizeof(addr);
+			char ip[INET6_ADDRSTRLEN] = { 0 };
+			if (getpeername(fd, (sockaddr*)&addr, &addr_len) == 0) {
+				get_ip_string(ip, sizeof(ip), &addr, (size_t)addr_len);
+			}
+			init_socket_option(fd);
+			auto token = m_mgr->accept_stream(fd, ip, m_accept_cb, m_proto_type);
+			if (token == 0) {
+				closesocket(fd);
+			}
+		}
+	}
+	if (more || res == -ECANCELED || m_link_status != elink_status::link_connected)
+		return;
+	//multishot被内核终止时重新提交,出错(如fd耗尽)时稍后再提交,避免反复立即失败
+	if (res < 0) {
+		m_accept_retry = true;
+		m_mgr->add_timer(this, steady_ms() + 100);
+		return;
+	}
+	rearm_accept();
+}
+
+void socket_listener::rearm_accept() {
+	if (!m_mgr->watch_listen(m_socket, this)) {
+		m_link_status = elink_status::link_closed;
+		m_mgr->mark_dirty(this);
+		m_error_cb("watch-failed");
+	}
+}
+#endif
+
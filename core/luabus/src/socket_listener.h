@@ -32,6 +32,11 @@ struct socket_listener : public socket_object
 	void on_can_recv(size_t max_len, bool is_eof) override;
 #endif
 
+#ifdef SOCKET_URING
+	void on_uring(uring_op op, int res, bool more, const char* data) override;
+	void rearm_accept();
+#endif
+
 private:
 	socket_mgr* m_mgr = nullptr;
 	socket_t m_socket = INVALID_SOCKET;
@@ -50,4 +55,8 @@ private:
 	LPFN_GETACCEPTEXSOCKADDRS m_addrs_func = nullptr;
 	int m_ovl_ref = 0;
 #endif
+
+#ifdef SOCKET_URING
+	bool m_accept_retry = false;
+#endif
 };
@@ -3,6 +3,7 @@
 #include "socket_mgr.h"
 #include "socket_stream.h"
 #include "socket_listener.h"
+#include "socket_wakeup.h"
 #include "fmt/core.h"
 
 #ifdef _MSC_VER
@@ -18,6 +19,10 @@ socket_mgr::socket_mgr() {
 }
 
 socket_mgr::~socket_mgr() {
+#ifdef SOCKET_URING
+	//先关闭io_uring,内核不再访问对象持有的发送数据
+	m_uring.close();
+#endif
 	for (auto& node : m_objects) {
 		delete node.second;
 	}
@@ -45,7 +50,7 @@ socket_mgr::~socket_mgr() {
 #endif
 }
 
-bool socket_mgr::setup(uint32_t max_connection) {
+bool socket_mgr::setup(uint32_t max_connection, bool edge_mode, bool io_uring) {
 #ifdef _MSC_VER
 	m_handle = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
 	if (m_handle == INVALID_HANDLE_VALUE)
@@ -56,9 +61,18 @@ bool socket_mgr::setup(uint32_t max_connection) {
 #endif
 
 #ifdef __linux
-	m_handle = epoll_create(max_connection);
-	if (m_handle == -1)
-		return false;
+#ifdef SOCKET_URING
+	// 内核不支持或被禁用io_uring时回退到epoll
+	if (io_uring) {
+		m_uring.setup(std::min<uint32_t>(max_connection, URING_MAX_ENTRIES));
+	}
+#endif
+	if (!is_uring()) {
+		m_handle = epoll_create(max_connection);
+		if (m_handle == -1)
+			return false;
+	}
+	m_edge_mode = edge_mode;
 #endif
 
 #ifdef __APPLE__
@@ -68,6 +82,7 @@ bool socket_mgr::setup(uint32_t max_connection) {
 #endif
 	m_max_count = max_connection;
 	m_events.resize(max_connection);
+	m_timer.setup(steady_ms());
 	return true;
 }
 
@@ -109,17 +124,46 @@ Exit0:
 
 int socket_mgr::wait(int timeout) {
 	int64_t now = steady_ms();
-	bool check_timeout = (now - m_last_check_time) > 2000;
-	m_last_check_time = check_timeout ? now : m_last_check_time;
-	auto it = m_objects.begin(), end = m_objects.end();
-	while (it != end) {
+	// 定时检查(超时,流控,连接超时)
+	m_updates.clear();
+	m_timer.update(now, m_updates);
+	for (auto token : m_updates) {
+		auto it = m_objects.find(token);
+		if (it == m_objects.end()) continue;
 		socket_object* object = it->second;
-		if (!object->update(now,check_timeout)) {
-			it = m_objects.erase(it);
+		// 已被更晚的检查替换,忽略
+		if (object->m_timer_expire == 0 || object->m_timer_expire > now) continue;
+		object->m_timer_expire = 0;
+		if (!object->update(now, true)) {
+			//io_uring的请求取消完成后才能释放
+			if (object->m_uring_ref > 0) {
+				mark_dirty(object);
+				continue;
+			}
+			m_objects.erase(token);
 			delete object;
-			continue;
 		}
-		++it;
+	}
+	// 状态变化的对象(关闭,连接中,积压待分发)
+	m_updates.clear();
+	m_updates.swap(m_dirty);
+	for (auto token : m_updates) {
+		auto it = m_objects.find(token);
+		if (it == m_objects.end()) continue;
+		socket_object* object = it->second;
+		object->m_dirty = false;
+		if (!object->update(now, false)) {
+			if (object->m_uring_ref > 0) {
+				mark_dirty(object);
+				continue;
+			}
+			m_objects.erase(token);
+			delete object;
+		}
+	}
+	// 不能睡过内部定时器(延迟发送,超时检查)
+	if (m_timer.size() > 0 && m_timer.next_expire() < (uint64_t)timeout) {
+		timeout = (int)m_timer.next_expire();
 	}
 	int escape = steady_ms() - now;
 	timeout = escape >= timeout ? 0 : timeout - escape;
@@ -136,6 +180,9 @@ int socket_mgr::wait(int timeout) {
 #endif
 
 #ifdef __linux
+	if (is_uring()) {
+		return uring_wait(timeout);
+	}
 	int event_count = epoll_wait(m_handle, &m_events[0], (int)m_events.size(), timeout);
 	for (int i = 0; i < event_count; i++) {
 		epoll_event& ev = m_events[i];
@@ -161,7 +208,7 @@ int socket_mgr::wait(int timeout) {
 	return (int)event_count;
 }
 
-uint32_t socket_mgr::listen(std::string& err, const char ip[], int port, eproto_type proto_type) {
+uint32_t socket_mgr::listen(std::string& err, const char ip[], int port, eproto_type proto_type, bool reuse) {
 	int ret = false;
 	socket_t fd = INVALID_SOCKET;
 	sockaddr_storage addr;
@@ -184,6 +231,8 @@ uint32_t socket_mgr::listen(std::string& err, const char ip[], int port, eproto_
 	set_no_block(fd);
 	set_reuseaddr(fd);
 	set_close_on_exec(fd);
+	// reuse模式下每个线程各自监听,accept后的连接归属该线程的socket_mgr
+	if (reuse && !set_reuseport(fd)) goto Exit0;
 
 	// macOSX require addr_len to be the real len (ipv4/ipv6)
 	ret = ::bind(fd, (sockaddr*)&addr, (int)addr_len);
@@ -193,15 +242,14 @@ uint32_t socket_mgr::listen(std::string& err, const char ip[], int port, eproto_
 	if (ret == SOCKET_ERROR) goto Exit0;
 
 	if (watch_listen(fd, listener) && listener->setup(fd)) {
-		auto token = new_token();
-		m_objects[token] = listener;
-		return token;
+		return add_object(listener);
 	}
 
 Exit0:
 	get_error_string(err, get_socket_error());
 	delete listener;
 	if (fd != INVALID_SOCKET) {
+		unwatch(fd);
 		closesocket(fd);
 		fd = INVALID_SOCKET;
 	}
@@ -222,10 +270,8 @@ uint32_t socket_mgr::connect(std::string& err, const char node_name[], const cha
 	socket_stream* stm = new socket_stream(this, proto_type, elink_type::elink_tcp_client);
 #endif
 
+	auto token = add_object(stm);
 	stm->connect(node_name, service_name, timeout);
-
-	auto token = new_token();
-	m_objects[token] = stm;
 	return token;
 }
 
@@ -250,6 +296,20 @@ void socket_mgr::set_flow_ctrl(uint32_t token, int ctrl_package, int ctrl_bytes)
 	}
 }
 
+void socket_mgr::set_recv_limit(uint32_t token, size_t limit) {
+	auto node = get_object(token);
+	if (node) {
+		node->set_recv_limit(limit);
+	}
+}
+
+void socket_mgr::set_delay_send(uint32_t token, int delay_time, int delay_bytes) {
+	auto node = get_object(token);
+	if (node) {
+		node->set_delay_send(delay_time, delay_bytes);
+	}
+}
+
 bool socket_mgr::can_send(uint32_t token) {
 	auto node = get_object(token);
 	if (node) {
@@ -274,10 +334,39 @@ int socket_mgr::sendv(uint32_t token, const sendv_item items[], int count) {
 	return 0;
 }
 
+int socket_mgr::sendv_shared(uint32_t token, const sendv_item items[], int count, const shared_buffer& body) {
+	auto node = get_object(token);
+	if (node) {
+		return node->sendv_shared(items, count, body);
+	}
+	return 0;
+}
+
+int socket_mgr::send_head(uint32_t token, socket_header& header, const void* data, size_t data_len) {
+	auto node = get_object(token);
+	if (node) {
+		header.seq_id = node->next_send_seq();
+		sendv_item items[] = { { &header, sizeof(socket_header) }, { data, data_len } };
+		return node->sendv(items, _countof(items));
+	}
+	return 0;
+}
+
+int socket_mgr::send_head_shared(uint32_t token, socket_header& header, const shared_buffer& body) {
+	auto node = get_object(token);
+	if (node) {
+		header.seq_id = node->next_send_seq();
+		sendv_item items[] = { { &header, sizeof(socket_header) } };
+		return node->sendv_shared(items, _countof(items), body);
+	}
+	return 0;
+}
+
 void socket_mgr::close(uint32_t token) {
 	auto node = get_object(token);
 	if (node) {
 		node->close();
+		mark_dirty(node);
 	}
 }
 
@@ -333,6 +422,7 @@ bool socket_mgr::watch_listen(socket_t fd, socket_object* object) {
 	epoll_event ev;
 	ev.data.ptr = object;
 	ev.events = EPOLLIN | EPOLLET;
+	if (is_uring()) return uring_accept(fd, object);
 	return epoll_ctl(m_handle, EPOLL_CTL_ADD, fd, &ev) == 0;
 #endif
 
@@ -352,6 +442,8 @@ bool socket_mgr::watch_accepted(socket_t fd, socket_object* object) {
 	epoll_event ev;
 	ev.data.ptr = object;
 	ev.events = EPOLLIN | EPOLLET;
+	if (m_edge_mode) { ev.events |= EPOLLOUT; }
+	if (is_uring()) return uring_recv(fd, object);
 	return epoll_ctl(m_handle, EPOLL_CTL_ADD, fd, &ev) == 0;
 #endif
 
@@ -372,6 +464,7 @@ bool socket_mgr::watch_connecting(socket_t fd, socket_object* object) {
 	epoll_event ev;
 	ev.data.ptr = object;
 	ev.events = EPOLLOUT | EPOLLET;
+	if (is_uring()) return uring_watch(fd, object, ev.events);
 	return epoll_ctl(m_handle, EPOLL_CTL_ADD, fd, &ev) == 0;
 #endif
 
@@ -391,6 +484,8 @@ bool socket_mgr::watch_connected(socket_t fd, socket_object* object) {
 	epoll_event ev;
 	ev.data.ptr = object;
 	ev.events = EPOLLIN | EPOLLET;
+	if (m_edge_mode) { ev.events |= EPOLLOUT; }
+	if (is_uring()) return uring_recv(fd, object);
 	return epoll_ctl(m_handle, EPOLL_CTL_MOD, fd, &ev) == 0;
 #endif
 
@@ -412,6 +507,8 @@ bool socket_mgr::watch_send(socket_t fd, socket_object* object, bool enable) {
 	ev.data.ptr = object;
 	ev.events = EPOLLIN | EPOLLET;
 	if(enable){ ev.events |= EPOLLOUT; }
+	//io_uring直接提交发送,不需要可写事件
+	if (is_uring()) return true;
 
 	return epoll_ctl(m_handle, EPOLL_CTL_MOD, fd, &ev) == 0;
 #endif
@@ -427,6 +524,12 @@ bool socket_mgr::watch_send(socket_t fd, socket_object* object, bool enable) {
 // 之所以加一个unwatch显式的移除,是为了避免进程fork带来的问题
 void socket_mgr::unwatch(socket_t fd) {
 #ifdef __linux
+#ifdef SOCKET_URING
+	if (is_uring()) {
+		m_uring.unwatch(fd);
+		return;
+	}
+#endif
 	epoll_event ev;
 	ev.data.ptr = nullptr;
 	ev.events = 0;
@@ -441,14 +544,85 @@ void socket_mgr::unwatch(socket_t fd) {
 #endif
 }
 
+bool socket_mgr::is_uring() {
+#ifdef SOCKET_URING
+	return m_uring.valid();
+#else
+	return false;
+#endif
+}
+
+#ifdef __linux
+// io_uring后端: poll事件按epoll的方式分发,accept/recv/send的完成交给对象处理
+int socket_mgr::uring_wait(int timeout) {
+#ifdef SOCKET_URING
+	return m_uring.wait(timeout, [](void* ptr, uint32_t events) {
+		auto object = (socket_object*)ptr;
+		if (events & POLLIN) object->on_can_recv();
+		if (events & POLLOUT) object->on_can_send();
+	}, [](void* ptr, uring_op op, int res, bool more, const char* data) {
+		auto object = (socket_object*)ptr;
+		if (!more) object->m_uring_ref--;
+		object->on_uring(op, res, more, data);
+	});
+#else
+	return 0;
+#endif
+}
+
+bool socket_mgr::uring_watch(socket_t fd, socket_object* object, uint32_t events) {
+#ifdef SOCKET_URING
+	return m_uring.watch(fd, object, events);
+#else
+	return false;
+#endif
+}
+
+bool socket_mgr::uring_accept(socket_t fd, socket_object* object) {
+#ifdef SOCKET_URING
+	if (!m_uring.accept(fd, object))
+		return false;
+	object->m_uring_ref++;
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool socket_mgr::uring_recv(socket_t fd, socket_object* object) {
+#ifdef SOCKET_URING
+	if (!m_uring.recv(fd, object))
+		return false;
+	object->m_uring_ref++;
+	return true;
+#else
+	return false;
+#endif
+}
+#endif
+
+#ifdef SOCKET_URING
+// items的内存在全部完成前不能变动
+bool socket_mgr::uring_send(socket_t fd, socket_object* object, const sendv_item items[], int count) {
+	iovec iovs[SENDV_MAX_ITEMS];
+	for (int i = 0; i < count; i++) {
+		iovs[i].iov_base = (void*)items[i].data;
+		iovs[i].iov_len = items[i].len;
+	}
+	if (!m_uring.send(fd, object, iovs, count))
+		return false;
+	object->m_uring_ref += count;
+	return true;
+}
+#endif
+
 int socket_mgr::accept_stream(socket_t fd, const char ip[], const std::function<void(int, eproto_type)>& cb, eproto_type proto_type) {
 	auto* stm = new socket_stream(this, proto_type, elink_type::elink_tcp_accept);
 	if (proto_type == eproto_type::proto_rpc) {
 		stm->set_handshake(false);
 	}
 	if (watch_accepted(fd, stm) && stm->accept_socket(fd, ip)) {
-		auto token = new_token();
-		m_objects[token] = stm;
+		auto token = add_object(stm);
 		cb(token, proto_type);
 		return token;
 	}
@@ -468,4 +642,48 @@ uint32_t socket_mgr::new_token() {
 		// nothing ...
 	}
 	return m_next_token;
+}
+
+//监听其他线程的唤醒fd,有写入时wait立即返回
+uint32_t socket_mgr::watch_wakeup(socket_t fd) {
+#if defined(__linux) || defined(__APPLE__)
+	if (fd == INVALID_SOCKET)
+		return 0;
+	auto* wakeup = new socket_wakeup(fd);
+#ifdef __linux
+	//io_uring的监听socket提交的是accept,唤醒仍用poll
+	bool ok = is_uring() ? uring_watch(fd, wakeup, EPOLLIN) : watch_listen(fd, wakeup);
+#else
+	bool ok = watch_listen(fd, wakeup);
+#endif
+	if (ok) {
+		return add_object(wakeup);
+	}
+	delete wakeup;
+#endif
+	return 0;
+}
+
+uint32_t socket_mgr::add_object(socket_object* object) {
+	auto token = new_token();
+	object->m_token = token;
+	m_objects[token] = object;
+	mark_dirty(object);
+	return token;
+}
+
+void socket_mgr::mark_dirty(socket_object* object) {
+	if (!object->m_dirty && object->m_token != 0) {
+		object->m_dirty = true;
+		m_dirty.push_back(object->m_token);
+	}
+}
+
+void socket_mgr::add_timer(socket_object* object, int64_t expire) {
+	// 已有更早的检查,到期时会重新计算
+	if (object->m_token == 0 || (object->m_timer_expire != 0 && object->m_timer_expire <= expire)) {
+		return;
+	}
+	object->m_timer_expire = expire;
+	m_timer.insert(object->m_token, expire);
 }
\ No newline at end of file
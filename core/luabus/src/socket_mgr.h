@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <string>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -8,6 +9,8 @@
 #include <functional>
 #include <unordered_map>
 #include "socket_helper.h"
+#include "socket_timer.h"
+#include "socket_uring.h"
 
 using namespace luakit;
 
@@ -41,6 +44,12 @@ struct sendv_item
 	size_t len;
 };
 
+// 只读共享数据,广播时各socket的发送队列引用同一份,不逐个拷贝
+using shared_buffer = std::shared_ptr<const std::string>;
+inline shared_buffer make_shared_buffer(const void* data, size_t len) {
+	return std::make_shared<const std::string>((const char*)data, len);
+}
+
 struct socket_object
 {
 	virtual ~socket_object() {};
@@ -51,8 +60,12 @@ struct socket_object
 	virtual void set_timeout(int duration) { }
 	virtual void set_nodelay(int flag) { }
 	virtual void set_flow_ctrl(int ctrl_package, int ctrl_bytes){ }
+	virtual void set_delay_send(int delay_time, int delay_bytes) { }
+	virtual void set_recv_limit(size_t limit) { }
 	virtual int  send(const void* data, size_t data_len) { return 0; }
 	virtual int  sendv(const sendv_item items[], int count) { return 0; };
+	virtual int  sendv_shared(const sendv_item items[], int count, const shared_buffer& body) { return 0; };
+	virtual uint8_t next_send_seq() { return 0; }
 	virtual void set_codec(codec_base* codec) { m_codec = codec; }
 	virtual void set_accept_callback(const std::function<void(int, eproto_type)>& cb) { }
 	virtual void set_connect_callback(const std::function<void(bool, const char*)>& cb) { }
@@ -67,13 +80,22 @@ struct socket_object
 	virtual void on_can_recv(size_t data_len = UINT_MAX, bool is_eof = false) {};
 	virtual void on_can_send(size_t data_len = UINT_MAX, bool is_eof = false) {};
 #endif
+
+#ifdef SOCKET_URING
+	virtual void on_uring(uring_op op, int res, bool more, const char* data) {};
+#endif
 	elink_status link_status() { return m_link_status; };
 	void set_handshake(bool status) { m_handshake = status; };
 protected:
+	friend class socket_mgr;
 	codec_base* m_codec = nullptr;
 	eproto_type m_proto_type = eproto_type::proto_rpc;
 	elink_status m_link_status = elink_status::link_init;
 	bool         m_handshake = true; //握手状态
+	bool         m_dirty = false;    //是否在待更新列表
+	uint32_t     m_token = 0;
+	int64_t      m_timer_expire = 0; //最近一次定时检查时间
+	int          m_uring_ref = 0;    //io_uring中未完成的请求数,归零前不能释放
 };
 
 class socket_mgr
@@ -82,7 +104,7 @@ public:
 	socket_mgr();
 	~socket_mgr();
 
-	bool setup(uint32_t max_connection);
+	bool setup(uint32_t max_connection, bool edge_mode = false, bool io_uring = false);
 
 #ifdef _MSC_VER
 	bool get_socket_funcs();
@@ -90,15 +112,21 @@ public:
 
 	int wait(int timeout);
 
-	uint32_t listen(std::string& err, const char ip[], int port, eproto_type proto_type);
+	uint32_t listen(std::string& err, const char ip[], int port, eproto_type proto_type, bool reuse = false);
 	uint32_t connect(std::string& err, const char node_name[], const char service_name[], int timeout, eproto_type proto_type);
 
 	void set_timeout(uint32_t token, int duration);
 	void set_nodelay(uint32_t token, int flag);
 	void set_flow_ctrl(uint32_t token, int ctrl_package, int ctrl_bytes);
+	void set_delay_send(uint32_t token, int delay_time, int delay_bytes);
+	void set_recv_limit(uint32_t token, size_t limit);
 	bool can_send(uint32_t token);
 	int  send(uint32_t token, const void* data, size_t data_len);
 	int  sendv(uint32_t token, const sendv_item items[], int count);
+	int  sendv_shared(uint32_t token, const sendv_item items[], int count, const shared_buffer& body);
+	// proto_head: 由socket填写发送序号
+	int  send_head(uint32_t token, socket_header& header, const void* data, size_t data_len);
+	int  send_head_shared(uint32_t token, socket_header& header, const shared_buffer& body);
 	void close(uint32_t token);
 	void set_codec(uint32_t token, codec_base* codec);
 	bool get_remote_ip(uint32_t token, std::string& ip);
@@ -114,13 +142,24 @@ public:
 	bool watch_connected(socket_t fd, socket_object* object);
 	bool watch_send(socket_t fd, socket_object* object, bool enable);
 	void unwatch(socket_t fd);
+	uint32_t watch_wakeup(socket_t fd);
 	int accept_stream(socket_t fd, const char ip[], const std::function<void(int, eproto_type)>& cb, eproto_type proto_type = eproto_type::proto_rpc);
 
+	// 只有标记了dirty或定时器到期的对象才会在wait中update
+	void mark_dirty(socket_object* object);
+	void add_timer(socket_object* object, int64_t expire);
+
 	void increase_count() { m_count++; }
 	void decrease_count() { m_count--; }
 	bool is_full() { return m_count >= m_max_count; }
+	bool is_edge_mode() { return m_edge_mode; }
+	bool is_uring();
+#ifdef SOCKET_URING
+	bool uring_send(socket_t fd, socket_object* object, const sendv_item items[], int count);
+#endif
 	socket_object* get_object(int token);
 	uint32_t new_token();
+	uint32_t add_object(socket_object* object);
 
 	const std::string& get_handshake_verify() { return m_handshake_verify; }
 	void set_handshake_verify(const std::string& verify) { m_handshake_verify = verify; }
@@ -135,8 +174,16 @@ private:
 #endif
 
 #ifdef __linux
+	int uring_wait(int timeout);
+	bool uring_watch(socket_t fd, socket_object* object, uint32_t events);
+	bool uring_accept(socket_t fd, socket_object* object);
+	bool uring_recv(socket_t fd, socket_object* object);
+
 	int m_handle = -1;
 	std::vector<epoll_event> m_events;
+#ifdef SOCKET_URING
+	uring_poller m_uring;
+#endif
 #endif
 
 #ifdef __APPLE__
@@ -145,9 +192,12 @@ private:
 #endif
 
 	int m_max_count = 0;
+	bool m_edge_mode = false;   //EPOLLOUT常驻,发送不再epoll_ctl
 	int m_count = 0;
 	uint32_t m_next_token = 0;
-	int64_t  m_last_check_time = 0;
+	timer_wheel m_timer;
+	std::vector<uint32_t> m_dirty;
+	std::vector<uint32_t> m_updates;
 	std::unordered_map<uint32_t, socket_object*> m_objects;
 	std::string m_handshake_verify = "CLBY20220816CLBY&*^%$#@!";
 };
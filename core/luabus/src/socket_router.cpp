@@ -116,7 +116,41 @@ void socket_router::flush_hash_node(uint32_t service_id) {
 			}
 			std::sort(services.hash_ids.begin(), services.hash_ids.end());
 		}
+		services.hash_ring.clear();
+		if (services.mode == hash_mode::consistent) {
+			services.hash_ring.reserve(services.hash_ids.size() * HASH_VIRTUAL_NODES);
+			for (auto id : services.hash_ids) {
+				for (uint64_t i = 0; i < HASH_VIRTUAL_NODES; ++i) {
+					services.hash_ring.emplace_back(hash_point((uint64_t)id << 32 | i), id);
+				}
+			}
+			std::sort(services.hash_ring.begin(), services.hash_ring.end());
+		}
+	}
+}
+
+void socket_router::set_hash_mode(uint32_t service_id, uint8_t mode) {
+	if (service_id < m_services.size()) {
+		m_services[service_id].mode = (hash_mode)mode;
+		flush_hash_node(service_id);
+	}
+}
+
+uint32_t socket_router::hash_target(uint32_t service_id, uint16_t hash) {
+	if (service_id < m_services.size()) {
+		return m_services[service_id].hash_id(hash);
 	}
+	return 0;
+}
+
+std::map<uint32_t, uint32_t> socket_router::hash_ring(uint32_t service_id) {
+	std::map<uint32_t, uint32_t> ring;
+	if (service_id < m_services.size()) {
+		for (auto& [point, id] : m_services[service_id].hash_ring) {
+			ring.emplace(point, id);
+		}
+	}
+	return ring;
 }
 
 bool socket_router::do_forward_target(router_header* header, char* data, size_t data_len, std::string& error, bool router) {
@@ -157,12 +191,14 @@ bool socket_router::do_forward_broadcast(router_header* header, int source, char
 		return false;
 
 	header->msg_id = (uint8_t)rpc_type::remote_call;
-	sendv_item items[] = { {header, sizeof(router_header)}, {data, data_len} };
+	sendv_item items[] = { {header, sizeof(router_header)} };
 
+	//数据只拷贝一次,各目标的发送队列共享引用
+	auto body = make_shared_buffer(data, data_len);
 	auto& group = m_services[service_id];
 	for (auto& [id,target] : group.mp_nodes) {
 		if (target->token != 0 && target->token != source) {
-			m_mgr->sendv(target->token, items, _countof(items));
+			m_mgr->sendv_shared(target->token, items, _countof(items), body);
 			broadcast_num++;
 		}
 	}
@@ -3,6 +3,8 @@
 #include <array>
 #include <vector>
 #include <set>
+#include <map>
+#include <algorithm>
 #include "socket_mgr.h"
 #include "socket_helper.h"
 
@@ -16,6 +18,12 @@ enum class rpc_type : uint8_t {
 };
 
 const int MAX_SERVICE_GROUP = (UCHAR_MAX + 1);
+const int HASH_VIRTUAL_NODES = 160;   //一致性hash每个节点的虚拟节点数
+
+enum class hash_mode : uint8_t {
+	modulo,      //按在线节点取模
+	consistent,  //一致性hash环,节点增减只迁移约1/N的key
+};
 inline uint32_t get_service_id(uint32_t node_id) { return  (node_id >> 16) & 0xff; }
 inline uint32_t get_node_index(uint32_t node_id) { return node_id & 0xfff; }
 inline uint32_t build_service_id(uint16_t service_id, uint16_t index) { return (service_id & 0xff) << 16 | index; }
@@ -50,10 +58,20 @@ struct router_header {
 };
 #pragma pack()
 
+inline uint32_t hash_point(uint64_t key) {
+	//splitmix64,打散连续的key和节点id
+	key += 0x9e3779b97f4a7c15ULL;
+	key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+	return (uint32_t)(key ^ (key >> 31));
+}
+
 struct service_list {
 	uint16_t hash = 0;
+	hash_mode mode = hash_mode::modulo;
 	stdsptr<service_node> master = nullptr;
 	std::vector<uint32_t> hash_ids;
+	std::vector<std::pair<uint32_t, uint32_t>> hash_ring;  //(环上位置,节点id),按位置排序
 	std::unordered_map<uint32_t, stdsptr<service_node>> mp_nodes;
 	inline stdsptr<service_node> get_target(uint32_t id) {
 		auto it = mp_nodes.find(id);
@@ -62,10 +80,21 @@ struct service_list {
 		}
 		return nullptr;
 	}
-	inline stdsptr<service_node> hash_target(uint64_t hash) {
+	inline uint32_t hash_id(uint64_t hash) {
+		if (mode == hash_mode::consistent && !hash_ring.empty()) {
+			auto point = hash_point(hash);
+			auto it = std::lower_bound(hash_ring.begin(), hash_ring.end(), std::make_pair(point, (uint32_t)0));
+			if (it == hash_ring.end()) {
+				it = hash_ring.begin();
+			}
+			return it->second;
+		}
 		auto count = hash_ids.size();
-		if (count > 0) {
-			auto id = hash_ids[hash % count];
+		return count > 0 ? hash_ids[hash % count] : 0;
+	}
+	inline stdsptr<service_node> hash_target(uint64_t hash) {
+		auto id = hash_id(hash);
+		if (id > 0) {
 			auto it = mp_nodes.find(id);
 			if (it != mp_nodes.end()) {
 				return it->second;
@@ -87,6 +116,9 @@ public:
 	void set_router_id(uint32_t node_id);
 	uint32_t choose_master(uint32_t service_id);
 	void flush_hash_node(uint32_t service_id);
+	void set_hash_mode(uint32_t service_id, uint8_t mode);
+	uint32_t hash_target(uint32_t service_id, uint16_t hash);
+	std::map<uint32_t, uint32_t> hash_ring(uint32_t service_id);
 
 	bool do_forward_target(router_header* header, char* data, size_t data_len, std::string& error, bool router);
 	bool do_forward_master(router_header* header, char* data, size_t data_len, std::string& error, bool router);
@@ -15,6 +15,9 @@ static const int s_send_flag = MSG_NOSIGNAL;
 static const int s_send_flag = 0;
 #endif
 
+// 流控统计周期(check_flow_ctrl按秒统计,超过5秒才判定)
+static const int64_t s_flow_ctrl_period = 6000;
+
 #ifdef _MSC_VER
 socket_stream::socket_stream(socket_mgr* mgr, LPFN_CONNECTEX connect_func, eproto_type proto_type, elink_type link_type) :
 	m_link_type(link_type) {
@@ -23,7 +26,11 @@ socket_stream::socket_stream(socket_mgr* mgr, LPFN_CONNECTEX connect_func, eprot
 	m_mgr = mgr;
 	m_connect_func = connect_func;
 	m_ip[0] = 0;
-
+#ifdef DELAY_SEND
+	if (eproto_type::proto_head == m_proto_type || eproto_type::proto_rpc == m_proto_type) {
+		m_delay_bytes = IO_BUFFER_SEND;
+	}
+#endif // DELAY_SEND
 	reset_dispatch_pkg(true);
 }
 #endif
@@ -34,7 +41,11 @@ socket_stream::socket_stream(socket_mgr* mgr, eproto_type proto_type, elink_type
 	m_proto_type = proto_type;
 	m_mgr = mgr;
 	m_ip[0] = 0;
-
+#ifdef DELAY_SEND
+	if (eproto_type::proto_head == m_proto_type || eproto_type::proto_rpc == m_proto_type) {
+		m_delay_bytes = IO_BUFFER_SEND;
+	}
+#endif // DELAY_SEND
 	reset_dispatch_pkg(true);
 }
 
@@ -75,6 +86,7 @@ void socket_stream::connect(const char node_name[], const char service_name[], i
 	m_node_name = node_name;
 	m_service_name = service_name;
 	m_connecting_time = steady_ms() + timeout;
+	m_mgr->add_timer(this, m_connecting_time + 1);
 }
 
 void socket_stream::close() {
@@ -90,7 +102,10 @@ bool socket_stream::update(int64_t now,bool check_timeout) {
 	switch (m_link_status) {
 	case elink_status::link_closed: {
 #ifdef _MSC_VER
-		if (m_ovl_ref != 0) return true;
+		if (m_ovl_ref != 0) {
+			m_mgr->mark_dirty(this);
+			return true;
+		}
 #endif
 		if (m_socket != INVALID_SOCKET) {
 			m_mgr->unwatch(m_socket);
@@ -100,8 +115,11 @@ bool socket_stream::update(int64_t now,bool check_timeout) {
 		return false;
 	}
 	case elink_status::link_colsing: {
-		if (m_send_buffer.empty()) {
+		flush_send(now, true);
+		// 发送缓冲未清空时,由do_send发完后再标记
+		if (!send_pending()) {
 			m_link_status = elink_status::link_closed;
+			m_mgr->mark_dirty(this);
 		}
 		return true;
 	}
@@ -126,7 +144,9 @@ bool socket_stream::update(int64_t now,bool check_timeout) {
 					return true;
 				}
 			}
+			check_deadline();
 		}
+		flush_send(now, false);
 		dispatch_package(true);
 	}
 	}
@@ -274,68 +294,226 @@ int socket_stream::send(const void* data, size_t data_len)
 
 int socket_stream::sendv(const sendv_item items[], int count)
 {
-	int send_len = 0;
 	if (m_link_status != elink_status::link_connected)
-		return send_len;
+		return 0;
 
+	size_t total_len = 0;
 	for (int i = 0; i < count; i++) {
-		auto item = items[i];
-		send_len += stream_send((char*)item.data, item.len);
+		total_len += items[i].len;
+	}
+	if (total_len == 0)
+		return 0;
+
+	size_t send_len = 0;
+	if (!need_delay_send() && !send_pending() && !m_mgr->is_uring() && count <= SENDV_MAX_ITEMS) {
+		//发送缓冲为空时直接writev,只缓存未发完的部分
+		int ret = vectored_send(items, count);
+		send_len = ret > 0 ? ret : 0;
+		if (send_len == total_len)
+			return (int)total_len;
 	}
-	return send_len;
+	if (!buffer_send(items, count, send_len))
+		return 0;
+	if (!watch_send())
+		return 0;
+	return (int)total_len;
 }
 
-int socket_stream::stream_send(const char* data, size_t data_len)
+int socket_stream::sendv_shared(const sendv_item items[], int count, const shared_buffer& body)
 {
-	int total_len = data_len;
-	if (m_link_status != elink_status::link_connected || data_len == 0)
+	if (m_link_status != elink_status::link_connected)
 		return 0;
 
-	if (need_delay_send()) {//延迟发送
-		if (0 == m_send_buffer.push_data((const uint8_t*)data, data_len)) {
-			on_error(fmt::format("send-buffer-full:{},data:{},want:{}", m_send_buffer.capacity(), m_send_buffer.size(), data_len).c_str());
-			return 0;
+	//小包或可以直接发送时,拷贝比引用更划算
+	bool direct = !need_delay_send() && !send_pending() && !m_mgr->is_uring();
+	if ((body->size() < SHARED_SEND_MIN || direct) && count < SENDV_MAX_ITEMS) {
+		sendv_item full_items[SENDV_MAX_ITEMS];
+		std::copy(items, items + count, full_items);
+		full_items[count] = { body->data(), body->size() };
+		return sendv(full_items, count + 1);
+	}
+
+	size_t total_len = body->size();
+	for (int i = 0; i < count; i++) {
+		total_len += items[i].len;
+	}
+	if (!buffer_send(items, count, 0))
+		return 0;
+	//引用的数据同样计入发送缓冲上限,避免卡住的连接无限持有广播数据
+	size_t pending = m_send_buffer.size() + m_send_ref_bytes;
+	if (pending + body->size() > m_send_buffer.get_limit()) {
+		on_error(fmt::format("send-buffer-full:{},data:{},want:{}", m_send_buffer.get_limit(), pending, body->size()).c_str());
+		return 0;
+	}
+	m_send_refs.push_back({ m_send_pushed, body, 0 });
+	m_send_ref_bytes += body->size();
+	if (!watch_send())
+		return 0;
+	return (int)total_len;
+}
+
+int socket_stream::stream_send(const char* data, size_t data_len)
+{
+	sendv_item item = { data, data_len };
+	return sendv(&item, 1);
+}
+
+//将items从offset开始的部分写入发送缓冲
+bool socket_stream::buffer_send(const sendv_item items[], int count, size_t offset)
+{
+	for (int i = 0; i < count; i++) {
+		size_t item_len = items[i].len;
+		if (offset >= item_len) {
+			offset -= item_len;
+			continue;
 		}
-		if (m_send_buffer.size() > IO_BUFFER_SEND) {
-			do_send(UINT_MAX, false);
+		size_t want_len = item_len - offset;
+		if (0 == m_send_buffer.push_data((const uint8_t*)items[i].data + offset, want_len)) {
+			on_error(fmt::format("send-buffer-full:{},data:{},want:{}", m_send_buffer.capacity(), m_send_buffer.size(), want_len).c_str());
+			return false;
 		}
-	} else {
-		if (m_send_buffer.empty()) {
-			while (data_len > 0) {
-				int send_len = ::send(m_socket, data, (int)data_len, 0);
-				if (send_len == 0) {
-					on_error("connection-lost");
-					return 0;
-				}
-				if (send_len == SOCKET_ERROR) {
-					break;
-				}
-				data += send_len;
-				data_len -= send_len;
-			}
-			if (data_len == 0) {
-				return total_len;
+		m_send_pushed += want_len;
+		offset = 0;
+	}
+	return true;
+}
+
+//发送缓冲有积压,延迟发送超过阈值时立即发送,否则等待合并窗口或可写事件
+bool socket_stream::watch_send()
+{
+	if (need_delay_send()) {
+		if (m_send_buffer.size() + m_send_ref_bytes > m_delay_bytes) {
+			do_send(UINT_MAX, false);
+			if (m_link_status != elink_status::link_connected)
+				return false;
+		} else if (m_delay_time > 0) {
+			//窗口内的后续数据只追加,到期后在update中一次刷出
+			if (m_delay_expire == 0) {
+				m_delay_expire = steady_ms() + m_delay_time;
+				m_mgr->add_timer(this, m_delay_expire);
 			}
-		}
-		if (0 == m_send_buffer.push_data((const uint8_t*)data, data_len)) {
-			on_error(fmt::format("send-buffer-full:{},data:{},want:{}", m_send_buffer.capacity(), m_send_buffer.size(), data_len).c_str());
-			return 0;
+			return true;
 		}
 	}
+	return arm_send();
+}
 
+bool socket_stream::arm_send()
+{
 #if _MSC_VER
 	if (!wsa_send_empty(m_socket, m_send_ovl)) {
 		on_error("send-failed");
-		return 0;
+		return false;
 	}
 	m_ovl_ref++;
 #else
-	if (!m_mgr->watch_send(m_socket, this, true)) {
-		on_error("watch-error");
-		return 0;
+	if (m_mgr->is_edge_mode() || m_mgr->is_uring()) {
+		//EPOLLOUT常驻或io_uring时,积压数据在update中刷出
+		m_mgr->mark_dirty(this);
+	} else if (!m_send_watched) {
+		if (!m_mgr->watch_send(m_socket, this, true)) {
+			on_error("watch-error");
+			return false;
+		}
+		m_send_watched = true;
+	}
+#endif
+	return true;
+}
+
+//按发送顺序取出待发送的数据段(发送缓冲与共享引用交错),总长度不超过max_len
+int socket_stream::peek_send(sendv_item items[], size_t max_len)
+{
+	int count = 0;
+	size_t data_len = 0;
+	auto data = m_send_buffer.data(&data_len);
+	uint64_t cursor = m_send_popped;
+	for (auto& ref : m_send_refs) {
+		if (count + 2 > SENDV_MAX_ITEMS || max_len == 0)
+			return count;
+		size_t seg_len = (size_t)(ref.mark - cursor);
+		if (seg_len > 0) {
+			size_t len = std::min(seg_len, max_len);
+			items[count++] = { data, len };
+			if (len < seg_len)
+				return count;
+			data += len;
+			data_len -= len;
+			cursor += len;
+			max_len -= len;
+			if (max_len == 0)
+				return count;
+		}
+		size_t ref_len = ref.buff->size() - ref.pos;
+		size_t len = std::min(ref_len, max_len);
+		items[count++] = { ref.buff->data() + ref.pos, len };
+		if (len < ref_len)
+			return count;
+		max_len -= len;
+	}
+	if (data_len > 0 && max_len > 0 && count < SENDV_MAX_ITEMS) {
+		items[count++] = { data, std::min(data_len, max_len) };
+	}
+	return count;
+}
+
+//移除已发送的数据
+void socket_stream::pop_send(size_t len)
+{
+	while (len > 0) {
+		size_t buf_len = m_send_buffer.size();
+		if (!m_send_refs.empty()) {
+			buf_len = std::min<size_t>(buf_len, (size_t)(m_send_refs.front().mark - m_send_popped));
+		}
+		if (buf_len > 0) {
+			size_t pop_len = std::min(buf_len, len);
+			m_send_buffer.pop_size(pop_len);
+			m_send_popped += pop_len;
+			len -= pop_len;
+			continue;
+		}
+		auto& ref = m_send_refs.front();
+		size_t pop_len = std::min(ref.buff->size() - ref.pos, len);
+		ref.pos += pop_len;
+		m_send_ref_bytes -= pop_len;
+		len -= pop_len;
+		if (ref.pos == ref.buff->size()) {
+			m_send_refs.pop_front();
+		}
+	}
+}
+
+//一次系统调用发送全部items,返回实际发送的字节数,失败返回SOCKET_ERROR
+int socket_stream::vectored_send(const sendv_item items[], int count)
+{
+#ifdef _MSC_VER
+	WSABUF bufs[SENDV_MAX_ITEMS];
+	for (int i = 0; i < count; i++) {
+		bufs[i].buf = (char*)items[i].data;
+		bufs[i].len = (ULONG)items[i].len;
+	}
+	DWORD send_len = 0;
+	if (WSASend(m_socket, bufs, (DWORD)count, &send_len, 0, nullptr, nullptr) == SOCKET_ERROR)
+		return SOCKET_ERROR;
+	return (int)send_len;
+#else
+	iovec iovs[SENDV_MAX_ITEMS];
+	for (int i = 0; i < count; i++) {
+		iovs[i].iov_base = (void*)items[i].data;
+		iovs[i].iov_len = items[i].len;
+	}
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iovs;
+	msg.msg_iovlen = count;
+	while (true) {
+		auto send_len = ::sendmsg(m_socket, &msg, s_send_flag);
+		if (send_len >= 0)
+			return (int)send_len;
+		if (get_socket_error() != EINTR)
+			return SOCKET_ERROR;
 	}
 #endif
-	return total_len;
 }
 
 #ifdef _MSC_VER
@@ -373,7 +551,9 @@ void socket_stream::on_complete(WSAOVERLAPPED* ovl)
 	m_socket = INVALID_SOCKET;
 	if (m_next == nullptr) {
 		on_connect(false, "connect-failed");
+		return;
 	}
+	m_mgr->mark_dirty(this);
 }
 #endif
 
@@ -405,25 +585,38 @@ void socket_stream::on_can_send(size_t max_len, bool is_eof) {
 	m_socket = INVALID_SOCKET;
 	if (m_next == nullptr) {
 		on_connect(false, "connect-failed");
+		return;
 	}
+	m_mgr->mark_dirty(this);
 }
 #endif
 
 void socket_stream::do_send(size_t max_len, bool is_eof) {
+#ifdef SOCKET_URING
+	if (m_mgr->is_uring()) {
+		uring_send();
+		return;
+	}
+#endif
 	size_t total_send = 0;
 	while (total_send < max_len && (m_link_status != elink_status::link_closed)) {
-		size_t data_len = 0;
-		auto data = m_send_buffer.data(&data_len);
-		if (data_len == 0) {
-			if (!m_mgr->watch_send(m_socket, this, false)) {
-				on_error("do-watch-error");
-				return;
+		sendv_item items[SENDV_MAX_ITEMS];
+		int count = peek_send(items, max_len - total_send);
+		if (count == 0) {
+			if (m_send_watched) {
+				if (!m_mgr->watch_send(m_socket, this, false)) {
+					on_error("do-watch-error");
+					return;
+				}
+				m_send_watched = false;
+			}
+			if (m_link_status == elink_status::link_colsing) {
+				m_mgr->mark_dirty(this);
 			}
 			break;
 		}
 
-		size_t try_len = std::min<size_t>(data_len, max_len - total_send);
-		int send_len = ::send(m_socket, (char*)data, (int)try_len, s_send_flag);
+		int send_len = vectored_send(items, count);
 		if (send_len == SOCKET_ERROR) {
 			int err = get_socket_error();
 #ifdef _MSC_VER
@@ -452,7 +645,7 @@ void socket_stream::do_send(size_t max_len, bool is_eof) {
 			return;
 		}
 		total_send += send_len;
-		m_send_buffer.pop_size((size_t)send_len);
+		pop_send((size_t)send_len);
 	}
 	if (is_eof || max_len == 0) {
 		on_error("connection-lost");
@@ -461,6 +654,10 @@ void socket_stream::do_send(size_t max_len, bool is_eof) {
 
 void socket_stream::do_recv(size_t max_len, bool is_eof)
 {
+	// 没有积压时每次可读事件重新计算处理时长
+	if (!m_need_dispatch_pkg) {
+		reset_dispatch_pkg(false);
+	}
 	size_t total_recv = 0;
 	while (total_recv < max_len && m_link_status == elink_status::link_connected) {
 		auto* space = m_recv_buffer.peek_space(SOCKET_RECV_LEN);
@@ -468,7 +665,9 @@ void socket_stream::do_recv(size_t max_len, bool is_eof)
 			on_error(fmt::format("do-recv-buffer-full:{}", m_recv_buffer.size()).c_str());
 			return;
 		}
-		int recv_len = recv(m_socket, (char*)space, SOCKET_RECV_LEN, 0);
+		//按缓冲剩余空间整块读取,减少recv次数
+		size_t space_len = std::min<size_t>(m_recv_buffer.space(), SOCKET_RECV_MAX);
+		int recv_len = recv(m_socket, (char*)space, (int)space_len, 0);
 		if (recv_len < 0) {
 			int err = get_socket_error();
 #ifdef _MSC_VER
@@ -505,6 +704,115 @@ void socket_stream::do_recv(size_t max_len, bool is_eof)
 	}
 }
 
+#ifdef SOCKET_URING
+void socket_stream::on_uring(uring_op op, int res, bool more, const char* data) {
+	if (op == uring_op::send) {
+		m_uring_done++;
+		if (m_uring_done == m_uring_count) {
+			for (auto& chunk : m_uring_chunks) {
+				chunk.ref = nullptr;
+			}
+		}
+		if (m_link_status == elink_status::link_closed || res == -ECANCELED)
+			return;
+		//MSG_WAITALL下短写即失败,后续的链接被取消
+		if (res < 0 || (size_t)res < m_uring_chunks[m_uring_done - 1].len) {
+			if (m_link_status == elink_status::link_colsing) {
+				m_link_status = elink_status::link_closed;
+				m_mgr->mark_dirty(this);
+				return;
+			}
+			on_error(res == 0 ? "connection-lost-send-0" : "do-send-failed");
+			return;
+		}
+		//提交期间积压的数据在本次全部完成后接着发送
+		if (m_uring_done == m_uring_count) {
+			uring_send();
+		}
+		return;
+	}
+	// 关闭中不再接收,与do_recv一致
+	if (m_link_status != elink_status::link_connected)
+		return;
+	if (res > 0) {
+		if (!m_need_dispatch_pkg) {
+			reset_dispatch_pkg(false);
+		}
+		auto* space = m_recv_buffer.peek_space(res);
+		if (space == nullptr) {
+			on_error(fmt::format("do-recv-buffer-full:{}", m_recv_buffer.size()).c_str());
+			return;
+		}
+		memcpy(space, data, res);
+		m_recv_buffer.pop_space(res);
+		dispatch_package(false);
+	}
+	else if (res == 0) {
+		on_error("connection-lost-recv-0");
+		return;
+	}
+	else if (res != -ENOBUFS) {
+		on_error(fmt::format("do-recv-failed:{}", -res).c_str());
+		return;
+	}
+	//provided buffer用尽或multishot被内核终止时重新提交
+	if (!more && m_link_status == elink_status::link_connected) {
+		if (!m_mgr->watch_connected(m_socket, this)) {
+			on_error("watch-error");
+		}
+	}
+}
+
+//把积压的数据段作为一串链式send提交,上一串全部完成前不再提交
+void socket_stream::uring_send() {
+	if (m_uring_done < m_uring_count || m_socket == INVALID_SOCKET)
+		return;
+	sendv_item items[SENDV_MAX_ITEMS];
+	int count = peek_send(items, UINT_MAX);
+	if (count == 0) {
+		if (m_link_status == elink_status::link_colsing) {
+			m_mgr->mark_dirty(this);
+		}
+		return;
+	}
+	size_t buf_len = 0;
+	auto buf = (const char*)m_send_buffer.data(&buf_len);
+	size_t total_len = 0;
+	size_t ref_index = 0;
+	if (m_uring_chunks.size() < (size_t)count) {
+		m_uring_chunks.resize(count);
+	}
+	for (int i = 0; i < count; i++) {
+		auto& chunk = m_uring_chunks[i];
+		auto data = (const char*)items[i].data;
+		chunk.len = items[i].len;
+		if (data >= buf && data < buf + buf_len) {
+			chunk.copy.assign(data, chunk.len);
+			items[i].data = chunk.copy.data();
+		} else {
+			//peek_send按顺序取出共享数据,每个引用最多一段
+			chunk.ref = m_send_refs[ref_index++].buff;
+		}
+		total_len += chunk.len;
+	}
+	if (!m_mgr->uring_send(m_socket, this, items, count)) {
+		on_error("do-send-failed");
+		return;
+	}
+	m_uring_count = count;
+	m_uring_done = 0;
+	pop_send(total_len);
+}
+#endif
+
+bool socket_stream::send_pending() {
+#ifdef SOCKET_URING
+	if (m_uring_done < m_uring_count)
+		return true;
+#endif
+	return !m_send_buffer.empty() || !m_send_refs.empty();
+}
+
 void socket_stream::dispatch_package(bool reset) {
 	if (reset) {
 		reset_dispatch_pkg(false);
@@ -572,6 +880,7 @@ void socket_stream::dispatch_package(bool reset) {
 			//解析数据包头长度
 			slice* slice = m_recv_buffer.get_slice();
 			m_codec->set_slice(slice);
+			m_codec->set_state(&m_packet_state);
 			package_size = m_codec->load_packet(data_len);
 			//当前包头长度解析失败, 关闭连接
 			if (package_size < 0) {
@@ -612,6 +921,7 @@ void socket_stream::dispatch_package(bool reset) {
 		// 防止单个连接处理太久
 		if ((m_last_recv_time - m_tick_dispatch_time) > max_process_time()) {
 			m_need_dispatch_pkg = true;
+			m_mgr->mark_dirty(this);
 			m_stock_count++;
 			if (m_stock_count > 10) {// 连续积压10次处理不完,断开链接
 				on_error(fmt::format("busy cann't process count:{},data_len:{}",m_stock_count,m_recv_buffer.size()).c_str());
@@ -656,6 +966,7 @@ void socket_stream::on_error(const char err[]) {
 			m_socket = INVALID_SOCKET;
 		}
 		m_link_status = elink_status::link_closed;
+		m_mgr->mark_dirty(this);
 		m_error_cb(err);
 	}
 }
@@ -674,10 +985,13 @@ void socket_stream::on_connect(bool ok, const char reason[]) {
 				m_socket = INVALID_SOCKET;
 			}
 			m_link_status = elink_status::link_closed;
+			m_mgr->mark_dirty(this);
 		}
 		else {
 			m_link_status = elink_status::link_connected;
 			m_last_recv_time = steady_ms();
+			m_mgr->mark_dirty(this);
+			check_deadline();
 			send_handshake_rpc();
 		}
 		m_connect_cb(ok, reason);
@@ -702,14 +1016,61 @@ bool socket_stream::check_flow_ctrl(int64_t now) {
 	return false;
 }
 
+void socket_stream::check_deadline() {
+	if (m_link_status != elink_status::link_connected) return;
+	int64_t expire = 0;
+	if (m_timeout > 0) {
+		expire = m_last_recv_time + m_timeout + 1;
+	}
+	if (eproto_type::proto_head == m_proto_type && m_fc_ctrl_package > 0 && m_fc_ctrl_bytes > 0) {
+		int64_t fc_expire = m_last_fc_time + s_flow_ctrl_period;
+		expire = (expire == 0) ? fc_expire : std::min(expire, fc_expire);
+	}
+	if (m_delay_expire > 0) {
+		expire = (expire == 0) ? m_delay_expire : std::min(expire, m_delay_expire);
+	}
+	if (expire > 0) {
+		m_mgr->add_timer(this, expire);
+	}
+}
+
 //客户端延迟包发送
-bool socket_stream::need_delay_send() {
-#ifdef DELAY_SEND
-	if (eproto_type::proto_head == m_proto_type || eproto_type::proto_rpc == m_proto_type) {
-		return true;
+//合并窗口到期(或关闭)时刷出,边缘模式下不监听可写事件切换,由update主动刷出发送缓冲
+void socket_stream::flush_send(int64_t now, bool force) {
+	if (!send_pending()) {
+		m_delay_expire = 0;
+		return;
 	}
-#endif // DELAY_SEND
-	return false;
+	if (m_delay_expire > 0) {
+		if (!force && now < m_delay_expire)
+			return;
+		m_delay_expire = 0;
+		do_send(UINT_MAX, false);
+#if defined(__linux) || defined(__APPLE__)
+		//未发完的部分等待可写事件
+		if (m_link_status != elink_status::link_closed && send_pending()) {
+			arm_send();
+		}
+#endif
+		return;
+	}
+	if (m_mgr->is_edge_mode() || m_mgr->is_uring()) {
+		do_send(UINT_MAX, false);
+	}
+}
+
+//delay_bytes为0时关闭写合并,delay_time为0时在下一次wait中刷出
+void socket_stream::set_delay_send(int delay_time, int delay_bytes) {
+	m_delay_time = delay_time > 0 ? delay_time : 0;
+	m_delay_bytes = delay_bytes > 0 ? delay_bytes : 0;
+	if (m_delay_bytes == 0 && send_pending()) {
+		m_delay_expire = 0;
+		arm_send();
+	}
+}
+
+bool socket_stream::need_delay_send() {
+	return m_delay_bytes > 0;
 }
 
 int64_t socket_stream::max_process_time() {
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <deque>
 #include "socket_helper.h"
 #include "socket_mgr.h"
 
@@ -22,13 +23,24 @@ struct socket_stream : public socket_object
 	void set_package_callback(const std::function<void(slice*)>& cb) override { m_package_cb = cb; }
 	void set_error_callback(const std::function<void(const char*)>& cb) override { m_error_cb = cb; }
 	void set_connect_callback(const std::function<void(bool, const char*)>& cb) override { m_connect_cb = cb; }
-	void set_timeout(int duration) override { m_timeout = duration; }
+	void set_timeout(int duration) override { m_timeout = duration; check_deadline(); }
 	void set_nodelay(int flag) override { set_no_delay(m_socket, flag); }
-	void set_flow_ctrl(int ctrl_package, int ctrl_bytes) override { m_fc_ctrl_package = ctrl_package; m_fc_ctrl_bytes = ctrl_bytes; m_last_fc_time = steady_ms(); }
+	void set_flow_ctrl(int ctrl_package, int ctrl_bytes) override { m_fc_ctrl_package = ctrl_package; m_fc_ctrl_bytes = ctrl_bytes; m_last_fc_time = steady_ms(); check_deadline(); }
+	void set_delay_send(int delay_time, int delay_bytes) override;
+	void set_recv_limit(size_t limit) override { m_recv_buffer.set_limit(limit); }
 
 	int send(const void* data, size_t data_len) override;
 	int sendv(const sendv_item items[], int count) override;
+	int sendv_shared(const sendv_item items[], int count, const shared_buffer& body) override;
+	uint8_t next_send_seq() override { return m_send_seq_id++; }
 	int stream_send(const char* data, size_t data_len);
+	int vectored_send(const sendv_item items[], int count);
+	bool buffer_send(const sendv_item items[], int count, size_t offset);
+	bool watch_send();
+	bool arm_send();
+	int  peek_send(sendv_item items[], size_t max_len);
+	void pop_send(size_t len);
+	bool send_pending();
 
 #ifdef _MSC_VER
 	void on_complete(WSAOVERLAPPED* ovl) override;
@@ -39,6 +51,11 @@ struct socket_stream : public socket_object
 	void on_can_send(size_t max_len, bool is_eof) override;
 #endif
 
+#ifdef SOCKET_URING
+	void on_uring(uring_op op, int res, bool more, const char* data) override;
+	void uring_send();
+#endif
+
 	void do_send(size_t max_len, bool is_eof);
 	void do_recv(size_t max_len, bool is_eof);
 
@@ -49,14 +66,34 @@ struct socket_stream : public socket_object
 	void on_connect(bool ok, const char reason[]);
 	void reset_dispatch_pkg(bool init);
 	bool check_flow_ctrl(int64_t now);
+	void check_deadline();
 	bool need_delay_send();
 	int64_t max_process_time();
+	void flush_send(int64_t now, bool force);
 
 	socket_mgr* m_mgr = nullptr;
 	elink_type      m_link_type = elink_type::elink_tcp_client;
 	socket_t m_socket = INVALID_SOCKET;
 	luabuf m_recv_buffer;
 	luabuf m_send_buffer;
+	packet_state m_packet_state;    //文本协议的分段解析进度
+	bool m_send_watched = false;   //是否已监听可写事件
+
+	//写合并窗口: 积压超过delay_bytes或等待超过delay_time(ms)后刷出,delay_bytes为0时不合并
+	int m_delay_time = 0;
+	size_t m_delay_bytes = 0;
+	int64_t m_delay_expire = 0;
+
+	//广播的共享数据不拷贝进发送缓冲,按写入位置排在发送缓冲的数据之间
+	struct send_ref {
+		uint64_t mark;          //引用之前写入发送缓冲的总字节数
+		shared_buffer buff;
+		size_t pos;             //已发送的字节数
+	};
+	std::deque<send_ref> m_send_refs;
+	uint64_t m_send_pushed = 0;
+	uint64_t m_send_popped = 0;
+	size_t m_send_ref_bytes = 0;
 
 	std::string m_node_name;
 	std::string m_service_name;
@@ -70,6 +107,7 @@ struct socket_stream : public socket_object
 	uint8_t m_stock_count = 0;
 
 	uint8_t m_recv_seq_id = 0;
+	uint8_t m_send_seq_id = 0;
 	int64_t m_last_recv_time = 0;
 	int64_t m_connecting_time = 0;
 
@@ -87,6 +125,18 @@ struct socket_stream : public socket_object
 	int m_ovl_ref = 0;
 #endif
 
+#ifdef SOCKET_URING
+	//已提交的链式send,全部完成前内存不能变动: 发送缓冲的数据拷贝出来,共享数据持有引用
+	struct uring_chunk {
+		std::string copy;
+		shared_buffer ref;
+		size_t len;
+	};
+	std::vector<uring_chunk> m_uring_chunks;
+	int m_uring_count = 0;  //本次提交的send个数
+	int m_uring_done = 0;   //已完成的send个数
+#endif
+
 	std::function<void(int, eproto_type)> m_accept_cb = nullptr;
 	std::function<void(const char*)> m_error_cb = nullptr;
 	std::function<void(slice*)> m_package_cb = nullptr;
@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+
+// 分层时间轮(毫秒精度),结构同ltimer
+constexpr int WHEEL_NEAR_SHIFT = 8;
+constexpr int WHEEL_LEVEL_SHIFT = 6;
+constexpr int WHEEL_NEAR = (1 << WHEEL_NEAR_SHIFT);
+constexpr int WHEEL_LEVEL = (1 << WHEEL_LEVEL_SHIFT);
+constexpr int WHEEL_NEAR_MASK = (WHEEL_NEAR - 1);
+constexpr int WHEEL_LEVEL_MASK = (WHEEL_LEVEL - 1);
+constexpr uint64_t WHEEL_SPAN_MASK = 0xffffffffull; //四层时间轮覆盖的范围
+
+struct wheel_node {
+	uint64_t expire;
+	uint32_t token;
+};
+
+class timer_wheel
+{
+public:
+	using wheel_list = std::vector<wheel_node>;
+
+	void setup(uint64_t now) {
+		m_time = now;
+	}
+
+	// expire为绝对时间(steady_ms),已过期的节点在下一次update触发
+	void insert(uint32_t token, uint64_t expire) {
+		if (expire < m_time) {
+			expire = m_time;
+		}
+		add_node({ expire, token });
+		m_count++;
+	}
+
+	void update(uint64_t now, std::vector<uint32_t>& tokens) {
+		execute(tokens);
+		while (m_time < now) {
+			shift();
+			execute(tokens);
+		}
+	}
+
+	// 距离下一个到期节点的毫秒数, near中没有时返回到near末尾的距离(届时上层会移入)
+	uint64_t next_expire() {
+		uint64_t cur = m_time & WHEEL_NEAR_MASK;
+		for (uint64_t idx = cur; idx < WHEEL_NEAR; ++idx) {
+			if (!m_near[idx].empty()) return idx - cur;
+		}
+		return WHEEL_NEAR - cur;
+	}
+
+	size_t size() { return m_count; }
+
+protected:
+	void add_node(const wheel_node& node) {
+		uint64_t expire = node.expire;
+		if ((expire | WHEEL_NEAR_MASK) == (m_time | WHEEL_NEAR_MASK)) {
+			m_near[expire & WHEEL_NEAR_MASK].push_back(node);
+			return;
+		}
+		uint32_t i;
+		uint64_t mask = WHEEL_NEAR << WHEEL_LEVEL_SHIFT;
+		for (i = 0; i < 3; i++) {
+			if ((expire | (mask - 1)) == (m_time | (mask - 1))) {
+				break;
+			}
+			mask <<= WHEEL_LEVEL_SHIFT;
+		}
+		//超出当前2^32毫秒周期,等周期切换时再分配
+		if ((expire | WHEEL_SPAN_MASK) != (m_time | WHEEL_SPAN_MASK)) {
+			m_far.push_back(node);
+			return;
+		}
+		m_level[i][((expire >> (WHEEL_NEAR_SHIFT + i * WHEEL_LEVEL_SHIFT)) & WHEEL_LEVEL_MASK)].push_back(node);
+	}
+
+	void move_list(uint32_t level, uint32_t idx) {
+		wheel_list list;
+		list.swap(m_level[level][idx]);
+		for (auto& node : list) {
+			add_node(node);
+		}
+	}
+
+	void shift() {
+		uint64_t ct = ++m_time;
+		//进入新周期: 同ltimer中ct==0时的最高层移动
+		if ((ct & WHEEL_SPAN_MASK) == 0) {
+			wheel_list list;
+			list.swap(m_far);
+			for (auto& node : list) {
+				add_node(node);
+			}
+			return;
+		}
+		uint32_t i = 0;
+		uint64_t mask = WHEEL_NEAR;
+		uint64_t time = ct >> WHEEL_NEAR_SHIFT;
+		while ((ct & (mask - 1)) == 0 && i < 4) {
+			uint32_t idx = time & WHEEL_LEVEL_MASK;
+			if (idx != 0) {
+				move_list(i, idx);
+				break;
+			}
+			mask <<= WHEEL_LEVEL_SHIFT;
+			time >>= WHEEL_LEVEL_SHIFT;
+			++i;
+		}
+	}
+
+	void execute(std::vector<uint32_t>& tokens) {
+		auto& list = m_near[m_time & WHEEL_NEAR_MASK];
+		for (auto& node : list) {
+			tokens.push_back(node.token);
+		}
+		m_count -= list.size();
+		list.clear();
+	}
+
+private:
+	uint64_t m_time = 0;
+	size_t m_count = 0;
+	wheel_list m_near[WHEEL_NEAR];
+	wheel_list m_level[4][WHEEL_LEVEL];
+	wheel_list m_far;
+};
@@ -0,0 +1,439 @@
+#pragma once
+
+#if defined(__linux) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_POLL_ADD_MULTI) && defined(IORING_FEAT_EXT_ARG) && defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+#define SOCKET_URING
+#endif
+#endif
+
+#ifdef SOCKET_URING
+#include <poll.h>
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+constexpr uint32_t URING_MAX_ENTRIES = 4096;
+constexpr uint32_t URING_RECV_BUFS = 256;       //provided buffer个数(2的幂)
+constexpr uint32_t URING_RECV_SIZE = 16 * 1024; //单个provided buffer长度
+constexpr uint16_t URING_BUF_GROUP = 0;
+constexpr uint64_t URING_POLL_TAG = 1ull << 63; //poll请求的user_data标记,其余请求为对象指针|操作
+
+// 以对象指针为user_data的请求, 对象在请求全部完成前不能释放(socket_object::m_uring_ref)
+enum class uring_op : uint8_t {
+	accept = 1, //multishot accept, res为新连接的fd
+	recv = 2,   //multishot recv, 数据在provided buffer中
+	send = 3,   //链式send, 按提交顺序完成
+};
+
+// io_uring收发后端(不依赖liburing), 需要6.0以上内核, 否则回退到epoll
+// 监听socket提交multishot ACCEPT,已连接socket提交multishot RECV(从注册的provided buffer ring取缓冲),
+// 发送在update中把积压数据作为一串IOSQE_IO_LINK的SEND提交, 所有SQE在wait中与等待合并为一次io_uring_enter
+// 连接中的socket和跨线程唤醒仍使用multishot POLL_ADD
+class uring_poller
+{
+public:
+	struct uring_event {
+		uint64_t user_data;
+		int32_t res;
+		uint32_t flags;
+	};
+
+	~uring_poller() { close(); }
+
+	bool valid() { return m_fd >= 0; }
+
+	bool setup(uint32_t entries) {
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_CQSIZE;
+		params.cq_entries = entries * 4;
+		int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+		if (fd < 0)
+			return false;
+		m_fd = fd;
+		uint32_t need = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+		if ((params.features & need) != need || !map_rings(params) || !check_ops() || !setup_buffers()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+		if (m_buf_ring) {
+			io_uring_buf_reg reg;
+			memset(&reg, 0, sizeof(reg));
+			reg.bgid = URING_BUF_GROUP;
+			syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+		}
+		if (m_fd >= 0) ::close(m_fd);
+		if (m_sqes) munmap(m_sqes, m_sqes_len);
+		if (m_sq_ptr) munmap(m_sq_ptr, m_sq_len);
+		if (m_buf_ring) munmap(m_buf_ring, m_buf_len);
+		m_fd = -1;
+		m_sqes = nullptr;
+		m_sq_ptr = nullptr;
+		m_buf_ring = nullptr;
+	}
+
+	// 新增或替换fd的poll监听,events为POLLIN/POLLOUT组合(与EPOLLIN/EPOLLOUT取值相同)
+	bool watch(int fd, void* object, uint32_t events) {
+		auto node = get_node(fd);
+		if (node == nullptr)
+			return false;
+		events &= (POLLIN | POLLOUT);
+		if (node->events && !remove_poll(fd, node->gen))
+			return false;
+		node->object = object;
+		node->events = events;
+		node->gen = (node->gen + 1) & 0x7fffffff;
+		return add_poll(fd, node->gen, events);
+	}
+
+	bool accept(int fd, void* object) {
+		auto sqe = start_op(fd, object);
+		if (sqe == nullptr)
+			return false;
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->fd = fd;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->user_data = op_data(object, uring_op::accept);
+		return true;
+	}
+
+	bool recv(int fd, void* object) {
+		auto sqe = start_op(fd, object);
+		if (sqe == nullptr)
+			return false;
+		sqe->opcode = IORING_OP_RECV;
+		sqe->fd = fd;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = URING_BUF_GROUP;
+		sqe->user_data = op_data(object, uring_op::recv);
+		return true;
+	}
+
+	// 一次提交count个链式SEND,前一个完整发送后才开始下一个
+	// MSG_WAITALL使内核在部分发送时继续重试,短写即失败并取消后续链接
+	bool send(int fd, void* object, const iovec iovs[], int count) {
+		if (count <= 0 || !reserve((uint32_t)count))
+			return false;
+		for (int i = 0; i < count; i++) {
+			auto sqe = get_sqe();
+			sqe->opcode = IORING_OP_SEND;
+			sqe->fd = fd;
+			sqe->addr = (uint64_t)iovs[i].iov_base;
+			sqe->len = (uint32_t)iovs[i].iov_len;
+			sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+			sqe->flags = (i + 1 < count) ? IOSQE_IO_LINK : 0;
+			sqe->user_data = op_data(object, uring_op::send);
+		}
+		return true;
+	}
+
+	// 移除poll并取消该fd上对象的全部请求,被取消的请求以ECANCELED完成
+	void unwatch(int fd) {
+		if (fd < 0 || (size_t)fd >= m_nodes.size())
+			return;
+		auto& node = m_nodes[fd];
+		if (node.events) {
+			remove_poll(fd, node.gen);
+		}
+		if (node.ops) {
+			cancel(node.object, uring_op::accept);
+			cancel(node.object, uring_op::recv);
+			cancel(node.object, uring_op::send);
+		}
+		node.object = nullptr;
+		node.events = 0;
+		node.ops = false;
+		node.gen = (node.gen + 1) & 0x7fffffff;
+	}
+
+	// 提交积压的SQE并等待事件
+	// poll_handler(object, events): poll事件,按epoll的方式分发
+	// op_handler(object, op, res, more, data): 对象请求的完成,data为recv取到的provided buffer,分发后归还
+	template<typename P, typename O>
+	int wait(int timeout, P&& poll_handler, O&& op_handler) {
+		uint32_t ready = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE) - *m_cq_head;
+		enter(ready > 0 ? 0 : 1, timeout);
+		// 先取出全部CQE再分发,分发过程中可能产生新的SQE
+		m_events.clear();
+		uint32_t head = *m_cq_head;
+		uint32_t tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			auto& cqe = m_cqes[head & m_cq_mask];
+			if (cqe.user_data != 0) {
+				m_events.push_back({ cqe.user_data, cqe.res, cqe.flags });
+			}
+		}
+		__atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+		for (auto& evt : m_events) {
+			bool more = (evt.flags & IORING_CQE_F_MORE) != 0;
+			if (evt.user_data & URING_POLL_TAG) {
+				// 分发前再检查,之前的事件可能已经unwatch或替换了该fd
+				auto node = find_node(evt.user_data);
+				if (node == nullptr)
+					continue;
+				// 出错终止时按监听的事件分发一次, 由收发调用发现错误并关闭
+				if (evt.res > 0 || (evt.res < 0 && evt.res != -ECANCELED)) {
+					poll_handler(node->object, evt.res > 0 ? (uint32_t)evt.res : node->events);
+				}
+				// multishot被内核终止(如CQ溢出或出错)时需要重新注册, 被取消的除外
+				if (!more && evt.res != -ECANCELED) {
+					m_rearms.push_back(evt.user_data);
+				}
+				continue;
+			}
+			const char* data = nullptr;
+			uint16_t bid = 0;
+			if (evt.flags & IORING_CQE_F_BUFFER) {
+				bid = (uint16_t)(evt.flags >> IORING_CQE_BUFFER_SHIFT);
+				data = m_buf_base + (size_t)bid * URING_RECV_SIZE;
+			}
+			op_handler((void*)(evt.user_data & ~(uint64_t)7), (uring_op)(evt.user_data & 7), evt.res, more, data);
+			if (data) {
+				recycle(bid);
+			}
+		}
+		__atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+		for (auto user_data : m_rearms) {
+			auto node = find_node(user_data);
+			if (node) {
+				watch((int)(user_data & 0xffffffff), node->object, node->events);
+			}
+		}
+		m_rearms.clear();
+		return (int)m_events.size();
+	}
+
+protected:
+	struct poll_node {
+		void* object = nullptr;
+		uint32_t events = 0;  //poll监听的事件,0表示没有poll
+		uint32_t gen = 0;
+		bool ops = false;     //是否提交过对象请求(accept/recv/send)
+	};
+
+	static uint64_t op_data(void* object, uring_op op) {
+		return (uint64_t)object | (uint64_t)op;
+	}
+
+	poll_node* get_node(int fd) {
+		if (fd < 0)
+			return nullptr;
+		if ((size_t)fd >= m_nodes.size()) {
+			m_nodes.resize(fd + 1);
+		}
+		return &m_nodes[fd];
+	}
+
+	poll_node* find_node(uint64_t user_data) {
+		uint32_t fd = user_data & 0xffffffff;
+		uint32_t gen = (user_data >> 32) & 0x7fffffff;
+		if (fd >= m_nodes.size())
+			return nullptr;
+		auto& node = m_nodes[fd];
+		if (node.events == 0 || node.gen != gen)
+			return nullptr;
+		return &node;
+	}
+
+	// 对象请求替换该fd上的poll(连接完成后由poll转为recv)
+	io_uring_sqe* start_op(int fd, void* object) {
+		auto node = get_node(fd);
+		if (node == nullptr)
+			return nullptr;
+		if (node->events) {
+			remove_poll(fd, node->gen);
+			node->events = 0;
+			node->gen = (node->gen + 1) & 0x7fffffff;
+		}
+		node->object = object;
+		node->ops = true;
+		return get_sqe();
+	}
+
+	bool add_poll(int fd, uint32_t gen, uint32_t events) {
+		auto sqe = get_sqe();
+		if (sqe == nullptr)
+			return false;
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->fd = fd;
+		sqe->poll32_events = events;
+		sqe->len = IORING_POLL_ADD_MULTI;
+		sqe->user_data = URING_POLL_TAG | ((uint64_t)gen << 32) | (uint32_t)fd;
+		return true;
+	}
+
+	bool remove_poll(int fd, uint32_t gen) {
+		auto sqe = get_sqe();
+		if (sqe == nullptr)
+			return false;
+		//POLL_REMOVE在poll唤醒处理中会返回EALREADY而不取消,这里用ASYNC_CANCEL
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = URING_POLL_TAG | ((uint64_t)gen << 32) | (uint32_t)fd;
+		sqe->user_data = 0;
+		return true;
+	}
+
+	// fd关闭后不能按fd取消,按user_data取消该对象同类的全部请求
+	void cancel(void* object, uring_op op) {
+		auto sqe = get_sqe();
+		if (sqe == nullptr)
+			return;
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->addr = op_data(object, op);
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = 0;
+	}
+
+	// 链式请求必须在同一次提交中,空间不足时先提交已有的SQE
+	bool reserve(uint32_t count) {
+		if (m_sq_entries - (m_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE)) < count) {
+			enter(0, 0);
+		}
+		return m_sq_entries - (m_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE)) >= count;
+	}
+
+	io_uring_sqe* get_sqe() {
+		if (!reserve(1))
+			return nullptr;
+		uint32_t idx = m_local_tail & m_sq_mask;
+		auto sqe = &m_sqes[idx];
+		memset(sqe, 0, sizeof(io_uring_sqe));
+		m_sq_array[idx] = idx;
+		m_local_tail++;
+		return sqe;
+	}
+
+	int enter(uint32_t wait_nr, int timeout) {
+		__atomic_store_n(m_sq_tail, m_local_tail, __ATOMIC_RELEASE);
+		uint32_t submit = m_local_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE);
+		if (submit == 0 && wait_nr == 0)
+			return 0;
+		uint32_t flags = 0;
+		__kernel_timespec ts;
+		io_uring_getevents_arg arg;
+		memset(&arg, 0, sizeof(arg));
+		if (wait_nr > 0) {
+			flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+			if (timeout >= 0) {
+				ts.tv_sec = timeout / 1000;
+				ts.tv_nsec = (timeout % 1000) * 1000000;
+				arg.ts = (uint64_t)&ts;
+			}
+		}
+		return (int)syscall(__NR_io_uring_enter, m_fd, submit, wait_nr, flags, wait_nr > 0 ? &arg : nullptr, sizeof(arg));
+	}
+
+	bool map_rings(const io_uring_params& params) {
+		m_sq_len = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+		size_t cq_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		m_sq_len = std::max(m_sq_len, cq_len);
+		void* sq_ptr = mmap(nullptr, m_sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+		if (sq_ptr == MAP_FAILED)
+			return false;
+		m_sq_ptr = sq_ptr;
+		m_sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = mmap(nullptr, m_sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED)
+			return false;
+		m_sqes = (io_uring_sqe*)sqes;
+		auto sq = (uint8_t*)m_sq_ptr;
+		m_sq_head = (uint32_t*)(sq + params.sq_off.head);
+		m_sq_tail = (uint32_t*)(sq + params.sq_off.tail);
+		m_sq_mask = *(uint32_t*)(sq + params.sq_off.ring_mask);
+		m_sq_array = (uint32_t*)(sq + params.sq_off.array);
+		m_sq_entries = params.sq_entries;
+		// SINGLE_MMAP: CQ与SQ共用一块映射
+		m_cq_head = (uint32_t*)(sq + params.cq_off.head);
+		m_cq_tail = (uint32_t*)(sq + params.cq_off.tail);
+		m_cq_mask = *(uint32_t*)(sq + params.cq_off.ring_mask);
+		m_cqes = (io_uring_cqe*)(sq + params.cq_off.cqes);
+		m_local_tail = *m_sq_tail;
+		return true;
+	}
+
+	// multishot recv与SEND_ZC同在6.0加入,以SEND_ZC是否支持判断内核版本
+	bool check_ops() {
+		std::vector<uint8_t> mem(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+		auto probe = (io_uring_probe*)mem.data();
+		if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+			return false;
+		uint8_t op = IORING_OP_SEND_ZC;
+		return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+	}
+
+	// provided buffer ring: ring与缓冲放在同一块匿名映射,ring起始地址需要页对齐
+	bool setup_buffers() {
+		size_t ring_len = URING_RECV_BUFS * sizeof(io_uring_buf);
+		m_buf_len = ring_len + (size_t)URING_RECV_BUFS * URING_RECV_SIZE;
+		void* mem = mmap(nullptr, m_buf_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED)
+			return false;
+		m_buf_ring = (io_uring_buf_ring*)mem;
+		m_buf_base = (char*)mem + ring_len;
+		io_uring_buf_reg reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.ring_addr = (uint64_t)mem;
+		reg.ring_entries = URING_RECV_BUFS;
+		reg.bgid = URING_BUF_GROUP;
+		if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+			munmap(mem, m_buf_len);
+			m_buf_ring = nullptr;
+			return false;
+		}
+		for (uint32_t bid = 0; bid < URING_RECV_BUFS; bid++) {
+			recycle((uint16_t)bid);
+		}
+		__atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	// 归还缓冲,tail在本轮分发结束后统一发布
+	void recycle(uint16_t bid) {
+		// bufs[0].resv与ring的tail重叠,只写addr/len/bid
+		// C++下bufs柔性数组前的空结构体占位导致偏移不为0,直接按io_uring_buf数组访问
+		auto& buf = ((io_uring_buf*)m_buf_ring)[m_buf_tail & (URING_RECV_BUFS - 1)];
+		buf.addr = (uint64_t)(m_buf_base + (size_t)bid * URING_RECV_SIZE);
+		buf.len = URING_RECV_SIZE;
+		buf.bid = bid;
+		m_buf_tail++;
+	}
+
+private:
+	int m_fd = -1;
+	void* m_sq_ptr = nullptr;
+	size_t m_sq_len = 0;
+	size_t m_sqes_len = 0;
+	io_uring_sqe* m_sqes = nullptr;
+	io_uring_cqe* m_cqes = nullptr;
+	uint32_t* m_sq_head = nullptr;
+	uint32_t* m_sq_tail = nullptr;
+	uint32_t* m_sq_array = nullptr;
+	uint32_t* m_cq_head = nullptr;
+	uint32_t* m_cq_tail = nullptr;
+	uint32_t m_sq_mask = 0;
+	uint32_t m_cq_mask = 0;
+	uint32_t m_sq_entries = 0;
+	uint32_t m_local_tail = 0;
+	io_uring_buf_ring* m_buf_ring = nullptr;
+	char* m_buf_base = nullptr;
+	size_t m_buf_len = 0;
+	uint16_t m_buf_tail = 0;
+	std::vector<poll_node> m_nodes;
+	std::vector<uring_event> m_events;
+	std::vector<uint64_t> m_rearms;
+};
+#endif
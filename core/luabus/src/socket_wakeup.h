@@ -0,0 +1,27 @@
+#pragma once
+
+#include "socket_helper.h"
+#include "socket_mgr.h"
+
+// 跨线程唤醒: 监听其他线程写入的eventfd,使wait提前返回
+// fd由写入方持有,这里只负责读空计数
+struct socket_wakeup : public socket_object
+{
+	socket_wakeup(socket_t fd) : m_fd(fd) { m_link_status = elink_status::link_connected; }
+	bool get_remote_ip(std::string& ip) override { return false; }
+	bool update(int64_t now, bool check_timeout) override { return m_link_status != elink_status::link_closed; }
+
+#ifdef _MSC_VER
+	void on_complete(WSAOVERLAPPED* ovl) override { }
+#endif
+
+#if defined(__linux) || defined(__APPLE__)
+	void on_can_recv(size_t max_len, bool is_eof) override {
+		uint64_t value;
+		while (::read(m_fd, &value, sizeof(value)) > 0);
+	}
+#endif
+
+private:
+	socket_t m_fd = INVALID_SOCKET;
+};
@@ -0,0 +1,78 @@
+// socket_timer_test.cpp
+// 时间轮: 定时器跨越2^32毫秒周期时仍然按时触发
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include "socket_timer.h"
+
+#define CHECK(cond) do { if (!(cond)) { printf("%s:%d check failed: %s\n", __FILE__, __LINE__, #cond); exit(1); } } while (0)
+
+static void test_wrap() {
+	const uint64_t span = 1ull << 32;
+	const uint64_t step = 1000;
+	const uint64_t expires[] = { span - 100, span, span + 50, span + 70000, span + 3000000, span * 2 + 10 };
+	const uint32_t count = sizeof(expires) / sizeof(expires[0]);
+	timer_wheel wheel;
+	wheel.setup(span - 300);
+	for (uint32_t token = 0; token < count; ++token) {
+		wheel.insert(token, expires[token]);
+	}
+	std::map<uint32_t, uint64_t> fired;
+	std::vector<uint32_t> tokens;
+	for (uint64_t now = span - 300; now <= span + 4000000; now += step) {
+		tokens.clear();
+		wheel.update(now, tokens);
+		for (auto token : tokens) {
+			CHECK(fired.find(token) == fired.end());
+			CHECK(expires[token] <= now && now < expires[token] + step);
+			fired[token] = now;
+		}
+	}
+	for (uint32_t token = 0; token < count - 1; ++token) {
+		CHECK(fired.find(token) != fired.end());
+	}
+	CHECK(fired.find(count - 1) == fired.end());
+	CHECK(wheel.size() == 1);
+}
+
+//过期时间早于当前时间的在下一次update触发
+static void test_expired() {
+	timer_wheel wheel;
+	wheel.setup(5000);
+	wheel.insert(1, 100);
+	wheel.insert(2, 5300);
+	std::vector<uint32_t> tokens;
+	wheel.update(5000, tokens);
+	CHECK(tokens.size() == 1 && tokens[0] == 1);
+	tokens.clear();
+	wheel.update(5299, tokens);
+	CHECK(tokens.empty());
+	wheel.update(5300, tokens);
+	CHECK(tokens.size() == 1 && tokens[0] == 2 && wheel.size() == 0);
+}
+
+//next_expire: near中的最近节点, 否则到near末尾
+static void test_next_expire() {
+	timer_wheel wheel;
+	wheel.setup(1000);
+	std::vector<uint32_t> tokens;
+	CHECK(wheel.next_expire() == WHEEL_NEAR - (1000 & WHEEL_NEAR_MASK));
+	wheel.insert(1, 1010);
+	wheel.insert(2, 1005);
+	wheel.insert(3, 1000 + 5000);
+	CHECK(wheel.next_expire() == 5);
+	wheel.update(1005, tokens);
+	CHECK(tokens.size() == 1 && tokens[0] == 2);
+	CHECK(wheel.next_expire() == 5);
+	wheel.update(1010, tokens);
+	CHECK(wheel.next_expire() == WHEEL_NEAR - (1010 & WHEEL_NEAR_MASK));
+}
+
+int main() {
+	test_wrap();
+	test_expired();
+	test_next_expire();
+	printf("socket_timer_test pass\n");
+	return 0;
+}
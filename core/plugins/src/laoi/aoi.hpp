@@ -81,6 +81,11 @@ public:
 		}
 		return res;
 	}
+	//格子序号
+	int get_tile_index(int x, int y) const
+	{
+		return get_tile_y(y) * count_ + get_tile_x(x);
+	}
 	//构建矩形
 	rect<int> make_rect(int x, int y, int w, int h) const
 	{
@@ -294,6 +299,17 @@ public:
 		return true;
 	}
 
+	//只更新坐标,视野和层级不变
+	bool update_pos(object_handle_type handle, int x, int y)
+	{
+		auto iter = objects_.find(handle);
+		if (iter == objects_.end())
+		{
+			return false;
+		}
+		return update(handle, x, y, iter->second.w, iter->second.h, iter->second.layer);
+	}
+
 	template<typename... Args>
 	void query(int x, int y, int w, int h, std::vector<int64_t>& out, Args&&...args)
 	{
@@ -416,6 +432,12 @@ public:
 		return event_queue_;
 	}
 
+	//格子数
+	size_t tile_count() const
+	{
+		return (size_t)count_ * count_;
+	}
+
 	template<typename Handler>
 	void for_each_all(const Handler& hander, int filter) const
 	{
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+//aoi并行处理的线程池
+//run把[0, n)个任务分给工作线程和调用线程, 全部完成后返回
+class aoi_pool
+{
+public:
+	aoi_pool(int threads)
+	{
+		for (int i = 1; i < threads; ++i)
+		{
+			workers_.emplace_back([this]() { loop(); });
+		}
+	}
+
+	~aoi_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		work_cv_.notify_all();
+		for (auto& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	int size() const
+	{
+		return (int)workers_.size() + 1;
+	}
+
+	void run(int count, const std::function<void(int)>& fn)
+	{
+		if (workers_.empty() || count <= 1)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				fn(i);
+			}
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			fn_ = &fn;
+			count_ = count;
+			next_ = 0;
+			++generation_;
+		}
+		work_cv_.notify_all();
+		work(fn, count);
+		std::unique_lock<std::mutex> lock(mutex_);
+		done_cv_.wait(lock, [this]() { return active_ == 0; });
+		//之后才醒来的工作线程看到空任务直接跳过
+		fn_ = nullptr;
+		count_ = 0;
+	}
+
+private:
+	void work(const std::function<void(int)>& fn, int count)
+	{
+		int index;
+		while ((index = next_.fetch_add(1)) < count)
+		{
+			fn(index);
+		}
+	}
+
+	void loop()
+	{
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true)
+		{
+			work_cv_.wait(lock, [&]() { return stop_ || generation_ != seen; });
+			if (stop_) return;
+			seen = generation_;
+			if (!fn_) continue;
+			auto fn = fn_;
+			int count = count_;
+			++active_;
+			lock.unlock();
+			work(*fn, count);
+			lock.lock();
+			if (--active_ == 0)
+			{
+				done_cv_.notify_all();
+			}
+		}
+	}
+
+private:
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable work_cv_;
+	std::condition_variable done_cv_;
+	const std::function<void(int)>* fn_ = nullptr;
+	std::atomic<int> next_ = 0;
+	int count_ = 0;
+	int active_ = 0;
+	uint64_t generation_ = 0;
+	bool stop_ = false;
+};
@@ -0,0 +1,833 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+#include "math.hpp"
+#include "aoi_pool.hpp"
+
+//aoi的稠密存储版本,接口和事件与aoi一致
+//对象存放在连续槽位中,坐标等字段按数组分开存放(SoA),格子内只保存槽位索引,删除时与末尾交换
+template<class AoiObject>
+class dense_aoi
+{
+public:
+	enum mode
+	{
+		watcher = 1,        //观察者(玩家)
+		marker = 1 << 1    //被观察者(被看的东西,玩家)
+	};
+	enum event_type
+	{
+		event_enter = 1,
+		event_leave = 2,
+	};
+
+	using object_type = AoiObject;//对象类型
+	using object_handle_type = typename object_type::handle_type;//对象的索引类型
+	using slot_type = uint32_t;//对象槽位
+
+	struct aoi_event
+	{
+		int eventid = 0; //enum event_type
+		object_handle_type watcher = object_handle_type{};
+		object_handle_type marker = object_handle_type{};
+
+		aoi_event(int eid, object_handle_type w, object_handle_type m)
+			:eventid(eid)
+			, watcher(w)
+			, marker(m)
+		{
+		}
+	};
+private:
+	struct tile
+	{
+		std::vector<slot_type> markers;    //被观察者槽位
+		std::vector<slot_type> watchers;   //观察者槽位
+		std::vector<slot_type> departed;   //并行更新时本帧移出的被观察者
+	};
+	//并行更新中对比可见集合的临时数据, 每个分段一份
+	struct diff_context
+	{
+		uint32_t stamp = 0;
+		std::vector<uint32_t> stamps;
+		std::vector<slot_type> before;
+		std::vector<object_handle_type> enters;
+		std::vector<object_handle_type> leaves;
+	};
+	//并行更新中移动的对象
+	struct moved_object
+	{
+		slot_type slot;
+		int32_t x;
+		int32_t y;
+	};
+public:
+	//x,y为地图偏移,为了对齐前端坐标,一般0,0即可
+	dense_aoi(int posx, int posy, int map_size, int tile_size)
+		:rect_(posx, posy, map_size, map_size)
+		, tile_size_(tile_size)
+		, map_size_(map_size)
+		, count_(map_size / tile_size)
+	{
+		assert(map_size % tile_size == 0);
+		data_.resize(count_ * count_);
+	}
+
+	//格子坐标x
+	constexpr int get_tile_x(int v) const
+	{
+		auto res = (v - rect_.x) / tile_size_;
+		if (res >= count_)
+		{
+			res = count_ - 1;
+		}
+		return res;
+	}
+	//格子坐标y
+	constexpr int get_tile_y(int v) const
+	{
+		auto res = (v - rect_.y) / tile_size_;
+		if (res >= count_)
+		{
+			res = count_ - 1;
+		}
+		return res;
+	}
+	//格子序号
+	int get_tile_index(int x, int y) const
+	{
+		return get_tile_y(y) * count_ + get_tile_x(x);
+	}
+	//构建矩形
+	rect<int> make_rect(int x, int y, int w, int h) const
+	{
+		auto left = (std::clamp(x - w / 2, rect_.left(), rect_.right()));
+		auto right = (std::clamp(x + w / 2, rect_.left(), rect_.right()));
+		auto bottom = (std::clamp(y - h / 2, rect_.bottom(), rect_.top()));
+		auto top = (std::clamp(y + h / 2, rect_.bottom(), rect_.top()));
+		return rect<int>{ left, bottom, right - left, top - bottom };
+	}
+	//构建格子坐标矩形
+	rect<int> make_tile_rect(int x, int y, int w, int h) const
+	{
+		auto left = get_tile_x(std::clamp(x - w / 2, rect_.left(), rect_.right()));
+		auto right = get_tile_x(std::clamp(x + w / 2, rect_.left(), rect_.right()));
+		auto bottom = get_tile_y(std::clamp(y - h / 2, rect_.bottom(), rect_.top()));
+		auto top = get_tile_y(std::clamp(y + h / 2, rect_.bottom(), rect_.top()));
+		return rect<int>{ left, bottom, right - left, top - bottom };
+	}
+	//插入管理对象, 参数同aoi::insert
+	bool insert(object_handle_type handle, int x, int y, int w, int h, int layer, int mode, bool range_marker = false)
+	{
+		if (!rect_.contains(x, y))
+		{
+			return false;
+		}
+		auto res = index_.try_emplace(handle, 0);
+		if (!res.second)
+		{
+			return false;
+		}
+		slot_type s = alloc_slot(handle, x, y, w, h, layer, mode);
+		res.first->second = s;
+		//被观察者
+		if (mode & marker) {
+			if (range_marker && w > 0 && h > 0) {//范围建筑
+				assert(!(mode & watcher) && "unsupport");
+				for_each_rect(make_tile_rect(x, y, w, h), [this, s](int tx, int ty) {
+					insert_marker(s, tx, ty);
+					});
+			}
+			else {
+				insert_marker(s, get_tile_x(x), get_tile_y(y));
+			}
+		}
+		//观察者
+		if (mode & watcher) {
+			auto rc = make_rect(x, y, w, h);
+			for_each_rect(make_tile_rect(x, y, w, h), [this, s, &rc](int tx, int ty) {
+				tile& t = data_[ty * count_ + tx];
+				insert_watcher(t, s);
+				if (debug_) {
+					std::cout << handles_[s] << " watch (" << tx << "," << ty << ")" << std::endl;
+				}
+				update_watcher(t, rect<int>{-1, -1, 0, 0}, rc, s);
+				});
+		}
+		return true;
+	}
+	//对象事件
+	void fire_event(object_handle_type handle, int eventid)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end()) {
+			return;
+		}
+		slot_type s = iter->second;
+		tile& t = data_[get_tile_y(ys_[s]) * count_ + get_tile_x(xs_[s])];
+		marker_event(t, s, eventid);
+	}
+
+	// update pos, view width, view height, layer
+	bool update(object_handle_type handle, int x, int y, int w, int h, int layer)
+	{
+		if (!rect_.contains(x, y) || w < 0 || h < 0)
+		{
+			return false;
+		}
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return false;
+		}
+		slot_type s = iter->second;
+		auto old_rect = make_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+		auto old_tile_rect = make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+
+		auto old_x = xs_[s];
+		auto old_y = ys_[s];
+		xs_[s] = x;
+		ys_[s] = y;
+		hs_[s] = h;
+		ws_[s] = w;
+		layers_[s] = layer;
+
+		if (modes_[s] & marker)
+		{
+			update_marker(s, old_x, old_y);
+		}
+		if (!(modes_[s] & watcher))
+		{
+			return true;
+		}
+		auto new_rect = make_rect(x, y, w, h);
+		auto new_tile_rect = make_tile_rect(x, y, w, h);
+		//视野缩小: 只需处理旧格子
+		if (old_rect.contains(new_rect))
+		{
+			for_each_rect(old_tile_rect, [&](int tx, int ty) {
+				auto rc = rect<int>{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+				if (new_rect.contains(rc))
+				{
+					return;
+				}
+				tile& t = data_[ty * count_ + tx];
+				if (!new_tile_rect.contains(tx, ty))
+				{
+					remove_watcher(t, s);
+					if (debug_)
+					{
+						std::cout << handles_[s] << " unwatch (" << tx << "," << ty << ")" << std::endl;
+					}
+				}
+				update_watcher(t, old_rect, new_rect, s);
+				});
+			return true;
+		}
+		for_each_rect(old_tile_rect, [&](int tx, int ty) {
+			auto rc = rect<int>{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+			if (new_rect.contains(rc))
+			{
+				return;
+			}
+			tile& t = data_[ty * count_ + tx];
+			if (!new_tile_rect.contains(tx, ty))
+			{
+				remove_watcher(t, s);
+				if (debug_)
+				{
+					std::cout << handles_[s] << " unwatch (" << tx << "," << ty << ")" << std::endl;
+				}
+			}
+			update_watcher(t, old_rect, new_rect, s, false, true);
+			});
+		for_each_rect(new_tile_rect, [&](int tx, int ty) {
+			auto rc = rect<int>{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+			if (old_rect.contains(rc))
+			{
+				return;
+			}
+			tile& t = data_[ty * count_ + tx];
+			if (!old_tile_rect.contains(tx, ty))
+			{
+				insert_watcher(t, s);
+				if (debug_)
+				{
+					std::cout << handles_[s] << " watch (" << tx << "," << ty << ")" << std::endl;
+				}
+			}
+			update_watcher(t, old_rect, new_rect, s, true, false);
+			});
+		return true;
+	}
+
+	//只更新坐标,视野和层级不变
+	bool update_pos(object_handle_type handle, int x, int y)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return false;
+		}
+		slot_type s = iter->second;
+		return update(handle, x, y, ws_[s], hs_[s], layers_[s]);
+	}
+
+	//并行批量更新坐标, moves中handle不能重复
+	//1.格子按行分成与线程数相同的区域,只涉及单个区域格子的移动在各区域内并行执行,跨区域的移动随后串行合并
+	//2.受影响的观察者按handle排序后分段并行,对比移动前后的可见集合生成进出事件(只读)
+	//3.按分段顺序合并事件,结果与线程数无关
+	template<typename Moves>
+	void update_parallel(const Moves& moves, aoi_pool& pool)
+	{
+		event_queue_.clear();
+		size_t slots = handles_.size();
+		moved_.assign(slots, 0);
+		old_xs_.resize(slots);
+		old_ys_.resize(slots);
+		old_tiles_.resize(slots);
+		int regions = std::max(1, std::min(pool.size(), count_));
+		std::vector<std::vector<moved_object>> locals(regions);
+		std::vector<moved_object> crosses;
+		for (const auto& move : moves)
+		{
+			auto iter = index_.find(move.handle);
+			if (iter == index_.end() || !rect_.contains(move.x, move.y))
+			{
+				continue;
+			}
+			moved_object mo{ iter->second, move.x, move.y };
+			int region = move_region(mo, regions);
+			if (region < 0)
+				crosses.push_back(mo);
+			else
+				locals[region].push_back(mo);
+		}
+		//区域内移动
+		std::vector<std::vector<slot_type>> dirties(regions + 1);
+		pool.run(regions, [&](int region) {
+			for (const auto& mo : locals[region])
+			{
+				apply_move(mo, dirties[region]);
+			}
+			});
+		//跨区域移动
+		for (const auto& mo : crosses)
+		{
+			apply_move(mo, dirties[regions]);
+		}
+		std::vector<slot_type> dirty;
+		for (auto& d : dirties)
+		{
+			dirty.insert(dirty.end(), d.begin(), d.end());
+		}
+		std::sort(dirty.begin(), dirty.end(), [this](slot_type a, slot_type b) {
+			return handles_[a] < handles_[b];
+		});
+		dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+		//生成事件
+		int chunks = std::min((int)dirty.size(), pool.size() * 4);
+		std::vector<std::vector<aoi_event>> events(chunks);
+		pool.run(chunks, [&](int chunk) {
+			size_t begin = dirty.size() * chunk / chunks;
+			size_t end = dirty.size() * (chunk + 1) / chunks;
+			diff_context ctx;
+			ctx.stamps.assign(slots, 0);
+			for (size_t i = begin; i < end; ++i)
+			{
+				diff_watcher(dirty[i], ctx, events[chunk]);
+			}
+			});
+		for (auto& evts : events)
+		{
+			event_queue_.insert(event_queue_.end(), evts.begin(), evts.end());
+		}
+		for (const auto& tile : departed_tiles_)
+		{
+			data_[tile].departed.clear();
+		}
+		departed_tiles_.clear();
+	}
+
+	void query(int x, int y, int w, int h, std::vector<int64_t>& out)
+	{
+		auto rc = make_rect(x, y, w, h);
+		auto tile_rc = make_tile_rect(x, y, w, h);
+
+		int start_index_x = tile_rc.x;
+		int start_index_y = tile_rc.y;
+		int end_index_x = tile_rc.right();
+		int end_index_y = tile_rc.top();
+		for (int i = start_index_x; i <= end_index_x; ++i)
+		{
+			bool is_x_edge = (i == start_index_x) || (i == end_index_x);
+			for (int j = start_index_y; j <= end_index_y; ++j)
+			{
+				bool is_edge = is_x_edge || (j == start_index_y) || (j == end_index_y);
+				const tile& node = data_[j * count_ + i];
+				for (slot_type m : node.markers)
+				{
+					//边缘格子需要逐个判断坐标
+					if (!is_edge || rc.contains(xs_[m], ys_[m]))
+					{
+						out.push_back(handles_[m]);
+					}
+				}
+			}
+		}
+	}
+
+	void clear()
+	{
+		for (tile& n : data_)
+		{
+			n.markers.clear();
+			n.watchers.clear();
+		}
+		index_.clear();
+		free_.clear();
+		xs_.clear();
+		ys_.clear();
+		ws_.clear();
+		hs_.clear();
+		layers_.clear();
+		modes_.clear();
+		handles_.clear();
+	}
+
+	void erase(object_handle_type handle)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return;
+		}
+		slot_type s = iter->second;
+		if (modes_[s] & marker)
+		{
+			if (ws_[s] > 0 && hs_[s] > 0)
+			{
+				for_each_rect(make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]), [this, s](int tx, int ty) {
+					remove_marker(s, tx, ty);
+					});
+			}
+			else
+			{
+				remove_marker(s, get_tile_x(xs_[s]), get_tile_y(ys_[s]));
+			}
+		}
+		if (modes_[s] & watcher)
+		{
+			for_each_rect(make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]), [this, s](int tx, int ty) {
+				if (debug_)
+				{
+					std::cout << handles_[s] << " unwatch (" << tx << "," << ty << ")" << std::endl;
+				}
+				swap_remove(data_[ty * count_ + tx].watchers, s);
+				});
+		}
+		modes_[s] = 0;
+		free_.push_back(s);
+		index_.erase(iter);
+	}
+
+	void enable_debug(bool v)
+	{
+		debug_ = v;
+	}
+
+	void enbale_leave_event(bool v)
+	{
+		enable_leave_event_ = v;
+	}
+
+	bool has_object(object_handle_type handle)
+	{
+		return index_.find(handle) != index_.end();
+	}
+
+	void clear_event()
+	{
+		event_queue_.clear();
+	}
+
+	const std::vector<aoi_event>& get_event() const
+	{
+		return event_queue_;
+	}
+
+	//格子数
+	size_t tile_count() const
+	{
+		return data_.size();
+	}
+
+	template<typename Handler>
+	void for_each_all(const Handler& hander, int filter) const
+	{
+		for (int y = 0; y < count_; ++y)
+		{
+			for (int x = 0; x < count_; ++x)
+			{
+				const tile& node = data_[y * count_ + x];
+				for (slot_type m : node.markers)
+				{
+					if (modes_[m] & filter)
+					{
+						hander(handles_[m], xs_[m], ys_[m], x, y);
+					}
+				}
+				for (slot_type w : node.watchers)
+				{
+					if (modes_[w] & filter)
+					{
+						hander(handles_[w], xs_[w], ys_[w], x, y);
+					}
+				}
+			}
+		}
+	}
+private:
+	slot_type alloc_slot(object_handle_type handle, int x, int y, int w, int h, int layer, int mode)
+	{
+		if (!free_.empty())
+		{
+			slot_type s = free_.back();
+			free_.pop_back();
+			xs_[s] = x;
+			ys_[s] = y;
+			ws_[s] = w;
+			hs_[s] = h;
+			layers_[s] = layer;
+			modes_[s] = mode;
+			handles_[s] = handle;
+			return s;
+		}
+		xs_.push_back(x);
+		ys_.push_back(y);
+		ws_.push_back(w);
+		hs_.push_back(h);
+		layers_.push_back(layer);
+		modes_.push_back(mode);
+		handles_.push_back(handle);
+		return (slot_type)(handles_.size() - 1);
+	}
+
+	//移动涉及的格子都在同一区域时返回区域号,否则返回-1
+	int move_region(const moved_object& mo, int regions) const
+	{
+		slot_type s = mo.slot;
+		int low = std::min(get_tile_y(ys_[s]), get_tile_y(mo.y));
+		int high = std::max(get_tile_y(ys_[s]), get_tile_y(mo.y));
+		if (modes_[s] & watcher)
+		{
+			auto old_rc = make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+			auto new_rc = make_tile_rect(mo.x, mo.y, ws_[s], hs_[s]);
+			low = std::min({ low, old_rc.bottom(), new_rc.bottom() });
+			high = std::max({ high, old_rc.top(), new_rc.top() });
+		}
+		int region = low * regions / count_;
+		return region == high * regions / count_ ? region : -1;
+	}
+
+	//更新坐标和格子归属,不产生事件,记录受影响的观察者
+	void apply_move(const moved_object& mo, std::vector<slot_type>& dirty)
+	{
+		slot_type s = mo.slot;
+		int old_x = xs_[s], old_y = ys_[s];
+		int old_tile = get_tile_index(old_x, old_y);
+		int new_tile = get_tile_index(mo.x, mo.y);
+		moved_[s] = 1;
+		old_xs_[s] = old_x;
+		old_ys_[s] = old_y;
+		old_tiles_[s] = old_tile;
+		xs_[s] = mo.x;
+		ys_[s] = mo.y;
+		if (modes_[s] & marker)
+		{
+			tile& old_node = data_[old_tile];
+			tile& node = data_[new_tile];
+			if (old_tile != new_tile)
+			{
+				swap_remove(old_node.markers, s);
+				node.markers.push_back(s);
+				if (old_node.departed.empty())
+				{
+					std::lock_guard<std::mutex> lock(departed_mutex_);
+					departed_tiles_.push_back(old_tile);
+				}
+				old_node.departed.push_back(s);
+				dirty.insert(dirty.end(), old_node.watchers.begin(), old_node.watchers.end());
+			}
+			dirty.insert(dirty.end(), node.watchers.begin(), node.watchers.end());
+		}
+		if (modes_[s] & watcher)
+		{
+			auto old_rc = make_tile_rect(old_x, old_y, ws_[s], hs_[s]);
+			auto new_rc = make_tile_rect(mo.x, mo.y, ws_[s], hs_[s]);
+			for_each_rect(old_rc, [&](int tx, int ty) {
+				if (!new_rc.contains(tx, ty))
+				{
+					swap_remove(data_[ty * count_ + tx].watchers, s);
+				}
+				});
+			for_each_rect(new_rc, [&](int tx, int ty) {
+				if (!old_rc.contains(tx, ty))
+				{
+					data_[ty * count_ + tx].watchers.push_back(s);
+				}
+				});
+			dirty.push_back(s);
+		}
+	}
+
+	//对比观察者移动前后的可见集合
+	//stamps标记移动前可见的被观察者, 只对产生的事件按handle排序
+	void diff_watcher(slot_type w, diff_context& ctx, std::vector<aoi_event>& out)
+	{
+		ctx.stamp += 2;
+		uint32_t seen = ctx.stamp, kept = ctx.stamp + 1;
+		ctx.before.clear();
+		ctx.enters.clear();
+		int old_x = moved_[w] ? old_xs_[w] : xs_[w];
+		int old_y = moved_[w] ? old_ys_[w] : ys_[w];
+		auto old_rect = make_rect(old_x, old_y, ws_[w], hs_[w]);
+		for_each_rect(make_tile_rect(old_x, old_y, ws_[w], hs_[w]), [&](int tx, int ty) {
+			int index = ty * count_ + tx;
+			const tile& t = data_[index];
+			for (slot_type m : t.markers)
+			{
+				//本帧移入的在原格子的departed中处理
+				if (m == w || (moved_[m] && old_tiles_[m] != index)) continue;
+				if (old_rect.contains(moved_[m] ? old_xs_[m] : xs_[m], moved_[m] ? old_ys_[m] : ys_[m]))
+				{
+					ctx.stamps[m] = seen;
+					ctx.before.push_back(m);
+				}
+			}
+			for (slot_type m : t.departed)
+			{
+				if (m != w && old_rect.contains(old_xs_[m], old_ys_[m]))
+				{
+					ctx.stamps[m] = seen;
+					ctx.before.push_back(m);
+				}
+			}
+			});
+		auto new_rect = view_rect(w);
+		for_each_rect(make_tile_rect(xs_[w], ys_[w], ws_[w], hs_[w]), [&](int tx, int ty) {
+			for (slot_type m : data_[ty * count_ + tx].markers)
+			{
+				if (m == w || !new_rect.contains(xs_[m], ys_[m])) continue;
+				if (ctx.stamps[m] == seen)
+					ctx.stamps[m] = kept;
+				else
+					ctx.enters.push_back(handles_[m]);
+			}
+			});
+		if (enable_leave_event_)
+		{
+			ctx.leaves.clear();
+			for (slot_type m : ctx.before)
+			{
+				if (ctx.stamps[m] == seen)
+				{
+					ctx.leaves.push_back(handles_[m]);
+				}
+			}
+			std::sort(ctx.leaves.begin(), ctx.leaves.end());
+			for (auto m : ctx.leaves)
+			{
+				out.emplace_back(static_cast<int>(event_leave), handles_[w], m);
+			}
+		}
+		std::sort(ctx.enters.begin(), ctx.enters.end());
+		for (auto m : ctx.enters)
+		{
+			out.emplace_back(static_cast<int>(event_enter), handles_[w], m);
+		}
+	}
+
+	//与末尾元素交换后删除,不保持顺序
+	static bool swap_remove(std::vector<slot_type>& vec, slot_type s)
+	{
+		auto it = std::find(vec.begin(), vec.end(), s);
+		if (it == vec.end())
+		{
+			return false;
+		}
+		*it = vec.back();
+		vec.pop_back();
+		return true;
+	}
+
+	rect<int> view_rect(slot_type s) const
+	{
+		return make_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+	}
+
+	void insert_marker(slot_type s, int tile_x, int tile_y)
+	{
+		tile& node = data_[tile_y * count_ + tile_x];
+		node.markers.push_back(s);
+		for (slot_type w : node.watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_enter), handles_[w], handles_[s]);
+		}
+	}
+
+	void remove_marker(slot_type s, int tile_x, int tile_y)
+	{
+		tile& node = data_[tile_y * count_ + tile_x];
+		swap_remove(node.markers, s);
+		for (slot_type w : node.watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_leave), handles_[w], handles_[s]);
+		}
+	}
+
+	void update_marker(slot_type s, int old_x, int old_y)
+	{
+		int old_tile_x = get_tile_x(old_x);
+		int old_tile_y = get_tile_y(old_y);
+		int new_tile_x = get_tile_x(xs_[s]);
+		int new_tile_y = get_tile_y(ys_[s]);
+
+		tile& old_node = data_[old_tile_y * count_ + old_tile_x];
+		tile& node = data_[new_tile_y * count_ + new_tile_x];
+		if (&old_node != &node)
+		{
+			swap_remove(old_node.markers, s);
+			node.markers.push_back(s);
+			if (debug_)
+			{
+				std::cout << handles_[s] << " insert (" << new_tile_x << "," << new_tile_y << ")" << std::endl;
+			}
+		}
+		if (enable_leave_event_)
+		{
+			for (slot_type w : old_node.watchers)
+			{
+				if (handles_[w] == handles_[s]) continue;
+				auto rc = view_rect(w);
+				if (!rc.contains(old_x, old_y) || rc.contains(xs_[s], ys_[s]))
+				{
+					continue;
+				}
+				event_queue_.emplace_back(static_cast<int>(event_leave), handles_[w], handles_[s]);
+			}
+		}
+		for (slot_type w : node.watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			auto rc = view_rect(w);
+			if (!rc.contains(xs_[s], ys_[s]) || rc.contains(old_x, old_y))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_enter), handles_[w], handles_[s]);
+		}
+	}
+
+	void marker_event(tile& node, slot_type s, int eventid)
+	{
+		assert(std::find(node.markers.begin(), node.markers.end(), s) != node.markers.end());
+		for (slot_type w : node.watchers)
+		{
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(eventid), handles_[w], handles_[s]);
+		}
+	}
+
+	void insert_watcher(tile& node, slot_type s)
+	{
+		assert(std::find(node.watchers.begin(), node.watchers.end(), s) == node.watchers.end());
+		node.watchers.push_back(s);
+	}
+
+	void remove_watcher(tile& node, slot_type s)
+	{
+		[[maybe_unused]] bool ok = swap_remove(node.watchers, s);
+		assert(ok);
+	}
+
+	void update_watcher(const tile& t,
+		const rect<int>& old_rect,
+		const rect<int>& new_rect,
+		slot_type s,
+		bool check_enter = true,
+		bool check_leave = true)
+	{
+		for (slot_type m : t.markers)
+		{
+			if (handles_[s] == handles_[m]) continue;
+			bool in_old_view = old_rect.contains(xs_[m], ys_[m]);
+			bool in_new_view = new_rect.contains(xs_[m], ys_[m]);
+			if (in_old_view)
+			{
+				if (enable_leave_event_ && !in_new_view && check_leave)
+				{
+					event_queue_.emplace_back(static_cast<int>(event_leave), handles_[s], handles_[m]);
+				}
+			}
+			else if (in_new_view && check_enter)
+			{
+				event_queue_.emplace_back(static_cast<int>(event_enter), handles_[s], handles_[m]);
+			}
+		}
+	}
+
+	template<typename Handler>
+	void for_each_rect(const rect<int> rc, const Handler& hander)
+	{
+		for (int i = rc.left(); i <= rc.right(); ++i)
+		{
+			for (int j = rc.bottom(); j <= rc.top(); ++j)
+			{
+				hander(i, j);
+			}
+		}
+	}
+private:
+	bool debug_ = false;
+	bool enable_leave_event_ = false;
+	const rect<int> rect_;
+	const int tile_size_;
+	const int map_size_;
+	const int count_;//map_size_ / tile_size_
+	std::vector<tile> data_;//count * count
+	//对象槽位(SoA)
+	std::vector<int32_t> xs_;
+	std::vector<int32_t> ys_;
+	std::vector<int32_t> ws_;
+	std::vector<int32_t> hs_;
+	std::vector<int32_t> layers_;
+	std::vector<int32_t> modes_;
+	std::vector<object_handle_type> handles_;
+	std::vector<slot_type> free_;//空闲槽位
+	std::unordered_map<object_handle_type, slot_type> index_;//handle到槽位
+	std::vector<aoi_event> event_queue_;
+	//并行更新的临时数据
+	std::vector<uint8_t> moved_;
+	std::vector<int32_t> old_xs_;
+	std::vector<int32_t> old_ys_;
+	std::vector<int32_t> old_tiles_;
+	std::vector<int> departed_tiles_;
+	std::mutex departed_mutex_;
+};
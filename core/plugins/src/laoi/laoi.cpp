@@ -2,7 +2,11 @@
 #include <cstring>
 #include <cstdint>
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include "aoi.hpp"
+#include "dense_aoi.hpp"
+#include "sparse_aoi.hpp"
 
 extern "C" {
 #include "lua.h"
@@ -50,7 +54,12 @@ struct aoi_object
 struct aoi_space_box
 {
 	using aoi_type = aoi<aoi_object>;
+	using dense_type = dense_aoi<aoi_object>;
+	using sparse_type = sparse_aoi<aoi_object>;
 	aoi_type* space;
+	dense_type* dense;
+	sparse_type* sparse;
+	aoi_pool* pool;
 };
 
 static int lrelease(lua_State* L)
@@ -61,156 +70,286 @@ static int lrelease(lua_State* L)
 		delete ab->space;
 		ab->space = NULL;
 	}
+	if (ab && ab->dense)
+	{
+		delete ab->dense;
+		ab->dense = NULL;
+	}
+	if (ab && ab->sparse)
+	{
+		delete ab->sparse;
+		ab->sparse = NULL;
+	}
+	if (ab && ab->pool)
+	{
+		delete ab->pool;
+		ab->pool = NULL;
+	}
 	return 0;
 }
 
-static int laoi_insert(lua_State* L)
+//按创建时选择的存储方式分派
+template<typename Handler>
+static int aoi_call(lua_State* L, const Handler& handler)
 {
 	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
+	if (ab == NULL || (ab->space == NULL && ab->dense == NULL && ab->sparse == NULL))
 		return luaL_error(L, "Invalid aoi_space pointer");
-	auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
-	int32_t x = (int32_t)luaL_checknumber(L, 3);
-	int32_t y = (int32_t)luaL_checknumber(L, 4);
-	int32_t view_w = (int32_t)luaL_checkinteger(L, 5);
-	int32_t view_h = (int32_t)luaL_checkinteger(L, 6);
-	int32_t layer = (int32_t)luaL_checkinteger(L, 7);
-	int32_t mode = (int32_t)luaL_checkinteger(L, 8);
-	ab->space->clear_event();
-	bool res = ab->space->insert(id, x, y, view_w, view_h, layer, mode);
-	lua_pushboolean(L, res);
-	return 1;
+	if (ab->dense)
+		return handler(*ab->dense);
+	if (ab->sparse)
+		return handler(*ab->sparse);
+	return handler(*ab->space);
+}
+
+static int laoi_insert(lua_State* L)
+{
+	return aoi_call(L, [L](auto& space) {
+		auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
+		int32_t x = (int32_t)luaL_checknumber(L, 3);
+		int32_t y = (int32_t)luaL_checknumber(L, 4);
+		int32_t view_w = (int32_t)luaL_checkinteger(L, 5);
+		int32_t view_h = (int32_t)luaL_checkinteger(L, 6);
+		int32_t layer = (int32_t)luaL_checkinteger(L, 7);
+		int32_t mode = (int32_t)luaL_checkinteger(L, 8);
+		space.clear_event();
+		bool res = space.insert(id, x, y, view_w, view_h, layer, mode);
+		lua_pushboolean(L, res);
+		return 1;
+	});
 }
 
 static int laoi_update(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
-	int32_t x = (int32_t)luaL_checknumber(L, 3);
-	int32_t y = (int32_t)luaL_checknumber(L, 4);
-	int32_t view_w = (int32_t)luaL_checkinteger(L, 5);
-	int32_t view_h = (int32_t)luaL_checkinteger(L, 6);
-	int32_t layer = (int32_t)luaL_checkinteger(L, 7);
-	ab->space->clear_event();
-	auto res = ab->space->update(id, x, y, view_w, view_h, layer);
-	lua_pushboolean(L, res);
-	return 1;
+	return aoi_call(L, [L](auto& space) {
+		auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
+		int32_t x = (int32_t)luaL_checknumber(L, 3);
+		int32_t y = (int32_t)luaL_checknumber(L, 4);
+		int32_t view_w = (int32_t)luaL_checkinteger(L, 5);
+		int32_t view_h = (int32_t)luaL_checkinteger(L, 6);
+		int32_t layer = (int32_t)luaL_checkinteger(L, 7);
+		space.clear_event();
+		auto res = space.update(id, x, y, view_w, view_h, layer);
+		lua_pushboolean(L, res);
+		return 1;
+	});
 }
 
-static int laoi_query(lua_State* L)
+struct aoi_move
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	int32_t x = (int32_t)luaL_checknumber(L, 2);
-	int32_t y = (int32_t)luaL_checknumber(L, 3);
-	int32_t view_w = (int32_t)luaL_checkinteger(L, 4);
-	int32_t view_h = (int32_t)luaL_checkinteger(L, 5);
-	luaL_checktype(L, 6, LUA_TTABLE);
-
-	std::vector<aoi_object::handle_type> vec;
-	ab->space->query(x, y, view_w, view_h, vec);
-	if (vec.empty())
+	aoi_object::handle_type handle;
+	int32_t x;
+	int32_t y;
+	int64_t tile;
+};
+
+struct aoi_pair_hash
+{
+	size_t operator()(const std::pair<int64_t, int64_t>& p) const
 	{
-		return 0;
+		return std::hash<int64_t>()(p.first) ^ (std::hash<int64_t>()(p.second) * 0x9e3779b97f4a7c15ull);
 	}
+};
+
+//同一帧内同一对(watcher, marker)的进出相互抵消,只输出净变化
+//返回enters,leaves两个字符串,每个事件为两个小端int64: watcher, marker
+template<typename Events>
+static int push_batch_events(lua_State* L, const Events& events)
+{
+	std::unordered_map<std::pair<int64_t, int64_t>, size_t, aoi_pair_hash> index;
+	std::vector<std::pair<std::pair<int64_t, int64_t>, int>> nets;
+	for (const auto& evt : events)
+	{
+		auto key = std::make_pair((int64_t)evt.watcher, (int64_t)evt.marker);
+		auto res = index.try_emplace(key, nets.size());
+		if (res.second)
+		{
+			nets.emplace_back(key, 0);
+		}
+		nets[res.first->second].second += (evt.eventid == aoi_space_box::aoi_type::event_enter) ? 1 : -1;
+	}
+	std::string enters, leaves;
+	for (const auto& [key, net] : nets)
+	{
+		if (net == 0) continue;
+		std::string& out = net > 0 ? enters : leaves;
+		out.append((const char*)&key.first, sizeof(int64_t));
+		out.append((const char*)&key.second, sizeof(int64_t));
+	}
+	lua_pushlstring(L, enters.data(), enters.size());
+	lua_pushlstring(L, leaves.data(), leaves.size());
+	return 2;
+}
 
-	int idx = 1;
-	for (const auto& id : vec)
+//读取批量坐标: moves为{handle, x, y, handle, x, y, ...}
+//同一对象只保留最后一次坐标
+template<typename Space>
+static std::vector<aoi_move> read_moves(lua_State* L, Space& space)
+{
+	luaL_checktype(L, 2, LUA_TTABLE);
+	size_t len = lua_rawlen(L, 2);
+	std::vector<aoi_move> moves;
+	std::unordered_map<aoi_object::handle_type, size_t> index;
+	moves.reserve(len / 3);
+	for (size_t i = 1; i + 2 <= len; i += 3)
 	{
-		lua_pushinteger(L, id);
-		lua_rawseti(L, 6, idx);
-		++idx;
+		lua_rawgeti(L, 2, i);
+		lua_rawgeti(L, 2, i + 1);
+		lua_rawgeti(L, 2, i + 2);
+		aoi_move move{ (aoi_object::handle_type)lua_tointeger(L, -3), (int32_t)lua_tonumber(L, -2), (int32_t)lua_tonumber(L, -1), 0 };
+		lua_pop(L, 3);
+		move.tile = space.get_tile_index(move.x, move.y);
+		auto res = index.try_emplace(move.handle, moves.size());
+		if (res.second)
+			moves.push_back(move);
+		else
+			moves[res.first->second] = move;
 	}
+	return moves;
+}
 
-	lua_pushinteger(L, static_cast<int64_t>(vec.size()));
-	return 1;
+//批量更新坐标,按目标格子排序后依次更新
+static int laoi_update_batch(lua_State* L)
+{
+	return aoi_call(L, [L](auto& space) {
+		auto moves = read_moves(L, space);
+		std::sort(moves.begin(), moves.end(), [](const aoi_move& a, const aoi_move& b) {
+			return a.tile < b.tile;
+		});
+		space.clear_event();
+		for (const auto& move : moves)
+		{
+			space.update_pos(move.handle, move.x, move.y);
+		}
+		return push_batch_events(L, space.get_event());
+	});
 }
 
-static int laoi_erase(lua_State* L)
+//多线程批量更新坐标,参数和返回同update_batch
+//需要创建时指定dense和threads,否则退化为update_batch
+static int laoi_update_parallel(lua_State* L)
 {
 	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
-	ab->space->clear_event();
-	ab->space->erase(id);
-	return 0;
+	if (ab == NULL || ab->dense == NULL || ab->pool == NULL)
+		return laoi_update_batch(L);
+	auto moves = read_moves(L, *ab->dense);
+	ab->dense->update_parallel(moves, *ab->pool);
+	return push_batch_events(L, ab->dense->get_event());
+}
+
+static int laoi_query(lua_State* L)
+{
+	return aoi_call(L, [L](auto& space) {
+		int32_t x = (int32_t)luaL_checknumber(L, 2);
+		int32_t y = (int32_t)luaL_checknumber(L, 3);
+		int32_t view_w = (int32_t)luaL_checkinteger(L, 4);
+		int32_t view_h = (int32_t)luaL_checkinteger(L, 5);
+		luaL_checktype(L, 6, LUA_TTABLE);
+
+		std::vector<aoi_object::handle_type> vec;
+		space.query(x, y, view_w, view_h, vec);
+		if (vec.empty())
+		{
+			return 0;
+		}
+
+		int idx = 1;
+		for (const auto& id : vec)
+		{
+			lua_pushinteger(L, id);
+			lua_rawseti(L, 6, idx);
+			++idx;
+		}
+
+		lua_pushinteger(L, static_cast<int64_t>(vec.size()));
+		return 1;
+	});
+}
+
+static int laoi_erase(lua_State* L)
+{
+	return aoi_call(L, [L](auto& space) {
+		auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
+		space.clear_event();
+		space.erase(id);
+		return 0;
+	});
 }
 
 static int laoi_hasobject(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
-	int res = ab->space->has_object(id) ? 1 : 0;
-	lua_pushboolean(L, res);
-	return 1;
+	return aoi_call(L, [L](auto& space) {
+		auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
+		int res = space.has_object(id) ? 1 : 0;
+		lua_pushboolean(L, res);
+		return 1;
+	});
 }
 
 static int laoi_fire_event(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
-	int32_t nevent = (int32_t)luaL_checkinteger(L, 3);
-	ab->space->clear_event();
-	ab->space->fire_event(id, nevent);
-	return 0;
+	return aoi_call(L, [L](auto& space) {
+		auto id = (aoi_object::handle_type)luaL_checkinteger(L, 2);
+		int32_t nevent = (int32_t)luaL_checkinteger(L, 3);
+		space.clear_event();
+		space.fire_event(id, nevent);
+		return 0;
+	});
 }
 
 static int laoi_update_event(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
+	return aoi_call(L, [L](auto& space) {
 
-	luaL_checktype(L, 2, LUA_TTABLE);
+		luaL_checktype(L, 2, LUA_TTABLE);
 
-	const auto& events = ab->space->get_event();
-	if (events.empty())
-	{
-		lua_pushinteger(L, 0);
-		return 1;
-	}
+		const auto& events = space.get_event();
+		if (events.empty())
+		{
+			lua_pushinteger(L, 0);
+			return 1;
+		}
 
-	int idx = 1;
-	for (const auto& evt : events)
-	{
-		lua_pushinteger(L, evt.watcher);
-		lua_rawseti(L, 2, idx++);
-		lua_pushinteger(L, evt.marker);
-		lua_rawseti(L, 2, idx++);
-		lua_pushinteger(L, evt.eventid);
-		lua_rawseti(L, 2, idx++);
-	}
+		int idx = 1;
+		for (const auto& evt : events)
+		{
+			lua_pushinteger(L, evt.watcher);
+			lua_rawseti(L, 2, idx++);
+			lua_pushinteger(L, evt.marker);
+			lua_rawseti(L, 2, idx++);
+			lua_pushinteger(L, evt.eventid);
+			lua_rawseti(L, 2, idx++);
+		}
 
-	lua_pushinteger(L, static_cast<int64_t>(events.size() * 3));
-	return 1;
+		lua_pushinteger(L, static_cast<int64_t>(events.size() * 3));
+		return 1;
+	});
+}
+
+static int laoi_tile_count(lua_State* L)
+{
+	return aoi_call(L, [L](auto& space) {
+		lua_pushinteger(L, (lua_Integer)space.tile_count());
+		return 1;
+	});
 }
 
 static int laoi_enable_debug(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	bool v = (bool)lua_toboolean(L, 2);
-	ab->space->enable_debug(v);
-	return 0;
+	return aoi_call(L, [L](auto& space) {
+		bool v = (bool)lua_toboolean(L, 2);
+		space.enable_debug(v);
+		return 0;
+	});
 }
 
 static int laoi_enable_leave_event(lua_State* L)
 {
-	aoi_space_box* ab = (aoi_space_box*)lua_touserdata(L, 1);
-	if (ab == NULL || ab->space == NULL)
-		return luaL_error(L, "Invalid aoi_space pointer");
-	bool v = (bool)lua_toboolean(L, 2);
-	ab->space->enbale_leave_event(v);
-	return 0;
+	return aoi_call(L, [L](auto& space) {
+		bool v = (bool)lua_toboolean(L, 2);
+		space.enbale_leave_event(v);
+		return 0;
+	});
 }
 
 static int laoi_create(lua_State* L)
@@ -219,24 +358,49 @@ static int laoi_create(lua_State* L)
 	int y = (int)luaL_checkinteger(L, 2);
 	int map_size = (int)luaL_checkinteger(L, 3);
 	int tile_size = (int)luaL_checkinteger(L, 4);
-	if (map_size % tile_size != 0)
+	//存储方式: true或"dense"为稠密网格, "sparse"为稀疏网格, 其他为默认网格
+	bool dense = false, sparse = false;
+	if (lua_type(L, 5) == LUA_TSTRING)
+	{
+		dense = strcmp(lua_tostring(L, 5), "dense") == 0;
+		sparse = strcmp(lua_tostring(L, 5), "sparse") == 0;
+	}
+	else
+	{
+		dense = lua_toboolean(L, 5);
+	}
+	int threads = (int)luaL_optinteger(L, 6, 0);
+	if (!sparse && map_size % tile_size != 0)
 	{
 		return luaL_error(L, "Need length_of_area %% length_of_node == 0.");
 	}
 
-	auto* q = new aoi_space_box::aoi_type(x, y, map_size, tile_size);
 	aoi_space_box* ab = (aoi_space_box*)lua_newuserdata(L, sizeof(*ab));
-	ab->space = q;
+	ab->space = NULL;
+	ab->dense = NULL;
+	ab->sparse = NULL;
+	ab->pool = NULL;
+	if (dense)
+		ab->dense = new aoi_space_box::dense_type(x, y, map_size, tile_size);
+	else if (sparse)
+		ab->sparse = new aoi_space_box::sparse_type(x, y, map_size, tile_size);
+	else
+		ab->space = new aoi_space_box::aoi_type(x, y, map_size, tile_size);
+	if (dense && threads > 1)
+		ab->pool = new aoi_pool(threads);
 	if (luaL_newmetatable(L, METANAME))//mt
 	{
 		luaL_Reg l[] = {
 			{ "insert",laoi_insert },
 			{ "update",laoi_update },
+			{ "update_batch",laoi_update_batch },
+			{ "update_parallel",laoi_update_parallel },
 			{ "query", laoi_query},
 			{ "fire_event",laoi_fire_event },
 			{ "erase",laoi_erase },
 			{ "has",laoi_hasobject },
 			{ "update_event", laoi_update_event},
+			{ "tile_count", laoi_tile_count},
 			{ "enable_debug", laoi_enable_debug},
 			{ "enable_leave_event", laoi_enable_leave_event},
 			{ NULL,NULL }
@@ -0,0 +1,624 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+#include "math.hpp"
+
+//aoi的稀疏存储版本,接口和事件与aoi一致,适合大而空旷的地图
+//格子按需创建并以格子索引哈希存放,没有被观察者和观察者时立即回收,内存只和有对象覆盖的格子数相关
+//对象存放方式同dense_aoi,地图尺寸不要求是格子尺寸的整数倍
+template<class AoiObject>
+class sparse_aoi
+{
+public:
+	enum mode
+	{
+		watcher = 1,        //观察者(玩家)
+		marker = 1 << 1    //被观察者(被看的东西,玩家)
+	};
+	enum event_type
+	{
+		event_enter = 1,
+		event_leave = 2,
+	};
+
+	using object_type = AoiObject;//对象类型
+	using object_handle_type = typename object_type::handle_type;//对象的索引类型
+	using slot_type = uint32_t;//对象槽位
+	using tile_key = int64_t;//格子索引
+
+	struct aoi_event
+	{
+		int eventid = 0; //enum event_type
+		object_handle_type watcher = object_handle_type{};
+		object_handle_type marker = object_handle_type{};
+
+		aoi_event(int eid, object_handle_type w, object_handle_type m)
+			:eventid(eid)
+			, watcher(w)
+			, marker(m)
+		{
+		}
+	};
+private:
+	struct tile
+	{
+		std::vector<slot_type> markers;    //被观察者槽位
+		std::vector<slot_type> watchers;   //观察者槽位
+	};
+public:
+	//x,y为地图偏移,为了对齐前端坐标,一般0,0即可
+	sparse_aoi(int posx, int posy, int map_size, int tile_size)
+		:rect_(posx, posy, map_size, map_size)
+		, tile_size_(tile_size)
+		, map_size_(map_size)
+		, count_((map_size + tile_size - 1) / tile_size)
+	{
+	}
+
+	//格子坐标x
+	constexpr int get_tile_x(int v) const
+	{
+		auto res = (v - rect_.x) / tile_size_;
+		if (res >= count_)
+		{
+			res = count_ - 1;
+		}
+		return res;
+	}
+	//格子坐标y
+	constexpr int get_tile_y(int v) const
+	{
+		auto res = (v - rect_.y) / tile_size_;
+		if (res >= count_)
+		{
+			res = count_ - 1;
+		}
+		return res;
+	}
+	//格子索引
+	tile_key get_tile_index(int x, int y) const
+	{
+		return make_key(get_tile_x(x), get_tile_y(y));
+	}
+	//构建视野矩形
+	rect<int> make_rect(int x, int y, int w, int h) const
+	{
+		auto left = (std::clamp(x - w / 2, rect_.left(), rect_.right()));
+		auto right = (std::clamp(x + w / 2, rect_.left(), rect_.right()));
+		auto bottom = (std::clamp(y - h / 2, rect_.bottom(), rect_.top()));
+		auto top = (std::clamp(y + h / 2, rect_.bottom(), rect_.top()));
+		return rect<int>{ left, bottom, right - left, top - bottom };
+	}
+	//构建格子坐标矩形
+	rect<int> make_tile_rect(int x, int y, int w, int h) const
+	{
+		auto left = get_tile_x(std::clamp(x - w / 2, rect_.left(), rect_.right()));
+		auto right = get_tile_x(std::clamp(x + w / 2, rect_.left(), rect_.right()));
+		auto bottom = get_tile_y(std::clamp(y - h / 2, rect_.bottom(), rect_.top()));
+		auto top = get_tile_y(std::clamp(y + h / 2, rect_.bottom(), rect_.top()));
+		return rect<int>{ left, bottom, right - left, top - bottom };
+	}
+	//插入管理对象, 参数同aoi::insert
+	bool insert(object_handle_type handle, int x, int y, int w, int h, int layer, int mode, bool range_marker = false)
+	{
+		if (!rect_.contains(x, y))
+		{
+			return false;
+		}
+		auto res = index_.try_emplace(handle, 0);
+		if (!res.second)
+		{
+			return false;
+		}
+		slot_type s = alloc_slot(handle, x, y, w, h, layer, mode);
+		res.first->second = s;
+		//被观察者
+		if (mode & marker) {
+			if (range_marker && w > 0 && h > 0) {//范围建筑
+				assert(!(mode & watcher) && "unsupport");
+				for_each_rect(make_tile_rect(x, y, w, h), [this, s](int tx, int ty) {
+					insert_marker(s, tx, ty);
+					});
+			}
+			else {
+				insert_marker(s, get_tile_x(x), get_tile_y(y));
+			}
+		}
+		//观察者
+		if (mode & watcher) {
+			auto rc = make_rect(x, y, w, h);
+			for_each_rect(make_tile_rect(x, y, w, h), [this, s, &rc](int tx, int ty) {
+				tile& t = data_[make_key(tx, ty)];
+				insert_watcher(t, s);
+				if (debug_) {
+					std::cout << handles_[s] << " watch (" << tx << "," << ty << ")" << std::endl;
+				}
+				update_watcher(t, rect<int>{-1, -1, 0, 0}, rc, s);
+				});
+		}
+		return true;
+	}
+	//对象事件
+	void fire_event(object_handle_type handle, int eventid)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end()) {
+			return;
+		}
+		slot_type s = iter->second;
+		tile* t = find_tile(get_tile_x(xs_[s]), get_tile_y(ys_[s]));
+		if (t)
+		{
+			marker_event(*t, s, eventid);
+		}
+	}
+
+	// update pos, view width, view height, layer
+	bool update(object_handle_type handle, int x, int y, int w, int h, int layer)
+	{
+		if (!rect_.contains(x, y) || w < 0 || h < 0)
+		{
+			return false;
+		}
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return false;
+		}
+		slot_type s = iter->second;
+		auto old_rect = make_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+		auto old_tile_rect = make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+
+		auto old_x = xs_[s];
+		auto old_y = ys_[s];
+		xs_[s] = x;
+		ys_[s] = y;
+		hs_[s] = h;
+		ws_[s] = w;
+		layers_[s] = layer;
+
+		if (modes_[s] & marker)
+		{
+			update_marker(s, old_x, old_y);
+		}
+		if (!(modes_[s] & watcher))
+		{
+			return true;
+		}
+		auto new_rect = make_rect(x, y, w, h);
+		auto new_tile_rect = make_tile_rect(x, y, w, h);
+		//视野缩小: 只需处理旧格子
+		bool shrink = old_rect.contains(new_rect);
+		for_each_rect(old_tile_rect, [&](int tx, int ty) {
+			auto rc = rect<int>{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+			if (new_rect.contains(rc))
+			{
+				return;
+			}
+			tile* t = find_tile(tx, ty);
+			if (!t)
+			{
+				return;
+			}
+			if (!new_tile_rect.contains(tx, ty))
+			{
+				remove_watcher(*t, s);
+				if (debug_)
+				{
+					std::cout << handles_[s] << " unwatch (" << tx << "," << ty << ")" << std::endl;
+				}
+			}
+			if (shrink)
+				update_watcher(*t, old_rect, new_rect, s);
+			else
+				update_watcher(*t, old_rect, new_rect, s, false, true);
+			release_tile(tx, ty);
+			});
+		if (shrink)
+		{
+			return true;
+		}
+		for_each_rect(new_tile_rect, [&](int tx, int ty) {
+			auto rc = rect<int>{ tx * tile_size_, ty * tile_size_, tile_size_, tile_size_ };
+			if (old_rect.contains(rc))
+			{
+				return;
+			}
+			tile& t = data_[make_key(tx, ty)];
+			if (!old_tile_rect.contains(tx, ty))
+			{
+				insert_watcher(t, s);
+				if (debug_)
+				{
+					std::cout << handles_[s] << " watch (" << tx << "," << ty << ")" << std::endl;
+				}
+			}
+			update_watcher(t, old_rect, new_rect, s, true, false);
+			});
+		return true;
+	}
+
+	//只更新坐标,视野和层级不变
+	bool update_pos(object_handle_type handle, int x, int y)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return false;
+		}
+		slot_type s = iter->second;
+		return update(handle, x, y, ws_[s], hs_[s], layers_[s]);
+	}
+
+	void query(int x, int y, int w, int h, std::vector<int64_t>& out)
+	{
+		auto rc = make_rect(x, y, w, h);
+		auto tile_rc = make_tile_rect(x, y, w, h);
+		auto query_tile = [&](int i, int j, const tile& node) {
+			//边缘格子需要逐个判断坐标
+			bool is_edge = (i == tile_rc.x) || (i == tile_rc.right()) || (j == tile_rc.y) || (j == tile_rc.top());
+			for (slot_type m : node.markers)
+			{
+				if (!is_edge || rc.contains(xs_[m], ys_[m]))
+				{
+					out.push_back(handles_[m]);
+				}
+			}
+		};
+		//范围内格子比已有格子多时直接遍历已有格子
+		if ((size_t)(tile_rc.width + 1) * (size_t)(tile_rc.height + 1) > data_.size())
+		{
+			for (const auto& [key, node] : data_)
+			{
+				int i = (int)(key % count_), j = (int)(key / count_);
+				if (tile_rc.contains(i, j))
+				{
+					query_tile(i, j, node);
+				}
+			}
+			return;
+		}
+		for_each_rect(tile_rc, [&](int i, int j) {
+			if (const tile* node = find_tile(i, j))
+			{
+				query_tile(i, j, *node);
+			}
+			});
+	}
+
+	void clear()
+	{
+		data_.clear();
+		index_.clear();
+		free_.clear();
+		xs_.clear();
+		ys_.clear();
+		ws_.clear();
+		hs_.clear();
+		layers_.clear();
+		modes_.clear();
+		handles_.clear();
+	}
+
+	void erase(object_handle_type handle)
+	{
+		auto iter = index_.find(handle);
+		if (iter == index_.end())
+		{
+			return;
+		}
+		slot_type s = iter->second;
+		if (modes_[s] & marker)
+		{
+			if (ws_[s] > 0 && hs_[s] > 0)
+			{
+				for_each_rect(make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]), [this, s](int tx, int ty) {
+					remove_marker(s, tx, ty);
+					});
+			}
+			else
+			{
+				remove_marker(s, get_tile_x(xs_[s]), get_tile_y(ys_[s]));
+			}
+		}
+		if (modes_[s] & watcher)
+		{
+			for_each_rect(make_tile_rect(xs_[s], ys_[s], ws_[s], hs_[s]), [this, s](int tx, int ty) {
+				if (debug_)
+				{
+					std::cout << handles_[s] << " unwatch (" << tx << "," << ty << ")" << std::endl;
+				}
+				if (tile* t = find_tile(tx, ty))
+				{
+					swap_remove(t->watchers, s);
+					release_tile(tx, ty);
+				}
+				});
+		}
+		modes_[s] = 0;
+		free_.push_back(s);
+		index_.erase(iter);
+	}
+
+	void enable_debug(bool v)
+	{
+		debug_ = v;
+	}
+
+	void enbale_leave_event(bool v)
+	{
+		enable_leave_event_ = v;
+	}
+
+	bool has_object(object_handle_type handle)
+	{
+		return index_.find(handle) != index_.end();
+	}
+
+	void clear_event()
+	{
+		event_queue_.clear();
+	}
+
+	const std::vector<aoi_event>& get_event() const
+	{
+		return event_queue_;
+	}
+
+	//已创建的格子数
+	size_t tile_count() const
+	{
+		return data_.size();
+	}
+
+	template<typename Handler>
+	void for_each_all(const Handler& hander, int filter) const
+	{
+		for (const auto& [key, node] : data_)
+		{
+			int x = (int)(key % count_), y = (int)(key / count_);
+			for (slot_type m : node.markers)
+			{
+				if (modes_[m] & filter)
+				{
+					hander(handles_[m], xs_[m], ys_[m], x, y);
+				}
+			}
+			for (slot_type w : node.watchers)
+			{
+				if (modes_[w] & filter)
+				{
+					hander(handles_[w], xs_[w], ys_[w], x, y);
+				}
+			}
+		}
+	}
+private:
+	tile_key make_key(int tile_x, int tile_y) const
+	{
+		return (tile_key)tile_y * count_ + tile_x;
+	}
+
+	tile* find_tile(int tile_x, int tile_y)
+	{
+		auto it = data_.find(make_key(tile_x, tile_y));
+		return it == data_.end() ? nullptr : &it->second;
+	}
+
+	//格子空了就回收
+	void release_tile(int tile_x, int tile_y)
+	{
+		auto it = data_.find(make_key(tile_x, tile_y));
+		if (it != data_.end() && it->second.markers.empty() && it->second.watchers.empty())
+		{
+			data_.erase(it);
+		}
+	}
+
+	slot_type alloc_slot(object_handle_type handle, int x, int y, int w, int h, int layer, int mode)
+	{
+		if (!free_.empty())
+		{
+			slot_type s = free_.back();
+			free_.pop_back();
+			xs_[s] = x;
+			ys_[s] = y;
+			ws_[s] = w;
+			hs_[s] = h;
+			layers_[s] = layer;
+			modes_[s] = mode;
+			handles_[s] = handle;
+			return s;
+		}
+		xs_.push_back(x);
+		ys_.push_back(y);
+		ws_.push_back(w);
+		hs_.push_back(h);
+		layers_.push_back(layer);
+		modes_.push_back(mode);
+		handles_.push_back(handle);
+		return (slot_type)(handles_.size() - 1);
+	}
+
+	//与末尾元素交换后删除,不保持顺序
+	static bool swap_remove(std::vector<slot_type>& vec, slot_type s)
+	{
+		auto it = std::find(vec.begin(), vec.end(), s);
+		if (it == vec.end())
+		{
+			return false;
+		}
+		*it = vec.back();
+		vec.pop_back();
+		return true;
+	}
+
+	rect<int> view_rect(slot_type s) const
+	{
+		return make_rect(xs_[s], ys_[s], ws_[s], hs_[s]);
+	}
+
+	void insert_marker(slot_type s, int tile_x, int tile_y)
+	{
+		tile& node = data_[make_key(tile_x, tile_y)];
+		node.markers.push_back(s);
+		for (slot_type w : node.watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_enter), handles_[w], handles_[s]);
+		}
+	}
+
+	void remove_marker(slot_type s, int tile_x, int tile_y)
+	{
+		tile* node = find_tile(tile_x, tile_y);
+		if (!node)
+		{
+			return;
+		}
+		swap_remove(node->markers, s);
+		for (slot_type w : node->watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_leave), handles_[w], handles_[s]);
+		}
+		release_tile(tile_x, tile_y);
+	}
+
+	void update_marker(slot_type s, int old_x, int old_y)
+	{
+		int old_tile_x = get_tile_x(old_x);
+		int old_tile_y = get_tile_y(old_y);
+		int new_tile_x = get_tile_x(xs_[s]);
+		int new_tile_y = get_tile_y(ys_[s]);
+
+		tile& old_node = data_[make_key(old_tile_x, old_tile_y)];
+		tile& node = data_[make_key(new_tile_x, new_tile_y)];
+		if (&old_node != &node)
+		{
+			swap_remove(old_node.markers, s);
+			node.markers.push_back(s);
+			if (debug_)
+			{
+				std::cout << handles_[s] << " insert (" << new_tile_x << "," << new_tile_y << ")" << std::endl;
+			}
+		}
+		if (enable_leave_event_)
+		{
+			for (slot_type w : old_node.watchers)
+			{
+				if (handles_[w] == handles_[s]) continue;
+				auto rc = view_rect(w);
+				if (!rc.contains(old_x, old_y) || rc.contains(xs_[s], ys_[s]))
+				{
+					continue;
+				}
+				event_queue_.emplace_back(static_cast<int>(event_leave), handles_[w], handles_[s]);
+			}
+		}
+		for (slot_type w : node.watchers)
+		{
+			if (handles_[w] == handles_[s]) continue;
+			auto rc = view_rect(w);
+			if (!rc.contains(xs_[s], ys_[s]) || rc.contains(old_x, old_y))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(event_enter), handles_[w], handles_[s]);
+		}
+		release_tile(old_tile_x, old_tile_y);
+	}
+
+	void marker_event(tile& node, slot_type s, int eventid)
+	{
+		assert(std::find(node.markers.begin(), node.markers.end(), s) != node.markers.end());
+		for (slot_type w : node.watchers)
+		{
+			if (!view_rect(w).contains(xs_[s], ys_[s]))
+			{
+				continue;
+			}
+			event_queue_.emplace_back(static_cast<int>(eventid), handles_[w], handles_[s]);
+		}
+	}
+
+	void insert_watcher(tile& node, slot_type s)
+	{
+		assert(std::find(node.watchers.begin(), node.watchers.end(), s) == node.watchers.end());
+		node.watchers.push_back(s);
+	}
+
+	void remove_watcher(tile& node, slot_type s)
+	{
+		[[maybe_unused]] bool ok = swap_remove(node.watchers, s);
+		assert(ok);
+	}
+
+	void update_watcher(const tile& t,
+		const rect<int>& old_rect,
+		const rect<int>& new_rect,
+		slot_type s,
+		bool check_enter = true,
+		bool check_leave = true)
+	{
+		for (slot_type m : t.markers)
+		{
+			if (handles_[s] == handles_[m]) continue;
+			bool in_old_view = old_rect.contains(xs_[m], ys_[m]);
+			bool in_new_view = new_rect.contains(xs_[m], ys_[m]);
+			if (in_old_view)
+			{
+				if (enable_leave_event_ && !in_new_view && check_leave)
+				{
+					event_queue_.emplace_back(static_cast<int>(event_leave), handles_[s], handles_[m]);
+				}
+			}
+			else if (in_new_view && check_enter)
+			{
+				event_queue_.emplace_back(static_cast<int>(event_enter), handles_[s], handles_[m]);
+			}
+		}
+	}
+
+	template<typename Handler>
+	void for_each_rect(const rect<int> rc, const Handler& hander)
+	{
+		for (int i = rc.left(); i <= rc.right(); ++i)
+		{
+			for (int j = rc.bottom(); j <= rc.top(); ++j)
+			{
+				hander(i, j);
+			}
+		}
+	}
+private:
+	bool debug_ = false;
+	bool enable_leave_event_ = false;
+	const rect<int> rect_;
+	const int tile_size_;
+	const int map_size_;
+	const int count_;//向上取整的map_size_ / tile_size_
+	std::unordered_map<tile_key, tile> data_;//只保存非空格子
+	//对象槽位(SoA)
+	std::vector<int32_t> xs_;
+	std::vector<int32_t> ys_;
+	std::vector<int32_t> ws_;
+	std::vector<int32_t> hs_;
+	std::vector<int32_t> layers_;
+	std::vector<int32_t> modes_;
+	std::vector<object_handle_type> handles_;
+	std::vector<slot_type> free_;//空闲槽位
+	std::unordered_map<object_handle_type, slot_type> index_;//handle到槽位
+	std::vector<aoi_event> event_queue_;
+};
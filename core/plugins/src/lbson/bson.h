@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_set>
+
 #include "lua_kit.h"
 
 using namespace std;
@@ -14,6 +16,10 @@ namespace lbson {
     const uint32_t OP_MSG_HLEN      = 4 * 5 + 1;
     const uint32_t OP_CHECKSUM      = 1 << 0;
     const uint32_t OP_MORE_COME     = 1 << 1;
+    //请求标记: 回复的游标批次延迟解码
+    const uint64_t OP_LAZY_CURSOR   = 0x100000000;
+    //请求标记: 最后两个参数(标识, 文档数组)以文档序列(payload 1)发送
+    const uint64_t OP_DOC_SEQUENCE  = 0x200000000;
 
     static char bson_numstrs[max_bson_index][4];
     static int bson_numstr_len[max_bson_index];
@@ -56,15 +62,25 @@ namespace lbson {
         bson_value(bson_type t, const char* p, size_t l, uint8_t st = 0) : str(p, l), stype(st), type(t) {}
     };
     class mgocodec;
+    class bson_batch;
     class bson {
     public:
         friend mgocodec;
+        friend bson_batch;
         slice* encode_slice(lua_State* L) {
             m_buffer.clean();
             pack_dict(L, 0);
+            check_overflow(L);
             return m_buffer.get_slice();
         }
 
+        //超过缓冲上限的写入会被丢弃,编码结果不完整
+        void check_overflow(lua_State* L) {
+            if (m_buffer.overflow()) {
+                luaL_error(L, "bson encode overflow, limit:%d", (int)m_buffer.get_limit());
+            }
+        }
+
         int encode(lua_State* L) {
             size_t data_len = 0;
             slice* slice = encode_slice(L);
@@ -91,8 +107,7 @@ namespace lbson {
             return lua_gettop(L);
         }
 
-        uint8_t* encode_pairs(lua_State* L, size_t* data_len) {
-            int n = lua_gettop(L);
+        void write_pairs(lua_State* L, int n) {
             if (n < 2 || n % 2 != 0) {
                 luaL_error(L, "Invalid ordered dict");
             }
@@ -114,8 +129,38 @@ namespace lbson {
             m_buffer.write<uint8_t>(0);
             uint32_t size = m_buffer.size() - offset;
             m_buffer.copy(offset, (uint8_t*)&size, sizeof(uint32_t));
-            //返回结果
-            return m_buffer.data(data_len);
+        }
+
+        //OP_MSG文档序列: kind(1) + size + identifier + 文档*N
+        void write_sequence(lua_State* L, int index) {
+            size_t sz;
+            const char* name = lua_tolstring(L, index, &sz);
+            if (name == nullptr || !lua_istable(L, index + 1)) {
+                luaL_error(L, "Invalid document sequence");
+            }
+            m_buffer.write<uint8_t>(1);
+            size_t offset = m_buffer.size();
+            m_buffer.write<uint32_t>(0);
+            write_cstring(name, sz);
+            lua_pushvalue(L, index + 1);
+            size_t len = lua_rawlen(L, -1);
+            for (size_t i = 1; i <= len; i++) {
+                lua_geti(L, -1, i);
+                if (lua_type(L, -1) == LUA_TSTRING) {
+                    //bson.encode编码好的文档直接写入
+                    size_t dsz;
+                    const char* doc = lua_tolstring(L, -1, &dsz);
+                    m_buffer.push_data((uint8_t*)doc, dsz);
+                } else if (lua_istable(L, -1)) {
+                    pack_dict(L, 0);
+                } else {
+                    luaL_error(L, "Invalid document in sequence: %d", (int)i);
+                }
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+            uint32_t size = m_buffer.size() - offset;
+            m_buffer.copy(offset, (uint8_t*)&size, sizeof(uint32_t));
         }
 
         luabuf* get_buffer() {
@@ -219,6 +264,7 @@ namespace lbson {
             if (depth > max_bson_depth) {
                 luaL_error(L, "Too depth while encoding bson");
             }
+            lazy_table_load(L, -1);
             size_t raw_len = lua_rawlen(L, -1);
             bson_type type = check_doctype(L, raw_len);
             write_key(type, key, len);
@@ -312,6 +358,7 @@ namespace lbson {
         }
 
         void pack_dict(lua_State *L, int depth) {
+            lazy_table_load(L, -1);
             // length占位
             size_t offset = m_buffer.size();
             m_buffer.write<uint32_t>(0);
@@ -383,67 +430,112 @@ namespace lbson {
             }
             lua_createtable(L, 0, 8);
             while (!slice->empty()) {
-                size_t klen = 0;
                 bson_type bt = (bson_type)read_val<uint8_t>(L, slice);
                 if (bt == bson_type::BSON_EOO) break;
                 unpack_key(L, slice, isarray);
-                switch (bt) {
-                case bson_type::BSON_REAL:
-                    lua_pushnumber(L, read_val<double>(L, slice));
-                    break;
-                case bson_type::BSON_BOOLEAN:
-                    lua_pushboolean(L, read_val<bool>(L, slice));
-                    break;
-                case bson_type::BSON_INT32:
-                    lua_pushinteger(L, read_val<int32_t>(L, slice));
-                    break;
-                case bson_type::BSON_DATE:
-                case bson_type::BSON_INT64:
-                case bson_type::BSON_TIMESTAMP:
-                    lua_pushinteger(L, read_val<int64_t>(L, slice));
-                    break;
-                case bson_type::BSON_OBJECTID:{
-                        const char* s = read_bytes(L, slice, 12);
-                        lua_pushlstring(L, s, 12);
-                    }
-                    break;
-                case bson_type::BSON_JSCODE:
-                case bson_type::BSON_STRING:{
-                        const char* s = read_string(L, slice, klen);
-                        lua_pushlstring(L, s, klen);
-                    }
-                    break;
-                case bson_type::BSON_BINARY: {
-                        uint32_t sz = read_val<uint32_t>(L, slice);
-                        uint8_t subtype = read_val<uint8_t>(L, slice);
-                        const char* s = read_bytes(L, slice, sz);
-                        lua_pushlstring(L, s, sz);
-                    }
-                    break;
-                case bson_type::BSON_REGEX:
-                    lua_push_object(L, new bson_value(bt, read_cstring(slice, klen), read_cstring(slice, klen)));
-                    break;
-                case bson_type::BSON_DOCUMENT:
-                    unpack_dict(L, slice, false);
-                    break;
-                case bson_type::BSON_ARRAY:
-                    unpack_dict(L, slice, true);
-                    break;
-                case bson_type::BSON_MINKEY:
-                case bson_type::BSON_MAXKEY:
-                case bson_type::BSON_NULL:
-                    lua_push_object(L, new bson_value(bt, 0));
-                    break;
-                default:
-                    throw invalid_argument("invalid bson type:" + (int)bt);
-                }
+                unpack_value(L, slice, bt);
                 lua_rawset(L, -3);
             }
         }
+
+        void unpack_value(lua_State* L, slice* slice, bson_type bt) {
+            size_t klen = 0;
+            switch (bt) {
+            case bson_type::BSON_REAL:
+                lua_pushnumber(L, read_val<double>(L, slice));
+                break;
+            case bson_type::BSON_BOOLEAN:
+                lua_pushboolean(L, read_val<bool>(L, slice));
+                break;
+            case bson_type::BSON_INT32:
+                lua_pushinteger(L, read_val<int32_t>(L, slice));
+                break;
+            case bson_type::BSON_DATE:
+            case bson_type::BSON_INT64:
+            case bson_type::BSON_TIMESTAMP:
+                lua_pushinteger(L, read_val<int64_t>(L, slice));
+                break;
+            case bson_type::BSON_OBJECTID:{
+                    const char* s = read_bytes(L, slice, 12);
+                    lua_pushlstring(L, s, 12);
+                }
+                break;
+            case bson_type::BSON_JSCODE:
+            case bson_type::BSON_STRING:{
+                    const char* s = read_string(L, slice, klen);
+                    lua_pushlstring(L, s, klen);
+                }
+                break;
+            case bson_type::BSON_BINARY: {
+                    uint32_t sz = read_val<uint32_t>(L, slice);
+                    uint8_t subtype = read_val<uint8_t>(L, slice);
+                    const char* s = read_bytes(L, slice, sz);
+                    lua_pushlstring(L, s, sz);
+                }
+                break;
+            case bson_type::BSON_REGEX:
+                lua_push_object(L, new bson_value(bt, read_cstring(slice, klen), read_cstring(slice, klen)));
+                break;
+            case bson_type::BSON_DOCUMENT:
+                unpack_dict(L, slice, false);
+                break;
+            case bson_type::BSON_ARRAY:
+                unpack_dict(L, slice, true);
+                break;
+            case bson_type::BSON_MINKEY:
+            case bson_type::BSON_MAXKEY:
+            case bson_type::BSON_NULL:
+                lua_push_object(L, new bson_value(bt, 0));
+                break;
+            default:
+                throw invalid_argument("invalid bson type:" + (int)bt);
+            }
+        }
     private:
         luabuf m_buffer;
     };
 
+    //游标批次: 保留firstBatch/nextBatch的原始字节,每次next解码一个文档
+    class bson_batch {
+    public:
+        bson_batch(bson* bson, const char* data, size_t len) : m_bson(bson), m_data(data, len) {}
+
+        int next(lua_State* L) {
+            if (m_pos >= m_data.size()) return 0;
+            slice slice((uint8_t*)m_data.data() + m_pos, m_data.size() - m_pos);
+            try {
+                bson_type bt = (bson_type)m_bson->read_val<uint8_t>(L, &slice);
+                if (bt == bson_type::BSON_EOO) {
+                    m_pos = m_data.size();
+                    return 0;
+                }
+                size_t klen = 0;
+                m_bson->read_cstring(&slice, klen);
+                if (bt != bson_type::BSON_DOCUMENT) {
+                    throw invalid_argument("invalid cursor document type");
+                }
+                m_bson->unpack_dict(L, &slice, false);
+            } catch (const exception& e) {
+                m_pos = m_data.size();
+                luaL_error(L, e.what());
+            }
+            m_pos = m_data.size() - slice.size();
+            m_count++;
+            return 1;
+        }
+
+        //已解码的文档数
+        size_t count() { return m_count; }
+        //未解码的剩余字节
+        size_t remain() { return m_data.size() - m_pos; }
+
+    protected:
+        bson* m_bson;
+        string m_data;
+        size_t m_pos = sizeof(uint32_t);    //跳过数组头部长度
+        size_t m_count = 0;
+    };
+
     class mgocodec : public codec_base {
     public:
         virtual int load_packet(size_t data_len) {
@@ -461,13 +553,25 @@ namespace lbson {
             luabuf* buf = m_bson->get_buffer();
             buf->clean();
             buf->write<uint32_t>(0);
-            buf->write<uint32_t>(lua_tointeger(L, 1));
+            uint64_t session_id = lua_tointeger(L, 1);
+            if (session_id & OP_LAZY_CURSOR) {
+                m_cursors.insert((uint32_t)session_id);
+            }
+            buf->write<uint32_t>((uint32_t)session_id);
             buf->write<uint32_t>(0);
             buf->write<uint32_t>(OP_MSG_CODE);
             buf->write<uint32_t>(0);
             buf->write<uint8_t>(0);
             lua_remove(L, 1);
-            uint8_t* data = m_bson->encode_pairs(L, len);
+            if (session_id & OP_DOC_SEQUENCE) {
+                int n = lua_gettop(L) - 2;
+                m_bson->write_pairs(L, n);
+                m_bson->write_sequence(L, n + 1);
+            } else {
+                m_bson->write_pairs(L, lua_gettop(L));
+            }
+            m_bson->check_overflow(L);
+            uint8_t* data = buf->data(len);
             buf->copy(0, (uint8_t*)len, sizeof(uint32_t));
             return data;
         }
@@ -492,7 +596,14 @@ namespace lbson {
             int otop = lua_gettop(L);
             lua_pushinteger(L, session_id);
             try {
-                m_bson->unpack_dict(L, m_slice, false);
+                if (m_cursors.erase(session_id) > 0) {
+                    unpack_cursor(L, m_slice, 0);
+                } else {
+                    m_bson->unpack_dict(L, m_slice, false);
+                }
+                while (!m_slice->empty()) {
+                    unpack_sequence(L, m_slice);
+                }
             } catch (const exception& e){
                 lua_settop(L, otop);
                 throw e;
@@ -505,6 +616,61 @@ namespace lbson {
         }
 
     protected:
+        //文档序列(payload 1)合并到body中: body[identifier] = {doc, ...}
+        void unpack_sequence(lua_State* L, slice* slice) {
+            uint8_t kind = m_bson->read_val<uint8_t>(L, slice);
+            if (kind != 1) {
+                throw invalid_argument("unsupported payload:" + to_string(kind));
+            }
+            uint32_t sz = m_bson->read_val<uint32_t>(L, slice);
+            if (sz < sizeof(uint32_t) + 1 || slice->size() < sz - sizeof(uint32_t)) {
+                throw invalid_argument("invalid document sequence");
+            }
+            size_t remain = slice->size() - (sz - sizeof(uint32_t));
+            size_t klen = 0;
+            const char* key = m_bson->read_cstring(slice, klen);
+            lua_pushlstring(L, key, klen);
+            lua_createtable(L, 8, 0);
+            int index = 1;
+            while (slice->size() > remain) {
+                m_bson->unpack_dict(L, slice, false);
+                lua_rawseti(L, -2, index++);
+            }
+            lua_rawset(L, -3);
+        }
+
+        //游标回复: cursor下的批次数组不展开,交给bson_batch按需解码
+        void unpack_cursor(lua_State* L, slice* slice, int depth) {
+            uint32_t sz = m_bson->read_val<uint32_t>(L, slice);
+            if (slice->size() < sz - 4) {
+                throw invalid_argument("decode can't unpack one value");
+            }
+            lua_createtable(L, 0, 4);
+            while (!slice->empty()) {
+                size_t klen = 0;
+                bson_type bt = (bson_type)m_bson->read_val<uint8_t>(L, slice);
+                if (bt == bson_type::BSON_EOO) break;
+                string_view key = m_bson->read_cstring(slice, klen);
+                key = key.substr(0, klen);
+                lua_pushlstring(L, key.data(), klen);
+                if (depth == 0 && bt == bson_type::BSON_DOCUMENT && key == "cursor") {
+                    unpack_cursor(L, slice, depth + 1);
+                } else if (depth == 1 && bt == bson_type::BSON_ARRAY && (key == "firstBatch" || key == "nextBatch")) {
+                    uint32_t* len = (uint32_t*)slice->peek(sizeof(uint32_t));
+                    if (!len || *len < 5) {
+                        throw invalid_argument("invalid cursor batch");
+                    }
+                    size_t batch_len = *len;
+                    const char* data = m_bson->read_bytes(L, slice, batch_len);
+                    lua_push_object(L, new bson_batch(m_bson, data, batch_len));
+                } else {
+                    m_bson->unpack_value(L, slice, bt);
+                }
+                lua_rawset(L, -3);
+            }
+        }
+
         bson* m_bson;
+        unordered_set<uint32_t> m_cursors;
     };
 }
\ No newline at end of file
@@ -53,6 +53,11 @@ namespace lbson {
             "type", &bson_value::type,
             "stype", &bson_value::stype
             );
+        kit_state.new_class<bson_batch>(
+            "next", &bson_batch::next,
+            "count", &bson_batch::count,
+            "remain", &bson_batch::remain
+            );
         return llbson;
     }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <ctype.h>
 #include <string.h>
 
 #include "lua_kit.h"
@@ -32,11 +33,51 @@ namespace lcodec {
     #define SC_SERVERERROR      500
     #define SC_SERVERBUSY       503
 
+    //http分段解析阶段
+    const uint8_t HTTP_HEADER   = 0;
+    const uint8_t HTTP_CONTENT  = 1;
+    const uint8_t HTTP_CHUNKED  = 2;
+
     class httpcodec : public codec_base {
     public:
+        //先找到头部结束,再按Content-Length或逐个chunk走到结束chunk确定包长,数据不全时从断点继续查找
         virtual int load_packet(size_t data_len) {
             if (!m_slice) return 0;
-            return data_len;
+            string_view buf((const char*)m_slice->head(), data_len);
+            if (m_state->phase == HTTP_HEADER) {
+                size_t pos = buf.find(CRLF2, m_state->offset);
+                if (pos == string_view::npos) {
+                    m_state->offset = data_len > LCRLF2 ? data_len - LCRLF2 + 1 : 0;
+                    return 0;
+                }
+                size_t body = pos + LCRLF2;
+                string_view value;
+                string_view header = buf.substr(0, pos);
+                if (find_header(header, "Content-Length", value)) {
+                    m_state->expect = body + atol(value.data());
+                    m_state->phase = HTTP_CONTENT;
+                } else if (find_header(header, "Transfer-Encoding", value) && !value.empty() && !strncasecmp(value.data(), "chunked", value.size())) {
+                    m_state->offset = body;
+                    m_state->phase = HTTP_CHUNKED;
+                } else {
+                    //没有包体
+                    m_state->reset();
+                    return body;
+                }
+            }
+            size_t packet_len = m_state->expect;
+            if (m_state->phase == HTTP_CHUNKED) {
+                //offset停在未收完的chunk-size行
+                packet_len = walk_chunked(buf, m_state->offset, nullptr);
+                if (packet_len == string_view::npos) {
+                    m_state->reset();
+                    return -1;
+                }
+                if (packet_len == 0) return 0;
+            }
+            if (data_len < packet_len) return 0;
+            m_state->reset();
+            return packet_len;
         }
 
         virtual uint8_t* encode(lua_State* L, int index, size_t* len) {
@@ -78,6 +119,32 @@ namespace lcodec {
         }
 
     protected:
+        //从pos处的chunk-size行开始逐个跳过chunk,body不为空时拼接chunk数据
+        //返回结束chunk及trailer之后的位置,数据不全返回0(pos停在未收完的chunk),格式错误返回npos
+        size_t walk_chunked(string_view buf, size_t& pos, luabuf* body) {
+            while (true) {
+                size_t eol = buf.find(CRLF, pos);
+                if (eol == string_view::npos) return 0;
+                if (!isxdigit((uint8_t)buf[pos])) return string_view::npos;
+                //chunk扩展(;之后)由strtoull忽略
+                char* end = nullptr;
+                uint64_t size = strtoull(buf.data() + pos, &end, 16);
+                if (size > UINT32_MAX) return string_view::npos;
+                if (size == 0) {
+                    //结束chunk之后是可选的trailer和空行
+                    size_t tail = buf.find(CRLF2, eol);
+                    if (tail == string_view::npos) return 0;
+                    return tail + LCRLF2;
+                }
+                size_t data = eol + LCRLF;
+                size_t next = data + size + LCRLF;
+                if (next > buf.size()) return 0;
+                if (buf.compare(data + size, LCRLF, CRLF) != 0) return string_view::npos;
+                if (body) body->push_data((const uint8_t*)buf.data() + data, size);
+                pos = next;
+            }
+        }
+
         void format_http(size_t status) {
             switch (status) {
             case SC_OK:         m_buf->write("HTTP/1.1 200 OK\r\n"); break;
@@ -169,19 +236,15 @@ namespace lcodec {
                     }
                     else if (!strncasecmp(key.data(), "Transfer-Encoding", key.size()) && !strncasecmp(header.data(), "chunked", header.size())) {
                         contentlenable = true;
-                        size_t pos = buf.find(CRLF2);
-                        if (pos == string_view::npos) {
-                            throw length_error("http text not full");
+                        size_t pos = 0;
+                        size_t end = walk_chunked(buf, pos, m_buf);
+                        if (end == string_view::npos) {
+                            throw invalid_argument("invalid http chunked body");
                         }
-                        string_view chunk_data = buf.substr(0, pos);
-                        buf.remove_prefix(pos + LCRLF2);
-                        vector<string_view> chunks;
-                        split(chunk_data, CRLF, chunks);
-                        for (size_t i = 0; i < chunks.size(); i++) {
-                            if (i % 2 != 0) {
-                                m_buf->push_data((const uint8_t*)chunks[i].data(), chunks[i].size());
-                            }
+                        if (end == 0) {
+                            throw length_error("http text not full");
                         }
+                        buf.remove_prefix(end);
                         mslice = m_buf->get_slice();
                     }
                     else if (!strncasecmp(key.data(), "Content-Type", key.size()) && !strncasecmp(header.data(), "application/json", strlen("application/json"))) {
@@ -233,6 +296,23 @@ namespace lcodec {
             http_parse_body(L, header, buf);
         }
 
+        bool find_header(string_view header, string_view key, string_view& value) {
+            size_t pos = 0;
+            while (pos < header.size()) {
+                size_t end = header.find(CRLF, pos);
+                string_view line = header.substr(pos, end == string_view::npos ? string_view::npos : end - pos);
+                if (line.size() > key.size() && line[key.size()] == ':' && !strncasecmp(line.data(), key.data(), key.size())) {
+                    line.remove_prefix(key.size() + 1);
+                    size_t first = line.find_first_not_of(" ");
+                    value = first == string_view::npos ? string_view() : line.substr(first);
+                    return true;
+                }
+                if (end == string_view::npos) break;
+                pos = end + LCRLF;
+            }
+            return false;
+        }
+
         string_view read_line(string_view& buf) {
             size_t pos = buf.find(CRLF);
             auto ss = buf.substr(0, pos);
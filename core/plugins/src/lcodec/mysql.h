@@ -2,6 +2,7 @@
 
 #include <deque>
 #include <vector>
+#include <charconv>
 #include "lua_kit.h"
 
 using namespace std;
@@ -12,8 +13,12 @@ namespace lcodec {
     const uint8_t COM_SLEEP                 = 0x00;
     const uint8_t COM_CONNECT               = 0x0b;
     const uint8_t COM_STMT_PREPARE          = 0x16;
+    const uint8_t COM_STMT_EXECUTE          = 0x17;
     const uint8_t COM_STMT_CLOSE            = 0x19;
 
+    // cmd flags, 与cmd_id一起传入
+    const uint32_t MYSQL_COLUMNAR           = 0x100;    //行数据以数组返回,列名单独返回一次
+
     // constants
     inline uint32_t CLIENT_FLAG             = 260047;   //0011 1111 0111 1100 1111
     inline uint32_t MAX_PACKET_SIZE         = 0xffffff;
@@ -21,18 +26,26 @@ namespace lcodec {
     inline uint32_t CLIENT_DEPRECATE_EOF    = 1 << 24;
 
     // field types
+    const uint16_t MYSQL_TYPE_DECIMAL       = 0x00;
     const uint16_t MYSQL_TYPE_TINY          = 0x01;
     const uint16_t MYSQL_TYPE_SHORT         = 0x02;
     const uint16_t MYSQL_TYPE_LONG          = 0x03;
     const uint16_t MYSQL_TYPE_FLOAT         = 0x04;
     const uint16_t MYSQL_TYPE_DOUBLE        = 0x05;
     const uint16_t MYSQL_TYPE_NULL          = 0x06;
+    const uint16_t MYSQL_TYPE_TIMESTAMP     = 0x07;
     const uint16_t MYSQL_TYPE_LONGLONG      = 0x08;
     const uint16_t MYSQL_TYPE_INT24         = 0x09;
+    const uint16_t MYSQL_TYPE_DATE          = 0x0a;
+    const uint16_t MYSQL_TYPE_TIME          = 0x0b;
+    const uint16_t MYSQL_TYPE_DATETIME      = 0x0c;
     const uint16_t MYSQL_TYPE_YEAR          = 0x0d;
     const uint16_t MYSQL_TYPE_VARCHAR       = 0x0f;
     const uint16_t MYSQL_TYPE_NEWDECIMAL    = 0xf6;
 
+    // field flags
+    const uint16_t UNSIGNED_FLAG            = 32;
+
     // server status
     inline size_t SERVER_MORE_RESULTS_EXISTS    = 8;
 
@@ -45,15 +58,24 @@ namespace lcodec {
         MP_INF  = 4,
     };
 
+    //响应分段解析阶段
+    const uint8_t MYSQL_FIRST   = 0;    //首包
+    const uint8_t MYSQL_FIELD   = 1;    //列定义
+    const uint8_t MYSQL_ROWS    = 2;    //行数据
+    const uint8_t MYSQL_MORE    = 3;    //下一个结果集
+    const uint8_t MYSQL_PREPARE = 4;    //预处理的参数和列定义
+
     struct mysql_cmd {
         uint8_t  cmd_id;
         size_t session_id;
+        bool columnar = false;
     };
 
     struct mysql_column {
         string_view name;
         uint8_t type;
         uint16_t flags;
+        uint8_t decimals;
     };
     typedef vector<mysql_column> mysql_columns;
 
@@ -63,21 +85,40 @@ namespace lcodec {
             sessions.push_back(mysql_cmd{ COM_SLEEP, session_id });
         }
 
+        //按解码的顺序逐个检查包头,收齐一个完整响应才返回长度,数据不全时从断点继续
+        //超过16M的包由多个分片组成,后续分片不参与判断(expect非0表示还有后续分片)
         virtual int load_packet(size_t data_len) {
             if (!m_slice) return 0;
-            return data_len;
+            if (sessions.empty()) return data_len;
+            uint8_t* data = m_slice->head();
+            while (data_len - m_state->offset >= sizeof(uint32_t)) {
+                uint32_t length = *(uint32_t*)(data + m_state->offset) & 0xffffff;
+                if (data_len - m_state->offset - sizeof(uint32_t) < length) return 0;
+                slice packet(data + m_state->offset + sizeof(uint32_t), length);
+                m_state->offset += sizeof(uint32_t) + length;
+                bool partial = m_state->expect > 0;
+                m_state->expect = (length == MAX_PACKET_SIZE) ? 1 : 0;
+                if (partial) continue;
+                if (check_packet(packet)) {
+                    size_t packet_len = m_state->offset;
+                    m_state->reset();
+                    return packet_len;
+                }
+            }
+            return 0;
         }
 
         virtual uint8_t* encode(lua_State* L, int index, size_t* len) {
             m_buf->clean();
-            // cmd_id
-            uint8_t cmd_id = (uint8_t)lua_tointeger(L, index++);
+            // cmd_id + flags
+            uint32_t cmd = (uint32_t)lua_tointeger(L, index++);
+            uint8_t cmd_id = (uint8_t)(cmd & 0xff);
             // session_id
             size_t session_id = lua_tointeger(L, index++);
             //4 byte header placeholder
             m_buf->write<uint32_t>(0);
             if (cmd_id != COM_CONNECT) {
-                return comand_encode(L, cmd_id, session_id, index, len);
+                return comand_encode(L, cmd_id, session_id, index, len, (cmd & MYSQL_COLUMNAR) == MYSQL_COLUMNAR);
             }
             return auth_encode(L, cmd_id, session_id, index, len);
         }
@@ -98,7 +139,7 @@ namespace lcodec {
                 prepare_decode(L);
                 break;
             default:
-                command_decode(L);
+                command_decode(L, cmd);
                 break;
             }
             sessions.pop_front();
@@ -107,17 +148,101 @@ namespace lcodec {
         }
 
     protected:
-        packet_type recv_packet() {
-            uint32_t payload = *(uint32_t*)m_slice->read<uint32_t>();
-            uint32_t length = (payload & 0xffffff);
-            if (length >= 0xffffff) {
-                throw invalid_argument("sharded packet not suppert!");
+        bool deprecate_eof() {
+            return (m_capability & CLIENT_FLAG & CLIENT_DEPRECATE_EOF) == CLIENT_DEPRECATE_EOF;
+        }
+
+        packet_type packet_kind(slice& packet) {
+            uint8_t* data = packet.peek(1);
+            if (!data) return packet_type::MP_DATA;
+            switch (*data) {
+            case 0xfb: return packet_type::MP_INF;
+            case 0xfe: return packet_type::MP_EOF;
+            case 0x00: return packet_type::MP_OK;
+            case 0xff: return packet_type::MP_ERR;
+            }
+            return packet_type::MP_DATA;
+        }
+
+        //行数据阶段只有eof/err是结束包,0x00(二进制行)和0xfb(NULL列)开头的都是行数据
+        //长度编码的0xfe开头的行至少有9个字节
+        packet_type row_kind(uint8_t* data, size_t length) {
+            if (length == 0) return packet_type::MP_DATA;
+            if (*data == 0xff) return packet_type::MP_ERR;
+            if (*data == 0xfe && length < (deprecate_eof() ? MAX_PACKET_SIZE : 9)) return packet_type::MP_EOF;
+            return packet_type::MP_DATA;
+        }
+
+        //返回响应是否已完整
+        bool check_packet(slice& packet) {
+            switch (m_state->phase) {
+            case MYSQL_FIRST: {
+                    uint8_t cmd_id = sessions.front().cmd_id;
+                    if (cmd_id == COM_SLEEP) return true;
+                    if (cmd_id == COM_STMT_PREPARE) {
+                        //ok + 参数定义 + eof + 列定义 + eof
+                        if (packet_kind(packet) != packet_type::MP_OK) return true;
+                        packet.erase(5);
+                        uint16_t* num_columns = packet.read<uint16_t>();
+                        uint16_t* num_params = packet.read<uint16_t>();
+                        if (!num_columns || !num_params) return true;
+                        m_state->pending = field_packets(*num_columns) + field_packets(*num_params);
+                        m_state->phase = MYSQL_PREPARE;
+                        return m_state->pending == 0;
+                    }
+                    if (packet_kind(packet) != packet_type::MP_DATA) return true;
+                }
+                //fallthrough
+            case MYSQL_MORE: {
+                    //列数 + 列定义 + 列定义结束的eof
+                    m_state->pending = field_packets(length_encoded_number(packet));
+                    m_state->phase = m_state->pending > 0 ? MYSQL_FIELD : MYSQL_ROWS;
+                    return false;
+                }
+            case MYSQL_FIELD:
+                if (--m_state->pending <= 0) {
+                    m_state->phase = MYSQL_ROWS;
+                }
+                return false;
+            case MYSQL_PREPARE:
+                return --m_state->pending <= 0;
+            default: {
+                    packet_type type = row_kind(packet.head(), packet.size());
+                    if (type == packet_type::MP_DATA) return false;
+                    if (type == packet_type::MP_ERR) return true;
+                    if (more_results(packet)) {
+                        m_state->phase = MYSQL_MORE;
+                        return false;
+                    }
+                    return true;
+                }
+            }
+        }
+
+        //定义包的数量,不使用CLIENT_DEPRECATE_EOF时后面跟一个eof
+        size_t field_packets(size_t count) {
+            return (count > 0 && !deprecate_eof()) ? count + 1 : count;
+        }
+
+        //与eof_packet_decode的格式一致,只取是否还有结果集
+        bool more_results(slice packet) {
+            packet.erase(1);
+            if (deprecate_eof()) {
+                length_encoded_number(packet);
+                length_encoded_number(packet);
+            } else {
+                packet.erase(sizeof(uint16_t));
             }
-            uint8_t* data = m_slice->erase(length);
-            if (!data) {
-                throw length_error("mysql text not full");
+            uint16_t* status_flags = packet.read<uint16_t>();
+            return status_flags && ((*status_flags & SERVER_MORE_RESULTS_EXISTS) == SERVER_MORE_RESULTS_EXISTS);
+        }
+
+        packet_type recv_packet(bool row = false) {
+            uint8_t* data = recv_payload();
+            if (row) {
+                return row_kind(data, m_packet.size());
             }
-            m_packet.attach(data, length);
+            if (m_packet.empty()) return packet_type::MP_DATA;
             switch (*data) {
             case 0xfb: return packet_type::MP_INF;
             case 0xfe: return packet_type::MP_EOF;
@@ -127,7 +252,57 @@ namespace lcodec {
             return packet_type::MP_DATA;
         }
 
-        uint8_t* comand_encode(lua_State* L, uint8_t cmd_id, size_t session_id, int index, size_t* len) {
+        //读取一个完整的包到m_packet
+        //超过16M的包由多个分片组成,把后续分片的内容前移拼接在第一个分片后面,原地去掉分片头
+        uint8_t* recv_payload() {
+            uint8_t* data = nullptr;
+            size_t total = 0;
+            uint32_t length = MAX_PACKET_SIZE;
+            while (length == MAX_PACKET_SIZE) {
+                uint32_t* payload = m_slice->read<uint32_t>();
+                if (!payload) {
+                    throw length_error("mysql text not full");
+                }
+                length = (*payload & 0xffffff);
+                uint8_t* part = m_slice->erase(length);
+                if (!part) {
+                    throw length_error("mysql text not full");
+                }
+                if (!data) {
+                    data = part;
+                } else if (length > 0) {
+                    memmove(data + total, part, length);
+                }
+                total += length;
+            }
+            m_packet.attach(data, total);
+            return data;
+        }
+
+        //写入包头,超过16M时拆成多个分片,每个分片带自己的包头和序号
+        uint8_t* packet_encode(uint8_t seq, size_t* len) {
+            size_t size = m_buf->size() - sizeof(uint32_t);
+            size_t count = size / MAX_PACKET_SIZE;
+            if (count > 0) {
+                m_buf->peek_space(count * sizeof(uint32_t));
+                m_buf->pop_space(count * sizeof(uint32_t));
+            }
+            uint8_t* data = m_buf->head();
+            //从后往前移动,分片i的内容移到i+1个包头之后
+            for (size_t i = count + 1; i-- > 0;) {
+                size_t offset = i * MAX_PACKET_SIZE;
+                uint32_t length = (uint32_t)std::min<size_t>(size - offset, MAX_PACKET_SIZE);
+                uint8_t* target = data + offset + (i + 1) * sizeof(uint32_t);
+                if (i > 0) {
+                    memmove(target, data + offset + sizeof(uint32_t), length);
+                }
+                uint32_t head = length | ((uint32_t)(uint8_t)(seq + i) << 24);
+                memcpy(target - sizeof(uint32_t), &head, sizeof(uint32_t));
+            }
+            return m_buf->data(len);
+        }
+
+        uint8_t* comand_encode(lua_State* L, uint8_t cmd_id, size_t session_id, int index, size_t* len, bool columnar) {
             m_buf->write<uint8_t>(cmd_id);
             int top = lua_gettop(L);
             if (index <= top) {
@@ -140,17 +315,15 @@ namespace lcodec {
                     m_buf->push_data(query, data_len);
                 }
             }
-            if (index <= top) {
+            if (cmd_id == COM_STMT_EXECUTE) {
                 encode_stmt_args(L, index, top - index + 1);
             }
-            // header
-            uint32_t size = (m_buf->size() - 4) & 0xffffff;
-            m_buf->copy(0, (uint8_t*)&size, 4);
             // cmd
             if (cmd_id != COM_STMT_CLOSE) {
-                sessions.push_back(mysql_cmd{ cmd_id, session_id });
+                sessions.push_back(mysql_cmd{ cmd_id, session_id, columnar });
             }
-            return m_buf->data(len);
+            // header
+            return packet_encode(0, len);
         }
 
         uint8_t* auth_encode(lua_State* L, uint8_t cmd_id, size_t session_id, int index, size_t* len) {
@@ -174,21 +347,19 @@ namespace lcodec {
             const uint8_t* dbname = (const uint8_t*)lua_tolstring(L, index++, len);
             m_buf->push_data(dbname, *len);
             m_buf->push_data((uint8_t*)"\0", 1);
-            // header
-            uint32_t size = ((m_buf->size() - 4) & 0xffffff) | 0x01000000;
-            m_buf->copy(0, (uint8_t*)&size, 4);
             // cmd
             sessions.push_back(mysql_cmd{ cmd_id, session_id });
-            return m_buf->data(len);
+            // header
+            return packet_encode(1, len);
         }
 
-        void command_decode(lua_State* L) {
+        void command_decode(lua_State* L, const mysql_cmd& cmd) {
             packet_type type = recv_packet();
             switch (type) {
             case packet_type::MP_OK:
                 return ok_packet_decode(L);
             case packet_type::MP_DATA:
-                return data_packet_decode(L);
+                return data_packet_decode(L, cmd);
             case packet_type::MP_ERR:
                 return err_packet_decode(L);
             default: throw invalid_argument("unsuppert mysql packet type");
@@ -209,46 +380,224 @@ namespace lcodec {
             uint8_t type = *(uint8_t*)m_packet.read<uint8_t>();
             uint16_t flags = *(uint16_t*)m_packet.read<uint16_t>();
             uint8_t decimals = *(uint8_t*)m_packet.read<uint8_t>();
-            columns.push_back(mysql_column { name, type, decimals });
+            columns.push_back(mysql_column { name, type, flags, decimals });
         }
 
-        packet_type rows_decode(lua_State* L, mysql_columns& columns) {
+        //列名只创建一次放在栈上,每行复用,不再为每行每列重新创建key
+        //columnar模式下行数据为按列顺序的数组,列名放在columns字段
+        packet_type rows_decode(lua_State* L, mysql_columns& columns, bool binary, bool columnar) {
+            int rows = lua_gettop(L);
+            int ncol = (int)columns.size();
+            luaL_checkstack(L, ncol + 4, "mysql too many columns");
+            int names = rows + 1;
+            if (columnar) {
+                lua_createtable(L, ncol, 0);
+            }
+            for (int i = 0; i < ncol; ++i) {
+                lua_pushlstring(L, columns[i].name.data(), columns[i].name.size());
+                if (columnar) lua_seti(L, -2, i + 1);
+            }
+            if (columnar) {
+                lua_setfield(L, rows, "columns");
+            }
             // rows
             size_t row_indx = 1;
-            packet_type type = recv_packet();
-            while (type == packet_type::MP_DATA){
+            packet_type type = recv_packet(true);
+            while (type == packet_type::MP_DATA) {
                 // row
-                lua_createtable(L, 0, 8);
-                for (const mysql_column& column : columns) {
-                    auto value = decode_length_encoded_string();
-                    lua_pushlstring(L, column.name.data(), column.name.size());
-                    switch (column.type) {
-                    case MYSQL_TYPE_FLOAT:
-                    case MYSQL_TYPE_DOUBLE:
-                        lua_pushnumber(L, strtod(value.data(), nullptr));
-                        break;
-                    case MYSQL_TYPE_TINY:
-                    case MYSQL_TYPE_SHORT:
-                    case MYSQL_TYPE_LONG:
-                    case MYSQL_TYPE_INT24:
-                    case MYSQL_TYPE_YEAR:
-                    case MYSQL_TYPE_LONGLONG:
-                    case MYSQL_TYPE_NEWDECIMAL:
-                        lua_pushinteger(L, strtoll(value.data(), nullptr, 10));
-                        break;
-                    default:
-                        lua_pushlstring(L, value.data(), value.size());
-                        break;
+                uint8_t* nulls = nullptr;
+                if (binary) {
+                    //1 byte header + null_bitmap, 偏移2位
+                    nulls = m_packet.erase(1 + (ncol + 7 + 2) / 8);
+                    if (!nulls) throw invalid_argument("invalid mysql binary row");
+                    nulls++;
+                }
+                lua_createtable(L, columnar ? ncol : 0, columnar ? 0 : ncol);
+                for (int i = 0; i < ncol; ++i) {
+                    const mysql_column& column = columns[i];
+                    if (binary) {
+                        size_t bit = i + 2;
+                        if (nulls[bit / 8] & (1 << (bit % 8))) continue;
+                        binary_value_decode(L, column);
+                    } else {
+                        uint8_t* flag = m_packet.peek(1);
+                        if (flag && *flag == 0xfb) {
+                            //NULL
+                            m_packet.erase(1);
+                            continue;
+                        }
+                        text_value_decode(L, column, decode_length_encoded_string());
+                    }
+                    if (columnar) {
+                        lua_seti(L, -2, i + 1);
+                    } else {
+                        lua_pushvalue(L, names + i);
+                        lua_insert(L, -2);
+                        lua_rawset(L, -3);
                     }
-                    lua_rawset(L, -3);
                 }
-                lua_seti(L, -2, row_indx++);
-                type = recv_packet();
+                lua_seti(L, rows, row_indx++);
+                type = recv_packet(true);
             }
+            lua_settop(L, rows);
             return type;
         }
 
-        bool result_set_decode(lua_State* L, size_t top, size_t rset_idx) {
+        void integer_decode(lua_State* L, string_view value) {
+            int64_t ival = 0;
+            auto res = from_chars(value.data(), value.data() + value.size(), ival);
+            if (res.ec == errc() && res.ptr == value.data() + value.size()) {
+                lua_pushinteger(L, ival);
+                return;
+            }
+            //无符号大数或带小数的decimal
+            double dval = 0;
+            from_chars(value.data(), value.data() + value.size(), dval);
+            lua_pushnumber(L, dval);
+        }
+
+        void text_value_decode(lua_State* L, const mysql_column& column, string_view value) {
+            switch (column.type) {
+            case MYSQL_TYPE_FLOAT:
+            case MYSQL_TYPE_DOUBLE: {
+                    double dval = 0;
+                    from_chars(value.data(), value.data() + value.size(), dval);
+                    lua_pushnumber(L, dval);
+                }
+                break;
+            case MYSQL_TYPE_TINY:
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_INT24:
+            case MYSQL_TYPE_YEAR:
+            case MYSQL_TYPE_LONGLONG:
+            case MYSQL_TYPE_DECIMAL:
+            case MYSQL_TYPE_NEWDECIMAL:
+                integer_decode(L, value);
+                break;
+            default:
+                lua_pushlstring(L, value.data(), value.size());
+                break;
+            }
+        }
+
+        template<typename T>
+        T binary_read() {
+            T* value = m_packet.read<T>();
+            if (!value) throw invalid_argument("invalid mysql binary row");
+            return *value;
+        }
+
+        template<typename S, typename U>
+        void binary_integer_decode(lua_State* L, const mysql_column& column) {
+            if (column.flags & UNSIGNED_FLAG) {
+                U value = binary_read<U>();
+                if (sizeof(U) == sizeof(uint64_t) && (uint64_t)value > (uint64_t)INT64_MAX) {
+                    lua_pushnumber(L, (double)value);
+                    return;
+                }
+                lua_pushinteger(L, (lua_Integer)value);
+                return;
+            }
+            lua_pushinteger(L, (lua_Integer)binary_read<S>());
+        }
+
+        //二进制协议的日期时间格式化成与文本协议相同的字符串
+        void datetime_decode(lua_State* L, const mysql_column& column) {
+            char buf[64];
+            uint16_t year = 0;
+            uint8_t month = 0, day = 0, hour = 0, minute = 0, second = 0;
+            uint32_t micro = 0;
+            uint8_t length = binary_read<uint8_t>();
+            if (length >= 4) {
+                year = binary_read<uint16_t>();
+                month = binary_read<uint8_t>();
+                day = binary_read<uint8_t>();
+            }
+            if (length >= 7) {
+                hour = binary_read<uint8_t>();
+                minute = binary_read<uint8_t>();
+                second = binary_read<uint8_t>();
+            }
+            if (length >= 11) {
+                micro = binary_read<uint32_t>();
+            }
+            int n = snprintf(buf, sizeof(buf), "%04u-%02u-%02u", year, month, day);
+            if (column.type != MYSQL_TYPE_DATE) {
+                n += snprintf(buf + n, sizeof(buf) - n, " %02u:%02u:%02u", hour, minute, second);
+                n += fraction_format(buf + n, sizeof(buf) - n, column.decimals, micro);
+            }
+            lua_pushlstring(L, buf, n);
+        }
+
+        void time_decode(lua_State* L, const mysql_column& column) {
+            char buf[64];
+            uint8_t negative = 0, hour = 0, minute = 0, second = 0;
+            uint32_t days = 0, micro = 0;
+            uint8_t length = binary_read<uint8_t>();
+            if (length >= 8) {
+                negative = binary_read<uint8_t>();
+                days = binary_read<uint32_t>();
+                hour = binary_read<uint8_t>();
+                minute = binary_read<uint8_t>();
+                second = binary_read<uint8_t>();
+            }
+            if (length >= 12) {
+                micro = binary_read<uint32_t>();
+            }
+            int n = snprintf(buf, sizeof(buf), "%s%02u:%02u:%02u", negative ? "-" : "", days * 24 + hour, minute, second);
+            n += fraction_format(buf + n, sizeof(buf) - n, column.decimals, micro);
+            lua_pushlstring(L, buf, n);
+        }
+
+        int fraction_format(char* buf, size_t size, uint8_t decimals, uint32_t micro) {
+            if (decimals == 0 || decimals > 6) return 0;
+            char frac[8];
+            snprintf(frac, sizeof(frac), "%06u", micro);
+            return snprintf(buf, size, ".%.*s", (int)decimals, frac);
+        }
+
+        void binary_value_decode(lua_State* L, const mysql_column& column) {
+            switch (column.type) {
+            case MYSQL_TYPE_TINY:
+                binary_integer_decode<int8_t, uint8_t>(L, column);
+                break;
+            case MYSQL_TYPE_SHORT:
+            case MYSQL_TYPE_YEAR:
+                binary_integer_decode<int16_t, uint16_t>(L, column);
+                break;
+            case MYSQL_TYPE_LONG:
+            case MYSQL_TYPE_INT24:
+                binary_integer_decode<int32_t, uint32_t>(L, column);
+                break;
+            case MYSQL_TYPE_LONGLONG:
+                binary_integer_decode<int64_t, uint64_t>(L, column);
+                break;
+            case MYSQL_TYPE_FLOAT:
+                lua_pushnumber(L, binary_read<float>());
+                break;
+            case MYSQL_TYPE_DOUBLE:
+                lua_pushnumber(L, binary_read<double>());
+                break;
+            case MYSQL_TYPE_DATE:
+            case MYSQL_TYPE_DATETIME:
+            case MYSQL_TYPE_TIMESTAMP:
+                datetime_decode(L, column);
+                break;
+            case MYSQL_TYPE_TIME:
+                time_decode(L, column);
+                break;
+            case MYSQL_TYPE_NULL:
+                lua_pushnil(L);
+                break;
+            default:
+                //decimal和字符串类型与文本协议一样是长度编码的字符串
+                text_value_decode(L, column, decode_length_encoded_string());
+                break;
+            }
+        }
+
+        bool result_set_decode(lua_State* L, size_t top, size_t rset_idx, const mysql_cmd& cmd) {
             // result set header
             lua_createtable(L, 0, 8);
             size_t column_count = decode_length_encoded_number();
@@ -259,12 +608,12 @@ namespace lcodec {
                 field_decode(columns);
             }
             // field eof
-            if ((m_capability & CLIENT_DEPRECATE_EOF) != CLIENT_DEPRECATE_EOF) {
+            if (!deprecate_eof()) {
                 recv_packet();
                 eof_packet_decode();
             }
-            // rows data
-            packet_type type = rows_decode(L, columns);
+            // rows data, 预处理语句返回二进制行
+            packet_type type = rows_decode(L, columns, cmd.cmd_id == COM_STMT_EXECUTE, cmd.columnar);
             lua_seti(L, -2, rset_idx);
             // terminator
             if (type == packet_type::MP_ERR) {
@@ -276,16 +625,16 @@ namespace lcodec {
             return eof_packet_decode();
         }
 
-        void data_packet_decode(lua_State* L) {
+        void data_packet_decode(lua_State* L, const mysql_cmd& cmd) {
             size_t rset_idx = 1;
             int top = lua_gettop(L);
             lua_pushboolean(L, true);
             //result sets
             lua_createtable(L, 0, 4);
-            bool more = result_set_decode(L, top, rset_idx++);
+            bool more = result_set_decode(L, top, rset_idx++, cmd);
             while (more) {
                 recv_packet();
-                more = result_set_decode(L, top, rset_idx++);
+                more = result_set_decode(L, top, rset_idx++, cmd);
             }
         }
 
@@ -334,7 +683,7 @@ namespace lcodec {
         bool eof_packet_decode() {
             //type
             m_packet.read<uint8_t>();
-            if ((m_capability & CLIENT_DEPRECATE_EOF) == CLIENT_DEPRECATE_EOF) {
+            if (deprecate_eof()) {
                 size_t affected_rows = decode_length_encoded_number();
                 size_t last_insert_id = decode_length_encoded_number();
                 uint16_t status_flags = *(uint16_t*)m_packet.read<uint16_t>();
@@ -350,12 +699,19 @@ namespace lcodec {
         }
 
         void prepare_decode(lua_State* L) {
-            recv_packet();
+            if (recv_packet() == packet_type::MP_ERR) {
+                return err_packet_decode(L);
+            }
             uint8_t status = *(uint8_t*)m_packet.read<uint8_t>();
             uint32_t statement_id = *(uint32_t*)m_packet.read<uint32_t>();
             uint16_t num_columns = *(uint16_t*)m_packet.read<uint16_t>();
             uint16_t num_params = *(uint16_t*)m_packet.read<uint16_t>();
-            int top = lua_gettop(L);
+            //参数和列定义在执行时会重新返回,这里跳过
+            size_t count = field_packets(num_columns) + field_packets(num_params);
+            for (size_t i = 0; i < count; ++i) {
+                recv_packet();
+            }
+            lua_pushboolean(L, true);
             lua_pushinteger(L, statement_id);
             lua_pushinteger(L, num_columns);
             lua_pushinteger(L, num_params);
@@ -407,17 +763,12 @@ namespace lcodec {
             m_buf->write<uint8_t>(0);
             //iteration_count
             m_buf->write<uint32_t>(1);
-            //null_bitmap, length= (argnum + 7) / 8
-            int argpos = 0;
-            int argbyte = (argnum + 7) / 8;
-            for (int i = 0; i < argbyte; ++i) {
+            if (argnum <= 0) return;
+            //null_bitmap, length= (argnum + 7) / 8, 第i位为1表示第i个参数为NULL
+            for (int i = 0; i < argnum; i += 8) {
                 uint8_t byte = 0;
-                for (int j = 0; j < 7; ++j) {
-                    int aindex = index + argpos++;
-                    if (aindex < argnum) {
-                        uint8_t bit = lua_isnil(L, aindex) ? 0 : 1;
-                        byte |= (bit < j);
-                    }
+                for (int j = 0; j < 8 && i + j < argnum; ++j) {
+                    if (lua_isnil(L, index + i + j)) byte |= (1 << j);
                 }
                 m_buf->write<uint8_t>(byte);
             }
@@ -456,14 +807,14 @@ namespace lcodec {
         void encode_args_value(lua_State* L, int index) {
             switch (lua_type(L, index)) {
             case LUA_TBOOLEAN:
-                m_buf->write<double>(lua_tointeger(L, index));
+                m_buf->write<uint8_t>(lua_toboolean(L, index));
                 break;
             case LUA_TNUMBER:
                 lua_isinteger(L, index) ? m_buf->write<uint64_t>(lua_tointeger(L, index)) : m_buf->write<double>(lua_tonumber(L, index));
                 break;
             case LUA_TSTRING: {
-                    uint32_t data_len;
-                    uint8_t* data = (uint8_t*)lua_tolstring(L, index, (size_t*)&data_len);
+                    size_t data_len;
+                    uint8_t* data = (uint8_t*)lua_tolstring(L, index, &data_len);
                     if (data_len < 0xfb) {
                         m_buf->write<uint8_t>(data_len);
                     }
@@ -472,7 +823,7 @@ namespace lcodec {
                         m_buf->write<uint16_t>(data_len);
                     }
                     else if (data_len < 0xffffff) {
-                        m_buf->write<uint32_t>((0xfd << 24) | data_len);
+                        m_buf->write<uint32_t>(0xfd | ((uint32_t)data_len << 8));
                     }
                     else {
                         m_buf->write<uint8_t>(0xfe);
@@ -488,11 +839,27 @@ namespace lcodec {
             uint8_t nbyte = *(uint8_t*)m_packet.read<uint8_t>();
             if (nbyte < 0xfb) return nbyte;
             if (nbyte == 0xfc) return *(uint16_t*)m_packet.read<uint16_t>();
-            if (nbyte == 0xfd) return *(uint32_t*)m_packet.read<uint32_t>();
+            if (nbyte == 0xfd) return uint24_decode(m_packet.erase(3));
             if (nbyte == 0xfe) return *(uint64_t*)m_packet.read<uint64_t>();
             return 0;
         }
 
+        size_t uint24_decode(uint8_t* data) {
+            if (!data) throw invalid_argument("invalid length coded number");
+            return data[0] | (data[1] << 8) | (data[2] << 16);
+        }
+
+        //包不完整时返回0,只用于分段检查
+        size_t length_encoded_number(slice& packet) {
+            uint8_t* nbyte = packet.read<uint8_t>();
+            if (!nbyte) return 0;
+            if (*nbyte < 0xfb) return *nbyte;
+            if (*nbyte == 0xfc) { uint16_t* v = packet.read<uint16_t>(); return v ? *v : 0; }
+            if (*nbyte == 0xfd) { uint8_t* v = packet.erase(3); return v ? uint24_decode(v) : 0; }
+            if (*nbyte == 0xfe) { uint64_t* v = packet.read<uint64_t>(); return v ? *v : 0; }
+            return 0;
+        }
+
         string_view decode_length_encoded_string() {
             size_t length = decode_length_encoded_number();
             if (length > 0) {
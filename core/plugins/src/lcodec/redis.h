@@ -1,6 +1,7 @@
 #pragma once
 #include <deque>
 #include <string>
+#include <charconv>
 
 #ifdef _MSC_VER
 #define strncasecmp _strnicmp
@@ -16,33 +17,143 @@ namespace lcodec {
     inline size_t       HEAD_SIZE   = 24;
     inline const char*  RDS_CRLF    = "\r\n";
 
+    //管线请求: count为合并发送的命令数,0表示单条命令
+    struct redis_cmd {
+        uint32_t session_id;
+        uint32_t count;
+    };
+
     class rdscodec : public codec_base {
     public:
+        //逐行扫描到一个完整的回复才返回长度,数据不全时记录进度,下次从断点继续
+        //管线请求的所有回复合成一个包
         virtual int load_packet(size_t data_len) {
             if (!m_slice) return 0;
-            return data_len;
+            const char* data = (const char*)m_slice->head();
+            if (m_state->pending == 0) {
+                bool push = data_len > 0 && data[0] == '>';
+                m_state->pending = (push || sessions.empty()) ? 1 : std::max<uint32_t>(sessions.front().count, 1);
+            }
+            while (m_state->pending > 0) {
+                //bulk string的内容按长度跳过
+                if (m_state->expect > 0) {
+                    if (data_len - m_state->offset < m_state->expect) return 0;
+                    m_state->offset += m_state->expect;
+                    m_state->expect = 0;
+                    m_state->pending--;
+                    continue;
+                }
+                string_view buf(data + m_state->offset, data_len - m_state->offset);
+                size_t pos = buf.find(RDS_CRLF);
+                if (pos == string_view::npos) return 0;
+                if (pos == 0) return -1;
+                int64_t length = atoll(buf.data() + 1);
+                m_state->offset += pos + CRLF_LEN;
+                m_state->pending--;
+                switch (buf[0]) {
+                case '+':
+                case '-':
+                case ':':
+                case '_':
+                case '#':
+                case ',':
+                case '(':
+                    break;
+                case '$':
+                case '!':
+                case '=':
+                    if (length >= 0) {
+                        m_state->expect = length + CRLF_LEN;
+                        m_state->pending++;
+                    }
+                    break;
+                case '*':
+                case '~':
+                case '>':
+                    if (length > 0) {
+                        m_state->pending += length;
+                    }
+                    break;
+                case '%':
+                    if (length > 0) {
+                        m_state->pending += length * 2;
+                    }
+                    break;
+                case '|':
+                    //属性之后还跟着真正的回复
+                    m_state->pending += length * 2 + 1;
+                    break;
+                default:
+                    return -1;
+                }
+            }
+            size_t packet_len = m_state->offset;
+            m_state->reset();
+            return packet_len;
         }
 
+        //参数为(session_id, cmd, ...)时发送单条命令
+        //参数为(session_id, { {cmd, ...}, ... })时所有命令合并成一次写入
         virtual uint8_t* encode(lua_State* L, int index, size_t* len) {
             m_buf->clean();
             int n = lua_gettop(L);
             uint32_t session_id = lua_tointeger(L, index++);
-            char* head = (char*)m_buf->peek_space(HEAD_SIZE);
-            m_buf->pop_space(sprintf(head, "*%d\r\n", n - index + 1));
+            if (lua_type(L, index) == LUA_TTABLE) {
+                uint32_t count = (uint32_t)lua_rawlen(L, index);
+                for (uint32_t i = 1; i <= count; ++i) {
+                    lua_rawgeti(L, index, i);
+                    int cmd = lua_gettop(L);
+                    int argc = (int)lua_rawlen(L, cmd);
+                    encode_head('*', argc);
+                    for (int j = 1; j <= argc; ++j) {
+                        lua_rawgeti(L, cmd, j);
+                        encode_bulk_string(L, lua_gettop(L));
+                        lua_pop(L, 1);
+                    }
+                    lua_pop(L, 1);
+                }
+                if (count > 0) sessions.push_back(redis_cmd{ session_id, count });
+                return m_buf->data(len);
+            }
+            encode_head('*', n - index + 1);
             for (int i = index; i <= n; ++i) {
                 encode_bulk_string(L, i);
             }
-            sessions.push_back(session_id);
+            sessions.push_back(redis_cmd{ session_id, 0 });
             return m_buf->data(len);
         }
 
+        //返回(session_id, ok, res), 单条命令回复错误时ok为false, res为错误信息
+        //管线请求返回(session_id, true, res, oks), res为按命令顺序的结果列表, oks为对应命令是否成功
+        //出错的命令只影响自己在oks中的位置, res中对应位置为错误信息
         virtual size_t decode(lua_State* L) {
             int top = lua_gettop(L);
             size_t osize = m_slice->size();
             string_view buf = m_slice->contents();
-            lua_pushinteger(L, sessions.empty() ? 0 : sessions.front());
-            parse_redis_packet(L, buf);
-            if (!sessions.empty()) sessions.pop_front();
+            //RESP3的推送消息不对应任何请求
+            bool push = !buf.empty() && buf[0] == '>';
+            redis_cmd cmd = (push || sessions.empty()) ? redis_cmd{ 0, 0 } : sessions.front();
+            lua_pushinteger(L, cmd.session_id);
+            lua_pushboolean(L, true);
+            bool succ = true;
+            if (cmd.count > 0) {
+                lua_createtable(L, cmd.count, 1);
+                lua_createtable(L, cmd.count, 0);
+                for (uint32_t i = 1; i <= cmd.count; ++i) {
+                    lua_pushboolean(L, parse_redis_value(L, buf));
+                    lua_seti(L, -3, i);
+                    lua_seti(L, -3, i);
+                }
+                lua_pushinteger(L, cmd.count);
+                lua_setfield(L, -3, "n");
+            } else {
+                succ = parse_redis_value(L, buf);
+            }
+            if (!succ) {
+                lua_pushboolean(L, false);
+                lua_replace(L, top + 2);
+            }
+            if (!push && !sessions.empty()) sessions.pop_front();
             m_packet_len = osize - buf.size();
             m_slice->erase(m_packet_len);
             return lua_gettop(L) - top;
@@ -53,99 +164,112 @@ namespace lcodec {
         }
 
     protected:
-        void parse_redis_success(lua_State* L, string_view line) {
-            lua_pushboolean(L, true);
-            lua_pushlstring(L, line.data(), line.size());
-        }
-
-        void parse_redis_error(lua_State* L, string_view line) {
-            lua_pushboolean(L, false);
-            lua_pushlstring(L, line.data(), line.size());
-        }
-
-        void parse_redis_integer(lua_State* L, string_view line, bool rootable = false) {
-            if (rootable) lua_pushboolean(L, true);
-            lua_pushinteger(L, atoll(line.data()));
+        void parse_redis_string(lua_State* L, string_view line, string_view& buf, bool verbatim = false) {
+            int64_t length = atoll(line.data());
+            if (length < 0) {
+                lua_pushnil(L);
+                return;
+            }
+            //按长度读取,内容中可以包含\r\n
+            if (buf.size() < (size_t)length + CRLF_LEN)
+                throw length_error("redis text not full");
+            string_view nline = buf.substr(0, length);
+            buf.remove_prefix(length + CRLF_LEN);
+            if (verbatim) {
+                //去掉格式前缀, 如"txt:"
+                nline.remove_prefix(std::min<size_t>(nline.size(), 4));
+            } else if (!strncasecmp(nline.data(), "[js]", 4)) {
+                nline.remove_prefix(4);
+                m_jcodec->decode(L, (uint8_t*)nline.data(), nline.size());
+                return;
+            }
+            lua_pushlstring(L, nline.data(), nline.size());
         }
 
-        void parse_redis_string(lua_State* L, string_view line, string_view& buf, bool rootable = false) {
+        void parse_redis_array(lua_State* L, string_view line, string_view& buf) {
             int64_t length = atoll(line.data());
-            if (length >= 0) {
-                string_view nline;
-                if (!read_line(buf, nline))
-                    throw length_error("redis text not full");
-                if (!strncasecmp(nline.data(), "[js]", 4)) {
-                    nline.remove_prefix(4);
-                    m_jcodec->decode(L, (uint8_t*)nline.data(), nline.size());
-                } else {
-                    lua_pushlstring(L, nline.data(), nline.size());
-                }
-            }
-            else {
+            if (length < 0) {
                 lua_pushnil(L);
+                return;
             }
-            if (rootable) {
-                lua_pushboolean(L, true);
-                lua_insert(L, -2);
+            luaL_checkstack(L, 4, "redis array too deep");
+            lua_createtable(L, (int)length, 0);
+            for (int i = 1; i <= length; ++i) {
+                parse_redis_value(L, buf);
+                lua_seti(L, -2, i);
             }
         }
 
-        void parse_redis_array(lua_State* L, string_view line, string_view& buf, bool rootable = false) {
+        void parse_redis_map(lua_State* L, string_view line, string_view& buf) {
             int64_t length = atoll(line.data());
-            if (length >= 0) {
-                lua_createtable(L, 0, 4);
-                for (int i = 1; i <= length; ++i) {
-                    string_view line;
-                    if (!read_line(buf, line)) throw length_error("redis text not full");
-                    switch (line[0]) {
-                    case ':':
-                        parse_redis_integer(L, line.substr(1));
-                        break;
-                    case '$':
-                        parse_redis_string(L, line.substr(1), buf);
-                        break;
-                    case '*':
-                        parse_redis_array(L, line.substr(1), buf);
-                        break;
-                    default:
-                        throw invalid_argument("invalid redis format");
-                        break;
-                    }
-                    lua_seti(L, -2, i);
+            luaL_checkstack(L, 4, "redis map too deep");
+            lua_createtable(L, 0, (int)std::max<int64_t>(length, 0));
+            for (int i = 1; i <= length; ++i) {
+                parse_redis_value(L, buf);
+                parse_redis_value(L, buf);
+                if (lua_isnil(L, -2)) {
+                    lua_pop(L, 2);
+                    continue;
                 }
-            }
-            else {
-                lua_pushnil(L);
-            }
-            if (rootable) {
-                lua_pushboolean(L, true);
-                lua_insert(L, -2);
+                lua_rawset(L, -3);
             }
         }
 
-        void parse_redis_packet(lua_State* L, string_view& buf) {
+        //解析一个值并压栈,错误类型的回复返回false
+        bool parse_redis_value(lua_State* L, string_view& buf) {
             string_view line;
-            if (!read_line(buf, line)) throw length_error("redis text not full");
-            switch (line[0]) {
+            if (!read_line(buf, line) || line.empty()) throw length_error("redis text not full");
+            char type = line[0];
+            line.remove_prefix(1);
+            switch (type) {
             case '+':
-                parse_redis_success(L, line.substr(1));
+                lua_pushlstring(L, line.data(), line.size());
                 break;
             case '-':
-                parse_redis_error(L, line.substr(1));
-                break;
+                lua_pushlstring(L, line.data(), line.size());
+                return false;
             case ':':
-                parse_redis_integer(L, line.substr(1), true);
+                lua_pushinteger(L, atoll(line.data()));
                 break;
             case '$':
-                parse_redis_string(L, line.substr(1), buf, true);
+                parse_redis_string(L, line, buf);
                 break;
             case '*':
-                parse_redis_array(L, line.substr(1), buf, true);
+            case '~':
+            case '>':
+                parse_redis_array(L, line, buf);
+                break;
+            case '_':
+                lua_pushnil(L);
                 break;
+            case '#':
+                lua_pushboolean(L, !line.empty() && line[0] == 't');
+                break;
+            case ',':
+                lua_pushnumber(L, strtod(line.data(), nullptr));
+                break;
+            case '(':
+                //大数超出int64,以字符串返回
+                lua_pushlstring(L, line.data(), line.size());
+                break;
+            case '!':
+                parse_redis_string(L, line, buf);
+                return false;
+            case '=':
+                parse_redis_string(L, line, buf, true);
+                break;
+            case '%':
+                parse_redis_map(L, line, buf);
+                break;
+            case '|':
+                //属性只是附加信息,解析后丢弃,返回其后的回复
+                parse_redis_map(L, line, buf);
+                lua_pop(L, 1);
+                return parse_redis_value(L, buf);
             default:
                 throw invalid_argument("invalid redis format");
-                break;
             }
+            return true;
         }
 
         bool read_line(string_view& buf, string_view& line) {
@@ -158,30 +282,56 @@ namespace lcodec {
             return false;
         }
 
+        //直接写入长度头,不经过格式化
+        void encode_head(char type, size_t len) {
+            char* head = (char*)m_buf->peek_space(HEAD_SIZE);
+            if (!head) return;
+            char* pos = head;
+            *pos++ = type;
+            pos = to_chars(pos, head + HEAD_SIZE, len).ptr;
+            *pos++ = '\r';
+            *pos++ = '\n';
+            m_buf->pop_space(pos - head);
+        }
+
+        void encode_bulk(const char* data, size_t len, string_view prefix = "") {
+            size_t blen = prefix.size() + len;
+            char* head = (char*)m_buf->peek_space(HEAD_SIZE + blen);
+            if (!head) return;
+            char* pos = head;
+            *pos++ = '$';
+            pos = to_chars(pos, head + HEAD_SIZE, blen).ptr;
+            *pos++ = '\r';
+            *pos++ = '\n';
+            memcpy(pos, prefix.data(), prefix.size());
+            memcpy(pos + prefix.size(), data, len);
+            pos += blen;
+            *pos++ = '\r';
+            *pos++ = '\n';
+            m_buf->pop_space(pos - head);
+        }
+
         void number_encode(double value) {
             auto svalue = std::to_string(value);
-            char* head = (char*)m_buf->peek_space(HEAD_SIZE + svalue.size());
-            m_buf->pop_space(sprintf(head, "$%zd\r\n%s\r\n", svalue.size(), svalue.c_str()));
+            encode_bulk(svalue.data(), svalue.size());
         }
 
         void integer_encode(int64_t integer) {
-            auto svalue = std::to_string(integer);
-            char* head = (char*)m_buf->peek_space(HEAD_SIZE + svalue.size());
-            m_buf->pop_space(sprintf(head, "$%zd\r\n%s\r\n", svalue.size(), svalue.c_str()));
+            char value[32];
+            char* end = to_chars(value, value + sizeof(value), integer).ptr;
+            encode_bulk(value, end - value);
         }
 
         void string_encode(lua_State* L, int idx) {
             size_t len;
             const char* data = lua_tolstring(L, idx, &len);
-            char* head = (char*)m_buf->peek_space(HEAD_SIZE + len);
-            m_buf->pop_space(sprintf(head, "$%zd\r\n%s\r\n", len, data));
+            encode_bulk(data, len);
         }
 
         void table_encode(lua_State* L, int idx) {
             size_t len;
             char* body = (char*)m_jcodec->encode(L, idx, &len);
-            char* head = (char*)m_buf->peek_space(HEAD_SIZE + len);
-            m_buf->pop_space(sprintf(head, "$%zd\r\n[js]%s\r\n", len + 4, body));
+            encode_bulk(body, len, "[js]");
         }
 
         void encode_bulk_string(lua_State* L, int idx) {
@@ -191,7 +341,7 @@ namespace lcodec {
                 string_encode(L, idx);
                 break;
             case LUA_TBOOLEAN: 
-                integer_encode(lua_tointeger(L, idx));
+                integer_encode(lua_toboolean(L, idx));
                 break;
             case LUA_TNUMBER:
                 lua_isinteger(L, idx) ? integer_encode(lua_tointeger(L, idx)) : number_encode(lua_tonumber(L, idx));
@@ -206,7 +356,7 @@ namespace lcodec {
         }
 
     protected:
-        deque<uint32_t> sessions;
+        deque<redis_cmd> sessions;
         codec_base* m_jcodec = nullptr;
     };
 }
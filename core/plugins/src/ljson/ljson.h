@@ -128,6 +128,7 @@ namespace ljson {
 
         yyjson_mut_val* table_encode(lua_State* L, yyjson_mut_doc* doc, bool emy_as_arr, int index, int depth) {
             index = lua_absindex(L, index);
+            lazy_table_load(L, index);
             if (!is_array(L, index, emy_as_arr)) {
                 lua_pushnil(L);
                 yyjson_mut_val* object = yyjson_mut_obj(doc);
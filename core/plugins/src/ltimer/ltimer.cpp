@@ -24,6 +24,7 @@ namespace ltimer {
 	public:
 		integer_vector update(size_t elapse);
 		void insert(uint64_t timer_id, size_t escape);
+		size_t next_expire();
 
 	protected:
 		void shift();
@@ -106,6 +107,15 @@ namespace ltimer {
 		return timers;
 	}
 
+	//距离下一个到期定时器的tick数, near里没有时返回到near末尾的距离(届时上层会移入)
+	size_t lua_timer::next_expire() {
+		size_t cur = time & TIME_NEAR_MASK;
+		for (size_t idx = cur; idx < TIME_NEAR; ++idx) {
+			if (!near[idx].empty()) return idx - cur;
+		}
+		return TIME_NEAR - cur;
+	}
+
 	static int cron_next(lua_State* L, std::string cex) {
 		try {
 			auto result = cron::cron_next(cron::make_cron(cex), (time_t)now());
@@ -127,6 +137,10 @@ namespace ltimer {
 		return thread_timer.update(elapse);
 	}
 
+	static size_t timer_next_expire() {
+		return thread_timer.next_expire();
+	}
+
 	static int timer_time(lua_State* L) {
 		return luakit::variadic_return(L, now_ms(), steady_ms());
 	}
@@ -137,6 +151,7 @@ namespace ltimer {
 		luatimer.set_function("time", timer_time);
 		luatimer.set_function("insert", timer_insert);
 		luatimer.set_function("update", timer_update);
+		luatimer.set_function("next_expire", timer_next_expire);
 		luatimer.set_function("now", []() { return now(); });
 		luatimer.set_function("now_ms", []() { return now_ms(); });
 		luatimer.set_function("clock", []() { return steady(); });
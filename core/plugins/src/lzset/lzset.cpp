@@ -165,6 +165,75 @@ static int lrange(lua_State* L)
 	return 1;
 };
 
+//批量查询结果: keys, scores两个数组和第一个元素的排名, 没有结果时不返回
+template<typename Range>
+static int push_range(lua_State* L, int narr, const Range& range)
+{
+	lua_createtable(L, narr, 0);
+	lua_createtable(L, narr, 0);
+	lua_Integer idx = 0;
+	size_t rank = range([L, &idx](int64_t key, int64_t score) {
+		++idx;
+		lua_pushinteger(L, key);
+		lua_rawseti(L, -3, idx);
+		lua_pushinteger(L, score);
+		lua_rawseti(L, -2, idx);
+	});
+	if (idx == 0)
+	{
+		lua_pop(L, 2);
+		return 0;
+	}
+	lua_pushinteger(L, (lua_Integer)rank);
+	return 3;
+}
+
+//从排名start开始的count个
+static int lrange_by_rank(lua_State* L)
+{
+	zset_type* zset = (zset_type*)lua_touserdata(L, 1);
+	if (nullptr == zset)
+		return luaL_argerror(L, 1, "invalid lua-zset pointer");
+	int64_t start = std::max<int64_t>(luaL_checkinteger(L, 2), 1);
+	int64_t count = luaL_checkinteger(L, 3);
+	if (count <= 0)
+		return 0;
+	int narr = (int)std::min<int64_t>(count, (int64_t)zset->size());
+	return push_range(L, narr, [&](const auto& handler) {
+		zset->range_by_rank((size_t)start, (size_t)count, handler);
+		return (size_t)start;
+	});
+}
+
+//分数在[min, max]内的, 最多limit个
+static int lrange_by_score(lua_State* L)
+{
+	zset_type* zset = (zset_type*)lua_touserdata(L, 1);
+	if (nullptr == zset)
+		return luaL_argerror(L, 1, "invalid lua-zset pointer");
+	int64_t min = luaL_checkinteger(L, 2);
+	int64_t max = luaL_checkinteger(L, 3);
+	int64_t limit = std::max<int64_t>(luaL_optinteger(L, 4, 0), 0);
+	int narr = (int)std::min<int64_t>(limit, (int64_t)zset->size());
+	return push_range(L, narr, [&](const auto& handler) {
+		return zset->range_by_score(min, max, (size_t)limit, handler);
+	});
+}
+
+//key前后各n个
+static int laround_key(lua_State* L)
+{
+	zset_type* zset = (zset_type*)lua_touserdata(L, 1);
+	if (nullptr == zset)
+		return luaL_argerror(L, 1, "invalid lua-zset pointer");
+	int64_t key = luaL_checkinteger(L, 2);
+	int64_t n = std::clamp<int64_t>(luaL_checkinteger(L, 3), 0, (int64_t)zset->size());
+	int narr = (int)std::min<int64_t>(n * 2 + 1, (int64_t)zset->size());
+	return push_range(L, narr, [&](const auto& handler) {
+		return zset->around_key(key, (size_t)n, handler);
+	});
+}
+
 static int lrelease(lua_State* L)
 {
 	zset_type* zset = (zset_type*)lua_touserdata(L, 1);
@@ -188,6 +257,9 @@ static int lcreate(lua_State* L)
 			{ "rank", lrank},
 			{ "key_by_rank", lkey_by_rank},
 			{ "range", lrange},
+			{ "range_by_rank", lrange_by_rank},
+			{ "range_by_score", lrange_by_score},
+			{ "around_key", laround_key},
 			{ "clear", lclear},
 			{ "size", lsize},
 			{ "erase", lerase},
@@ -316,6 +316,47 @@ namespace lzset
 			return 0;
 		}
 
+		/* Find an element and its 1-based rank in one pass.
+		 * Returns an end iterator and sets rank to 0 when not found. */
+		const_iterator find(const score_type& score, size_t& rank) const
+		{
+			node_type* x = header_;
+			rank = 0;
+			for (int i = level_ - 1; i >= 0; i--)
+			{
+				while (x->level[i].forward && x->level[i].forward->score <= score)
+				{
+					rank += x->level[i].span;
+					x = x->level[i].forward;
+				}
+				if (x != header_ && x->score == score)
+				{
+					return const_iterator{ x };
+				}
+			}
+			rank = 0;
+			return const_iterator{ nullptr };
+		}
+
+		/* Skip every element matching 'before' (which must hold for a prefix
+		 * of the list) and return the first remaining one with its 1-based rank. */
+		template<typename Pred>
+		const_iterator lower_bound(const Pred& before, size_t& rank) const
+		{
+			node_type* x = header_;
+			rank = 0;
+			for (int i = level_ - 1; i >= 0; i--)
+			{
+				while (x->level[i].forward && before(x->level[i].forward->score))
+				{
+					rank += x->level[i].span;
+					x = x->level[i].forward;
+				}
+			}
+			rank += 1;
+			return const_iterator{ x->level[0].forward };
+		}
+
 		/* Finds an element by its rank. The rank argument needs to be 1-based. */
 		const_iterator find_by_rank(size_t rank) const
 		{
@@ -508,6 +549,85 @@ namespace lzset
 			return 0;
 		}
 
+		int64_t score(const_iterator it) const
+		{
+			return reverse_ ? -it->score : it->score;
+		}
+
+		//从排名start开始顺序遍历count个, handler(key, score), 返回实际个数
+		template<typename Handler>
+		size_t range_by_rank(size_t start, size_t count, const Handler& handler) const
+		{
+			if (start == 0 || start > zsl_.size())
+			{
+				return 0;
+			}
+			size_t n = 0;
+			for (auto it = zsl_.find_by_rank(start); it != zsl_.end() && n < count; ++it, ++n)
+			{
+				handler(it->key, score(it));
+			}
+			return n;
+		}
+
+		//按排名顺序遍历分数在[min, max]内的节点, limit为0时不限数量, 返回第一个节点的排名
+		template<typename Handler>
+		size_t range_by_score(int64_t min, int64_t max, size_t limit, const Handler& handler) const
+		{
+			if (min > max)
+			{
+				return 0;
+			}
+			//跳表按内部分数降序排列, reverse时内部分数取反
+			if (reverse_)
+			{
+				//取反前限制范围, mininteger取反会溢出
+				constexpr int64_t lowest = std::numeric_limits<int64_t>::min() + 1;
+				if (max < lowest)
+				{
+					return 0;
+				}
+				min = min < lowest ? lowest : min;
+			}
+			int64_t high = reverse_ ? -min : max;
+			int64_t low = reverse_ ? -max : min;
+			size_t rank = 0, n = 0;
+			auto it = zsl_.lower_bound([high](const context& c) { return c.score > high; }, rank);
+			for (; it != zsl_.end() && it->score >= low && (limit == 0 || n < limit); ++it, ++n)
+			{
+				handler(it->key, score(it));
+			}
+			return n > 0 ? rank : 0;
+		}
+
+		//遍历key前后各n个节点(包含key), 返回第一个节点的排名, key不存在返回0
+		template<typename Handler>
+		size_t around_key(int64_t key, size_t n, const Handler& handler) const
+		{
+			auto iter = dict_.find(key);
+			if (iter == dict_.end())
+			{
+				return 0;
+			}
+			size_t rank = 0;
+			auto it = zsl_.find(*iter->second, rank);
+			if (!(it != zsl_.end()))
+			{
+				return 0;
+			}
+			//从key的节点向前回退, 不需要再从头查找
+			size_t before = 0;
+			for (; before < n && before + 1 < rank; ++before)
+			{
+				--it;
+			}
+			for (size_t i = 0; it != zsl_.end() && i <= before + n; ++it, ++i)
+			{
+				handler(it->key, score(it));
+			}
+			return rank - before;
+		}
+
 		bool has(int64_t key) const
 		{
 			return (dict_.find(key) != dict_.end());
@@ -19,6 +19,7 @@ namespace luakit {
             m_end = m_data + BUFFER_DEF;
             m_head = m_tail = m_data;
             m_size = BUFFER_DEF;
+            m_overflow = false;
         }
 
         size_t size() {
@@ -29,6 +30,24 @@ namespace luakit {
             return m_size;
         }
 
+        //扩容上限,默认BUFFER_MAX
+        void set_limit(size_t limit) {
+            m_limit = limit;
+        }
+
+        size_t get_limit() {
+            return m_limit;
+        }
+
+        //clean以来是否有写入因超过上限被丢弃
+        bool overflow() {
+            return m_overflow;
+        }
+
+        size_t space() {
+            return m_end - m_tail;
+        }
+
         size_t empty() {
             return m_tail == m_head;
         }
@@ -43,6 +62,7 @@ namespace luakit {
                 _resize(m_size / 2);
             }
             m_head = m_tail = m_data;
+            m_overflow = false;
         }
 
         size_t copy(size_t offset, const uint8_t* src, size_t src_len) {
@@ -119,11 +139,13 @@ namespace luakit {
                     while (nsize - data_len < len) {
                         nsize *= 2;
                     }
-                    if (nsize >= BUFFER_MAX) {
+                    if (nsize >= m_limit) {
+                        m_overflow = true;
                         return nullptr;
                     }
                     space_len = _resize(nsize);
                     if (space_len < len) {
+                        m_overflow = true;
                         return nullptr;
                     }
                 }
@@ -183,7 +205,7 @@ namespace luakit {
         //重新设置长度
         size_t _resize(size_t size) {
             size_t data_len = (size_t)(m_tail - m_head);
-            if (m_size == size || size < data_len || size > BUFFER_MAX) {
+            if (m_size == size || size < data_len || size > m_limit) {
                 return m_end - m_tail;
             }
             m_data = (uint8_t*)realloc(m_data, size);
@@ -204,6 +226,8 @@ namespace luakit {
 
     private:
         size_t m_max;
+        size_t m_limit = BUFFER_MAX;
+        bool m_overflow = false;
         size_t m_size;
         uint8_t* m_head;
         uint8_t* m_tail;
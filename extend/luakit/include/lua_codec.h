@@ -4,7 +4,10 @@
 #pragma warning(disable: 4267)
 #endif
 
+#include <vector>
+#include <algorithm>
 #include <stdexcept>
+#include <string_view>
 
 #include "lua_buff.h"
 
@@ -20,13 +23,76 @@ namespace luakit {
     const uint8_t type_int64        = 8;
     const uint8_t type_string       = 9;
     const uint8_t type_undefine     = 10;
-    const uint8_t type_max          = 11;
+    const uint8_t type_array        = 11;
+    const uint8_t type_long_string  = 12;
+    const uint8_t type_string_ref   = 13;
+    const uint8_t type_varint       = 14;
+    const uint8_t type_int_array    = 15;
+    const uint8_t type_max          = 16;
+
+    //编码格式版本, 类型字节或小整数偏移(type_max)变化后与旧格式不兼容, 新旧节点需要同时升级
+    //0: type_max为11
+    //1: 增加array/long_string/string_ref/varint/int_array, type_max为16, 小整数上限由244降为239
+    const uint8_t codec_version     = 1;
 
     const uint8_t max_encode_depth  = 16;
     const uint8_t max_uint8         = UCHAR_MAX - type_max;
+    const uint8_t max_string_ref    = UCHAR_MAX;
+    const size_t  max_short_string  = 40;
+    const size_t  min_int_array     = 16;
 
-    int decode_one(lua_State* L, slice* slice);
-    void encode_one(lua_State* L, luabuf* buff, int idx, int depth);
+    //单条消息内的字符串复用: 重复出现的短字符串(通常是同构table的key)只写一次,之后只写序号
+    //lua的短字符串是内部化的,编码时直接按指针查找
+    class codec_ctx {
+    public:
+        void reset() {
+            for (uint8_t i = 0; i < m_count; ++i) {
+                m_slots[m_used[i]] = nullptr;
+            }
+            m_count = 0;
+        }
+
+        //返回已登记的序号,未登记时登记并返回-1
+        int intern(const char* str) {
+            size_t slot = ((size_t)str >> 4) & (slot_size - 1);
+            while (m_slots[slot]) {
+                if (m_slots[slot] == str) {
+                    return m_ids[slot];
+                }
+                slot = (slot + 1) & (slot_size - 1);
+            }
+            if (m_count < max_string_ref) {
+                m_slots[slot] = str;
+                m_ids[slot] = m_count;
+                m_used[m_count++] = (uint16_t)slot;
+            }
+            return -1;
+        }
+
+        void push(const char* str, size_t len) {
+            if (m_count < max_string_ref) {
+                m_strs[m_count++] = std::string_view(str, len);
+            }
+        }
+
+        std::string_view get(uint8_t index) {
+            if (index >= m_count) {
+                throw std::invalid_argument("decode string ref is out of range");
+            }
+            return m_strs[index];
+        }
+
+    private:
+        static const size_t slot_size = 512;
+        uint8_t m_count = 0;
+        uint16_t m_used[max_string_ref];
+        uint8_t m_ids[slot_size];
+        const char* m_slots[slot_size] = {};
+        std::string_view m_strs[max_string_ref];
+    };
+
+    int decode_one(lua_State* L, slice* slice, codec_ctx* ctx = nullptr);
+    void encode_one(lua_State* L, luabuf* buff, int idx, int depth, codec_ctx* ctx = nullptr);
     void serialize_one(lua_State* L, luabuf* buff, int index, int depth, int line);
 
     template<typename T>
@@ -66,13 +132,27 @@ namespace luakit {
         return cur_len == raw_len;
     }
 
-    inline void string_encode(lua_State* L, luabuf* buff, int index) {
+    inline void string_encode(lua_State* L, luabuf* buff, int index, codec_ctx* ctx = nullptr) {
         size_t sz = 0;
         const char* ptr = lua_tolstring(L, index, &sz);
-        if (sz > USHRT_MAX) {
+        if (sz > UINT_MAX) {
             luaL_error(L, "encode can't pack too long string");
             return;
         }
+        if (sz > USHRT_MAX) {
+            value_encode(buff, type_long_string);
+            value_encode<uint32_t>(buff, sz);
+            value_encode(buff, ptr, sz);
+            return;
+        }
+        if (ctx && sz > 0 && sz <= max_short_string) {
+            int ref = ctx->intern(ptr);
+            if (ref >= 0) {
+                value_encode(buff, type_string_ref);
+                value_encode<uint8_t>(buff, ref);
+                return;
+            }
+        }
         value_encode(buff, type_string);
         value_encode<uint16_t>(buff, sz);
         if (sz > 0) {
@@ -80,24 +160,105 @@ namespace luakit {
         }
     }
 
+    inline void varint_encode(luabuf* buff, uint64_t value) {
+        uint8_t* data = buff->peek_space(10);
+        if (data == nullptr) {
+            return;
+        }
+        size_t len = 0;
+        while (value >= 0x80) {
+            data[len++] = (uint8_t)value | 0x80;
+            value >>= 7;
+        }
+        data[len++] = (uint8_t)value;
+        buff->pop_space(len);
+    }
+
+    inline uint64_t varint_decode(lua_State* L, slice* slice) {
+        size_t len = 0;
+        uint8_t* data = slice->data(&len);
+        uint64_t value = 0;
+        for (size_t i = 0; i < len && i < 10; ++i) {
+            value |= (uint64_t)(data[i] & 0x7f) << (7 * i);
+            if (data[i] < 0x80) {
+                slice->erase(i + 1);
+                return value;
+            }
+        }
+        throw std::invalid_argument("decode varint is out of range");
+    }
+
+    inline uint64_t zigzag_encode(int64_t value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    }
+
+    inline int64_t zigzag_decode(uint64_t value) {
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    //小整数直接写在类型字节里,其余用zigzag变长编码
     inline void integer_encode(luabuf* buff, int64_t integer) {
         if (integer >= 0 && integer <= max_uint8) {
             integer += type_max;
             value_encode<uint8_t>(buff, integer);
             return;
         }
-        if (integer <= SHRT_MAX && integer >= SHRT_MIN) {
-            value_encode(buff, type_int16);
-            value_encode<int16_t>(buff, integer);
+        value_encode(buff, type_varint);
+        varint_encode(buff, zigzag_encode(integer));
+    }
+
+    template<typename T>
+    void int_array_pack(luabuf* buff, const int64_t* values, size_t count) {
+        T* target = (T*)buff->peek_space(count * sizeof(T));
+        if (target == nullptr) {
             return;
         }
-        if (integer <= INT_MAX && integer >= INT_MIN) {
-            value_encode(buff, type_int32);
-            value_encode<int32_t>(buff, integer);
-            return;
+        for (size_t i = 0; i < count; ++i) {
+            target[i] = (T)values[i];
+        }
+        buff->pop_space(count * sizeof(T));
+    }
+
+    //序列部分全是整数时按最大值选定宽度整体写出: 宽度,数量,定长数组
+    inline bool int_array_encode(lua_State* L, luabuf* buff, int index) {
+        size_t len = lua_rawlen(L, index);
+        if (len < min_int_array) {
+            return false;
+        }
+        thread_local std::vector<int64_t> values;
+        values.resize(len);
+        for (size_t i = 0; i < len; ++i) {
+            if (lua_rawgeti(L, index, i + 1) != LUA_TNUMBER || !lua_isinteger(L, -1)) {
+                lua_pop(L, 1);
+                return false;
+            }
+            values[i] = lua_tointeger(L, -1);
+            lua_pop(L, 1);
         }
-        value_encode(buff, type_int64);
-        value_encode(buff, integer);
+        int64_t vmin = values[0], vmax = values[0];
+        for (size_t i = 1; i < len; ++i) {
+            vmin = std::min(vmin, values[i]);
+            vmax = std::max(vmax, values[i]);
+        }
+        value_encode(buff, type_int_array);
+        if (vmin >= SCHAR_MIN && vmax <= SCHAR_MAX) {
+            value_encode<uint8_t>(buff, sizeof(int8_t));
+            varint_encode(buff, len);
+            int_array_pack<int8_t>(buff, values.data(), len);
+        } else if (vmin >= SHRT_MIN && vmax <= SHRT_MAX) {
+            value_encode<uint8_t>(buff, sizeof(int16_t));
+            varint_encode(buff, len);
+            int_array_pack<int16_t>(buff, values.data(), len);
+        } else if (vmin >= INT_MIN && vmax <= INT_MAX) {
+            value_encode<uint8_t>(buff, sizeof(int32_t));
+            varint_encode(buff, len);
+            int_array_pack<int32_t>(buff, values.data(), len);
+        } else {
+            value_encode<uint8_t>(buff, sizeof(int64_t));
+            varint_encode(buff, len);
+            int_array_pack<int64_t>(buff, values.data(), len);
+        }
+        return true;
     }
 
     inline void number_encode(luabuf* buff, double number) {
@@ -105,19 +266,65 @@ namespace luakit {
         value_encode(buff, number);
     }
 
-    inline void table_encode(lua_State* L, luabuf* buff, int index, int depth) {
+    //worker消息延迟解码的代理table: 元表[1]为带该元表的消息holder
+    static const char* LAZY_MSG_META = "_lazy_worker_msg";
+
+    inline bool is_lazy_table(lua_State* L, int index) {
+        if (!lua_getmetatable(L, index)) {
+            return false;
+        }
+        lua_rawgeti(L, -1, 1);
+        bool lazy = luaL_testudata(L, -1, LAZY_MSG_META) != nullptr;
+        lua_pop(L, 2);
+        return lazy;
+    }
+
+    //编码前就地还原代理table: __pairs解码全部字段并移除元表,嵌套的代理table遍历到时各自还原
+    inline void lazy_table_load(lua_State* L, int index) {
+        if (!is_lazy_table(L, index)) {
+            return;
+        }
+        index = lua_absindex(L, index);
+        luaL_getmetafield(L, index, "__pairs");
+        lua_pushvalue(L, index);
+        lua_call(L, 1, 3);
+        lua_pop(L, 3);
+    }
+
+    //数组部分按lua_rawgeti顺序写出: 1..rawlen只写值,数量写在前面,其余部分仍按key-value写出
+    inline void table_encode(lua_State* L, luabuf* buff, int index, int depth, codec_ctx* ctx = nullptr) {
         index = lua_absindex(L, index);
-        value_encode(buff, type_tab_head);
+        lazy_table_load(L, index);
+        lua_Integer len = std::min<lua_Integer>(lua_rawlen(L, index), UINT_MAX);
+        if (len == 0) {
+            value_encode(buff, type_tab_head);
+        } else if (!int_array_encode(L, buff, index)) {
+            value_encode(buff, type_array);
+            value_encode<uint32_t>(buff, (uint32_t)len);
+            for (lua_Integer i = 1; i <= len; ++i) {
+                lua_rawgeti(L, index, i);
+                encode_one(L, buff, -1, depth, ctx);
+                lua_pop(L, 1);
+            }
+        }
+        //数组部分已写出,遍历时跳过
         lua_pushnil(L);
         while (lua_next(L, index) != 0) {
-            encode_one(L, buff, -2, depth);
-            encode_one(L, buff, -1, depth);
+            if (lua_isinteger(L, -2)) {
+                lua_Integer key = lua_tointeger(L, -2);
+                if (key > 0 && key <= len) {
+                    lua_pop(L, 1);
+                    continue;
+                }
+            }
+            encode_one(L, buff, -2, depth, ctx);
+            encode_one(L, buff, -1, depth, ctx);
             lua_pop(L, 1);
         }
         value_encode(buff, type_tab_tail);
     }
 
-    inline void encode_one(lua_State* L, luabuf* buff, int idx, int depth) {
+    inline void encode_one(lua_State* L, luabuf* buff, int idx, int depth, codec_ctx* ctx) {
         if (depth > max_encode_depth) {
             luaL_error(L, "encode can't pack too depth table");
         }
@@ -127,10 +334,10 @@ namespace luakit {
             value_encode(buff, type_nil);
             break;
         case LUA_TSTRING:
-            string_encode(L, buff, idx);
+            string_encode(L, buff, idx, ctx);
             break;
         case LUA_TTABLE:
-            table_encode(L, buff, idx, depth + 1);
+            table_encode(L, buff, idx, depth + 1, ctx);
             break;
         case LUA_TBOOLEAN:
             lua_toboolean(L, idx) ? value_encode(buff, type_true) : value_encode(buff, type_false);
@@ -145,10 +352,12 @@ namespace luakit {
     }
 
     inline slice* encode_slice(lua_State* L, luabuf* buff) {
+        thread_local codec_ctx ctx;
+        ctx.reset();
         buff->clean();
         int n = lua_gettop(L);
         for (int i = 1; i <= n; i++) {
-            encode_one(L, buff, i, 0);
+            encode_one(L, buff, i, 0, &ctx);
         }
         return buff->get_slice();
     }
@@ -161,31 +370,90 @@ namespace luakit {
         return 1;
     }
 
-    inline void string_decode(lua_State* L, uint16_t sz, slice* slice) {
+    inline void string_decode(lua_State* L, size_t sz, slice* slice, codec_ctx* ctx = nullptr) {
         if (sz == 0) {
             lua_pushstring(L, "");
             return;
         }
         auto str = (const char*)slice->peek(sz);
-        if (str == nullptr || sz > USHRT_MAX) {
+        if (str == nullptr) {
             throw std::invalid_argument("decode string is out of range");
         }
         slice->erase(sz);
+        if (ctx && sz <= max_short_string) {
+            ctx->push(str, sz);
+        }
         lua_pushlstring(L, str, sz);
     }
 
-    inline void table_decode(lua_State* L, slice* slice) {
-        lua_createtable(L, 0, 8);
+    inline void string_ref_decode(lua_State* L, slice* slice, codec_ctx* ctx) {
+        if (ctx == nullptr) {
+            throw std::invalid_argument("decode string ref without context");
+        }
+        auto str = ctx->get(value_decode<uint8_t>(L, slice));
+        lua_pushlstring(L, str.data(), str.size());
+    }
+
+    inline void table_decode(lua_State* L, slice* slice, codec_ctx* ctx, uint32_t len = 0) {
+        lua_createtable(L, len, len > 0 ? 0 : 8);
+        for (uint32_t i = 1; i <= len; ++i) {
+            decode_one(L, slice, ctx);
+            lua_rawseti(L, -2, i);
+        }
         do {
-            if (decode_one(L, slice) == type_tab_tail) {
+            if (decode_one(L, slice, ctx) == type_tab_tail) {
                 break;
             }
-            decode_one(L, slice);
+            decode_one(L, slice, ctx);
             lua_rawset(L, -3);
         } while (1);
     }
 
-    inline void decode_value(lua_State* L, slice* slice, uint8_t type) {
+    inline void array_decode(lua_State* L, slice* slice, codec_ctx* ctx) {
+        uint32_t len = value_decode<uint32_t>(L, slice);
+        //每个值至少一个字节
+        if (len > slice->size()) {
+            throw std::invalid_argument("decode array is out of range");
+        }
+        table_decode(L, slice, ctx, len);
+    }
+
+    template<typename T>
+    void int_array_unpack(lua_State* L, slice* slice, size_t count) {
+        const T* values = (const T*)slice->erase(count * sizeof(T));
+        if (values == nullptr) {
+            throw std::invalid_argument("decode int array is out of range");
+        }
+        for (size_t i = 0; i < count; ++i) {
+            lua_pushinteger(L, values[i]);
+            lua_rawseti(L, -2, i + 1);
+        }
+    }
+
+    inline void int_array_decode(lua_State* L, slice* slice, codec_ctx* ctx) {
+        uint8_t width = value_decode<uint8_t>(L, slice);
+        uint64_t count = varint_decode(L, slice);
+        if (count > slice->size()) {
+            throw std::invalid_argument("decode int array is out of range");
+        }
+        lua_createtable(L, count, 0);
+        switch (width) {
+        case sizeof(int8_t): int_array_unpack<int8_t>(L, slice, count); break;
+        case sizeof(int16_t): int_array_unpack<int16_t>(L, slice, count); break;
+        case sizeof(int32_t): int_array_unpack<int32_t>(L, slice, count); break;
+        case sizeof(int64_t): int_array_unpack<int64_t>(L, slice, count); break;
+        default: throw std::invalid_argument("decode int array width is invalid");
+        }
+        do {
+            if (decode_one(L, slice, ctx) == type_tab_tail) {
+                break;
+            }
+            decode_one(L, slice, ctx);
+            lua_rawset(L, -3);
+        } while (1);
+    }
+
+    inline void decode_value(lua_State* L, slice* slice, uint8_t type, codec_ctx* ctx = nullptr) {
         switch (type) {
         case type_nil:
             lua_pushnil(L);
@@ -200,10 +468,25 @@ namespace luakit {
             lua_pushnumber(L, value_decode<double>(L, slice));
             break;
         case type_string:
-            string_decode(L, value_decode<uint16_t>(L, slice), slice);
+            string_decode(L, value_decode<uint16_t>(L, slice), slice, ctx);
+            break;
+        case type_long_string:
+            string_decode(L, value_decode<uint32_t>(L, slice), slice);
+            break;
+        case type_string_ref:
+            string_ref_decode(L, slice, ctx);
             break;
         case type_tab_head:
-            table_decode(L, slice);
+            table_decode(L, slice, ctx);
+            break;
+        case type_array:
+            array_decode(L, slice, ctx);
+            break;
+        case type_int_array:
+            int_array_decode(L, slice, ctx);
+            break;
+        case type_varint:
+            lua_pushinteger(L, zigzag_decode(varint_decode(L, slice)));
             break;
         case type_tab_tail:
             break;
@@ -225,19 +508,21 @@ namespace luakit {
         }
     }
 
-    inline int decode_one(lua_State* L, slice* slice) {
+    inline int decode_one(lua_State* L, slice* slice, codec_ctx* ctx) {
         uint8_t type = value_decode<uint8_t>(L, slice);
-        decode_value(L, slice, type);
+        decode_value(L, slice, type, ctx);
         return type;
     }
 
     inline int decode_slice(lua_State* L, slice* slice) {
+        thread_local codec_ctx ctx;
+        ctx.reset();
         int top = lua_gettop(L);
         try {
             while (1) {
                 uint8_t* type = slice->read();
                 if (type == nullptr) break;
-                decode_value(L, slice, *type);
+                decode_value(L, slice, *type, &ctx);
             }
         } catch (const std::exception& e){
             luaL_error(L, e.what());
@@ -425,6 +710,15 @@ namespace luakit {
         return 2;
     }
 
+    //文本协议分段到达时的扫描进度,由连接持有,load_packet从上次停下的位置继续
+    struct packet_state {
+        size_t offset = 0;      //已扫描的字节数
+        size_t expect = 0;      //还需要的字节数
+        int64_t pending = 0;    //还需要的元素数
+        uint8_t phase = 0;      //解析阶段,由codec定义
+        void reset() { offset = expect = 0; pending = 0; phase = 0; }
+    };
+
     class codec_base {
     public:
         virtual ~codec_base(){}
@@ -450,6 +744,7 @@ namespace luakit {
         virtual const char* err() { return m_err.c_str(); }
         virtual size_t get_packet_len() { return m_packet_len; }
         virtual void set_buff(luabuf* buf) { m_buf = buf; }
+        virtual void set_state(packet_state* state) { m_state = state ? state : &m_local_state; }
 
     protected:
         bool m_failed = false;
@@ -457,6 +752,8 @@ namespace luakit {
         slice* m_slice = nullptr;
         size_t m_packet_len = 0;
         std::string m_err = "";
+        packet_state m_local_state;
+        packet_state* m_state = &m_local_state;
     };
 
     class luacodec : public codec_base {
@@ -472,11 +769,16 @@ namespace luakit {
             return m_packet_len;
         }
 
+        //关闭后不复用字符串,编码结果的每个值可以单独解码
+        void set_intern(bool intern) { m_intern = intern; }
+
         virtual uint8_t* encode(lua_State* L, int index, size_t* len) {
             m_buf->clean();
+            m_ctx.reset();
             int n = lua_gettop(L);
+            codec_ctx* ctx = m_intern ? &m_ctx : nullptr;
             for (int i = index; i <= n; i++) {
-                encode_one(L, m_buf, i, 0);
+                encode_one(L, m_buf, i, 0, ctx);
             }
             return m_buf->data(len);
         }
@@ -484,14 +786,19 @@ namespace luakit {
         virtual size_t decode(lua_State* L) {
             if (!m_slice) return 0;
             int top = lua_gettop(L);
+            m_ctx.reset();
             while (1) {
                 uint8_t* type = m_slice->read();
                 if (type == nullptr) break;
-                decode_value(L, m_slice, *type);
+                decode_value(L, m_slice, *type, &m_ctx);
             }
             size_t argnum = lua_gettop(L) - top;
             m_slice = nullptr;
             return argnum;
         }
+
+    protected:
+        bool m_intern = true;
+        codec_ctx m_ctx;
     };
 }
@@ -129,6 +129,11 @@ function service.hash(service_id)
     return SERVICE_HASHS[service_id]
 end
 
+--服务hash模式(0:取模,1:一致性hash)
+function service.hash_mode(service_id)
+    return SERVICE_CONFS[service_id].hash_mode or 0
+end
+
 --唯一ip限制
 function service.sole_ip(service_id)
     return SERVICE_CONFS[service_id].sole_ip
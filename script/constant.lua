@@ -38,6 +38,12 @@ FlagMask.RES                      = 0x02  -- 响应
 FlagMask.ENCRYPT                  = 0x04  -- 开启加密
 FlagMask.ZIP                      = 0x08  -- 开启zip压缩
 
+--线程池派发方式
+local DispatchMode                = enum("DispatchMode", 0)
+DispatchMode.HASH                 = 0     --按key派发,同一key有序
+DispatchMode.ROUND                = 1     --轮询
+DispatchMode.IDLE                 = 2     --积压最少的线程
+
 --网络时间常量定义
 local NetwkTime                   = enum("NetwkTime", 0)
 NetwkTime.CONNECT_TIMEOUT         = 3000      --连接等待时间
@@ -1,5 +1,6 @@
 --mongo.lua
 local Socket        = import("driver/socket.lua")
+local MongoCursor   = import("driver/mongo_cursor.lua")
 local log_warn      = logger.warn
 local log_err       = logger.err
 local log_info      = logger.info
@@ -14,6 +15,7 @@ local ssub          = string.sub
 local sgsub         = string.gsub
 local sformat       = string.format
 local sgmatch       = string.gmatch
+local lbencode      = bson.encode
 local mtointeger    = math.tointeger
 local lmd5          = crypt.md5
 local lsha1         = crypt.sha1
@@ -35,6 +37,14 @@ local SECOND_MS     = hive.enum("PeriodTime", "SECOND_MS")
 local SECOND_10_MS  = hive.enum("PeriodTime", "SECOND_10_MS")
 local DB_TIMEOUT    = hive.enum("NetwkTime", "DB_CALL_TIMEOUT")
 local POOL_COUNT    = environ.number("HIVE_DB_POOL_COUNT", 3)
+--请求标记: 回复中的游标批次由mgocodec保留原始字节, 按需解码
+local LAZY_CURSOR   = 0x100000000
+--请求标记: 最后两个参数作为OP_MSG文档序列发送
+local DOC_SEQUENCE  = 0x200000000
+--批量写每个请求的文档数
+local BULK_SIZE     = environ.number("HIVE_MONGO_BULK_SIZE", 1000)
+--批量写每个请求的文档字节数, 编码缓冲上限为16M
+local BULK_BYTES    = environ.number("HIVE_MONGO_BULK_BYTES", 4 * 1024 * 1024)
 
 local MongoDB       = class()
 local prop          = property(MongoDB)
@@ -286,16 +296,16 @@ function MongoDB:on_socket_recv(sock, session_id, result)
     if session_id > 0 then
         self.res_counter:count_increase()
         local succ, doc = self:decode_reply(result)
-        thread_mgr:response(session_id, succ, doc)
+        thread_mgr:response(session_id, succ, doc, result)
     end
 end
 
-function MongoDB:op_msg(sock, session_id, cmd, ...)
+function MongoDB:op_msg(sock, session_id, flag, cmd, ...)
     if not sock then
         return false, "db not connected"
     end
     local tick = lclock_ms()
-    if not sock:send_data(session_id, cmd, ...) then
+    if not sock:send_data(session_id | flag, cmd, ...) then
         return false, "send failed"
     end
     sock.sessions[session_id] = cmd
@@ -312,18 +322,86 @@ end
 
 function MongoDB:adminCommand(sock, cmd, cmd_v, ...)
     local session_id = thread_mgr:build_session_id()
-    return self:op_msg(sock, session_id, cmd, cmd_v, "$db", "admin", ...)
+    return self:op_msg(sock, session_id, 0, cmd, cmd_v, "$db", "admin", ...)
 end
 
 function MongoDB:runCommand(cmd, cmd_v, ...)
     local session_id = thread_mgr:build_session_id()
-    return self:op_msg(self.executer, session_id, cmd, cmd_v or 1, "$db", self.name, ...)
+    return self:op_msg(self.executer, session_id, 0, cmd, cmd_v or 1, "$db", self.name, ...)
+end
+
+function MongoDB:cursorCommand(sock, cmd, cmd_v, ...)
+    local session_id = thread_mgr:build_session_id()
+    return self:op_msg(sock, session_id, LAZY_CURSOR, cmd, cmd_v, "$db", self.name, ...)
 end
 
 function MongoDB:sendCommand(cmd, cmd_v, ...)
     self.executer:send_data(0, cmd, cmd_v or 1, "$db", self.name, "writeConcern", { w = 0 }, ...)
 end
 
+function MongoDB:sequenceCommand(cmd, cmd_v, ...)
+    local session_id = thread_mgr:build_session_id()
+    return self:op_msg(self.executer, session_id, DOC_SEQUENCE, cmd, cmd_v, "$db", self.name, ...)
+end
+
+--批量写: ordered=false, 文档以OP_MSG文档序列发送, 按BULK_SIZE和BULK_BYTES分批
+--返回: 是否全部成功, 每个文档的结果(true或错误信息)
+function MongoDB:bulk_write(cmd, co_name, key, docs)
+    local all_ok, results = true, {}
+    local batch, indexs, bytes = {}, {}, 0
+    for i, doc in ipairs(docs) do
+        --先编码以统计字节数, 编码失败(如超过缓冲上限)的文档单独返回错误
+        local ok, data = pcall(lbencode, doc)
+        if not ok then
+            all_ok = false
+            results[i] = data
+        else
+            if #batch >= BULK_SIZE or (#batch > 0 and bytes + #data > BULK_BYTES) then
+                all_ok = self:bulk_batch(cmd, co_name, key, batch, indexs, results) and all_ok
+                batch, indexs, bytes = {}, {}, 0
+            end
+            batch[#batch + 1] = data
+            indexs[#indexs + 1] = i
+            bytes = bytes + #data
+        end
+    end
+    if #batch > 0 then
+        all_ok = self:bulk_batch(cmd, co_name, key, batch, indexs, results) and all_ok
+    end
+    return all_ok, results
+end
+
+--发送一批已编码的文档, indexs为文档在原列表中的序号
+function MongoDB:bulk_batch(cmd, co_name, key, batch, indexs, results)
+    local succ, err, reply = self:sequenceCommand(cmd, co_name, "ordered", false, key, batch)
+    if type(reply) ~= "table" or reply.ok ~= 1 or reply.writeConcernError then
+        --整批失败
+        for _, index in ipairs(indexs) do
+            results[index] = err
+        end
+        return false
+    end
+    for _, index in ipairs(indexs) do
+        results[index] = true
+    end
+    if not succ then
+        for _, werr in ipairs(reply.writeErrors or {}) do
+            results[indexs[werr.index + 1]] = werr.errmsg
+        end
+        return false
+    end
+    return true
+end
+
+-- updates={{q=selector,u=update,upsert=true,multi=false}, }
+function MongoDB:bulk_update(co_name, updates)
+    return self:bulk_write("update", co_name, "updates", updates)
+end
+
+function MongoDB:bulk_insert(co_name, docs)
+    return self:bulk_write("insert", co_name, "documents", docs)
+end
+
 function MongoDB:drop_collection(co_name)
     return self:runCommand("drop", co_name)
 end
@@ -409,32 +487,53 @@ function MongoDB:find_one(co_name, query, projection)
 end
 
 function MongoDB:find(co_name, query, projection, sortor, limit, skip)
-    local succ, reply = self:runCommand("find", co_name, "$readPreference", self.readpref, "filter",
-                                        query, "projection", projection or {}, "sort", sortor or {}, "limit", limit or 100, "skip", skip or 0)
+    limit = limit or 100
+    local succ, cursor = self:cursor(co_name, query, projection, sortor, limit, skip)
     if not succ then
-        return succ, reply
+        return succ, cursor
     end
     local results = {}
-    local cursor  = reply.cursor
-    while cursor do
-        local documents = cursor.firstBatch or cursor.nextBatch
-        tjoin(documents, results)
-        if not cursor.id or cursor.id == 0 then
-            break
+    while #results < limit do
+        local ok, doc = cursor:next()
+        if not ok then
+            return ok, doc
         end
-        if limit and #results >= limit then
+        if not doc then
             break
         end
-        self.cursor_id       = cursor.id
-        local msucc, moreply = self:runCommand("getMore", bson.int64(self.cursor_id), "collection", co_name)
-        if not msucc then
-            return msucc, moreply
-        end
-        cursor = moreply.cursor
+        results[#results + 1] = doc
     end
+    cursor:close()
     return true, results
 end
 
+--流式查询: 返回游标, 文档逐条解码, 适合大集合的全量扫描
+function MongoDB:cursor(co_name, query, projection, sortor, limit, skip, batch_size)
+    local sock = self.executer
+    local succ, reply = self:cursorCommand(sock, "find", co_name, "$readPreference", self.readpref, "filter", query, "projection", projection or {},
+                                           "sort", sortor or {}, "limit", limit or 0, "skip", skip or 0, "batchSize", batch_size)
+    if not succ then
+        return succ, reply
+    end
+    local cursor = reply.cursor
+    if not cursor then
+        return false, "cursor reply invalid"
+    end
+    return true, MongoCursor(self, sock, co_name, cursor, batch_size)
+end
+
+function MongoDB:get_more(sock, cursor_id, co_name, batch_size)
+    self.cursor_id = cursor_id
+    return self:cursorCommand(sock, "getMore", bson.int64(cursor_id), "collection", co_name, "batchSize", batch_size)
+end
+
+function MongoDB:kill_cursor(sock, cursor_id, co_name)
+    if sock and sock.alive then
+        return sock:send_data(0, "killCursors", co_name, "$db", self.name, "cursors", { bson.int64(cursor_id) })
+    end
+    return false
+end
+
 function MongoDB:find_and_modify(co_name, update, selector, upsert, fields, new)
     return self:runCommand("findAndModify", co_name, "query", selector, "update", update, "fields", fields, "upsert", upsert, "new", new)
 end
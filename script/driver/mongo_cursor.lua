@@ -0,0 +1,114 @@
+--mongo_cursor.lua
+--流式游标: 批次保留原始字节逐条解码, 处理当前批次时预取下一批
+local log_warn      = logger.warn
+
+local thread_mgr    = hive.get("thread_mgr")
+
+local DB_TIMEOUT    = hive.enum("NetwkTime", "DB_CALL_TIMEOUT")
+
+local MongoCursor = class()
+local prop = property(MongoCursor)
+prop:reader("id", 0)            --服务端游标id
+prop:reader("db", nil)          --所属MongoDB
+prop:reader("sock", nil)        --游标所在连接
+prop:reader("co_name", nil)     --集合名
+prop:reader("batch", nil)       --当前批次
+prop:reader("count", 0)         --已读取文档数
+prop:reader("more", nil)        --预取到的getMore结果
+prop:reader("fetching", false)  --是否正在预取
+prop:reader("waiting", nil)     --等待预取的session
+prop:accessor("batch_size", nil)    --getMore批次大小
+
+function MongoCursor:__init(db, sock, co_name, cursor, batch_size)
+    self.db         = db
+    self.sock       = sock
+    self.co_name    = co_name
+    self.batch_size = batch_size
+    self:load_batch(cursor, cursor.firstBatch)
+end
+
+function MongoCursor:load_batch(cursor, batch)
+    self.id    = cursor.id or 0
+    self.batch = batch
+    self:prefetch()
+end
+
+--后台发起getMore, 结果暂存到more
+function MongoCursor:prefetch()
+    if self.id == 0 or self.fetching then
+        return
+    end
+    self.fetching = true
+    thread_mgr:fork(function()
+        local ok, reply = self.db:get_more(self.sock, self.id, self.co_name, self.batch_size)
+        self.fetching = false
+        self.more = { ok, reply }
+        if self.waiting then
+            thread_mgr:response(self.waiting, true)
+        end
+    end)
+end
+
+--等待预取结果并切换到下一批
+function MongoCursor:next_batch()
+    if self.fetching then
+        local session_id = thread_mgr:build_session_id()
+        self.waiting = session_id
+        local ok, err = thread_mgr:yield(session_id, "mongo cursor", DB_TIMEOUT)
+        self.waiting = nil
+        if not ok then
+            self.id = 0
+            return false, err
+        end
+    end
+    local more = self.more
+    self.more = nil
+    if not more then
+        return true
+    end
+    local ok, reply = more[1], more[2]
+    if not ok then
+        self.id = 0
+        return false, reply
+    end
+    local cursor = reply.cursor
+    if not cursor then
+        self.id = 0
+        return false, "cursor reply invalid"
+    end
+    self:load_batch(cursor, cursor.nextBatch)
+    return true
+end
+
+--返回: ok, doc; doc为nil表示遍历结束
+function MongoCursor:next()
+    while self.batch do
+        local doc = self.batch.next()
+        if doc then
+            self.count = self.count + 1
+            return true, doc
+        end
+        self.batch = nil
+        if self.id == 0 and not self.more then
+            break
+        end
+        local ok, err = self:next_batch()
+        if not ok then
+            return false, err
+        end
+    end
+    return true
+end
+
+--提前结束时释放服务端游标
+function MongoCursor:close()
+    self.batch = nil
+    if self.id ~= 0 then
+        if not self.db:kill_cursor(self.sock, self.id, self.co_name) then
+            log_warn("[MongoCursor][close] kill cursor {} failed!", self.id)
+        end
+        self.id = 0
+    end
+end
+
+return MongoCursor
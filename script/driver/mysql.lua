@@ -24,6 +24,7 @@ local SECOND_MS        = hive.enum("PeriodTime", "SECOND_MS")
 local SECOND_10_MS     = hive.enum("PeriodTime", "SECOND_10_MS")
 local DB_TIMEOUT       = hive.enum("NetwkTime", "DB_CALL_TIMEOUT")
 local POOL_COUNT       = environ.number("HIVE_DB_POOL_COUNT", 3)
+local RECV_LIMIT       = 64 * 1024 * 1024  --接收缓冲上限64M
 
 -- constants
 local COM_QUERY        = 0x03
@@ -34,6 +35,9 @@ local COM_STMT_EXECUTE = 0x17
 local COM_STMT_CLOSE   = 0x19
 local COM_STMT_RESET   = 0x1a
 
+-- cmd flags
+local MYSQL_COLUMNAR   = 0x100
+
 local MysqlDB          = class()
 local prop             = property(MysqlDB)
 prop:reader("id", nil)          --id
@@ -150,6 +154,8 @@ end
 function MysqlDB:auth(socket)
     local session_id = thread_mgr:build_session_id()
     socket:set_codec(mysqlcodec(session_id))
+    --单个响应可能超过16M
+    socket:set_recv_limit(RECV_LIMIT)
     local charset, scramble1, scramble2 = thread_mgr:yield(session_id, "mysql server auth", DB_TIMEOUT)
     local scramble                      = scramble1 .. scramble2
     local stage1                        = lsha1(self.passwd)
@@ -199,6 +205,11 @@ function MysqlDB:query(query)
     return self:request(COM_QUERY, "mysql query", query)
 end
 
+--结果集的行为按列顺序的数组,列名放在结果集的columns字段,适合大批量加载
+function MysqlDB:query_columnar(query)
+    return self:request(COM_QUERY | MYSQL_COLUMNAR, "mysql query", query)
+end
+
 -- 注册预处理语句
 function MysqlDB:prepare(sql)
     return self:request(COM_STMT_PREPARE, "mysql prepare", sql)
@@ -209,6 +220,10 @@ function MysqlDB:execute(prepare_id, ...)
     return self:request(COM_STMT_EXECUTE, "mysql_execute", prepare_id, ...)
 end
 
+function MysqlDB:execute_columnar(prepare_id, ...)
+    return self:request(COM_STMT_EXECUTE | MYSQL_COLUMNAR, "mysql_execute", prepare_id, ...)
+end
+
 --重置预处理句柄
 function MysqlDB:stmt_reset(prepare_id)
     return self:request(COM_STMT_RESET, "mysql stmt_reset", prepare_id)
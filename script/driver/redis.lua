@@ -30,6 +30,10 @@ local REDIS_SLOT   = 16384
 
 local function _tomap(value)
     if (type(value) == 'table') then
+        --RESP3直接返回map
+        if #value == 0 then
+            return value
+        end
         local maps = { }
         for i = 1, #value, 2 do
             maps[value[i]] = value[i + 1]
@@ -40,7 +44,7 @@ local function _tomap(value)
 end
 
 local function _toboolean(value)
-    if value == 1 or value == 'true' or value == 'TRUE' then
+    if value == 1 or value == true or value == 'true' or value == 'TRUE' then
         return true
     end
     return false
@@ -101,6 +105,7 @@ prop:reader("req_counter", nil)
 prop:reader("res_counter", nil)
 prop:reader("subscrible", false)
 prop:reader("cluster", false)       --cluster
+prop:reader("resp3", false)         --resp3
 
 function RedisDB:__init(conf, id)
     self.id     = id
@@ -179,6 +184,10 @@ function RedisDB:set_options(opts)
         log_debug("[RedisDB][set_options] cluster status open")
         self.cluster = true
     end
+    if opts.resp3 then
+        log_debug("[RedisDB][set_options] resp3 status open")
+        self.resp3 = true
+    end
 end
 
 function RedisDB:available()
@@ -251,6 +260,15 @@ function RedisDB:login(socket)
             return false
         end
     end
+    if self.resp3 then
+        local ok, res = self:commit(socket, "HELLO", 3)
+        if not ok then
+            log_err("[RedisDB][login] hello db({}:{}:{}) failed! because: {}", ip, port, id, res)
+            self:delive(socket)
+            socket:close()
+            return false
+        end
+    end
     self.connections[id] = nil
     tinsert(self.alives, socket)
     log_info("[RedisDB][login] login db({}:{}:{}) success!", ip, port, id)
@@ -288,13 +306,13 @@ function RedisDB:on_socket_error(sock, token, err)
     end)
 end
 
-function RedisDB:on_socket_recv(sock, session_id, succ, res)
+function RedisDB:on_socket_recv(sock, session_id, succ, res, oks)
     if self.subscrible then
         self:do_socket_recv(res)
     end
     if session_id > 0 then
         self.res_counter:count_increase()
-        thread_mgr:response(session_id, succ, res)
+        thread_mgr:response(session_id, succ, res, oks)
     end
 end
 
@@ -316,6 +334,29 @@ function RedisDB:commit(socket, cmd, ...)
     return ok, res
 end
 
+--管线提交: cmds为{ {cmd, key, ...}, ... },合并成一次写入,所有回复一次解码
+--发送和收包成功时返回true, 按命令顺序的结果列表res, 以及每条命令是否成功的oks
+--失败的命令res中对应位置为错误信息, 不影响其他命令
+function RedisDB:pipeline(socket, cmds)
+    local session_id = thread_mgr:build_session_id()
+    if not socket:send_data(session_id, cmds) then
+        return false, "send request failed"
+    end
+    self.req_counter:count_increase()
+    local ok, res, oks = thread_mgr:yield(session_id, sformat("redis_pipeline:%d", #cmds), DB_TIMEOUT)
+    if not ok then
+        log_err("[RedisDB][pipeline] exec {} cmds failed: {}", #cmds, res)
+        return ok, res
+    end
+    for i, cmd in ipairs(cmds) do
+        local convertor = rconvertors[slower(cmd[1])]
+        if convertor and oks[i] then
+            res[i] = convertor(res[i])
+        end
+    end
+    return ok, res, oks
+end
+
 function RedisDB:send(cmd, key, ...)
     local sock = self:choose_node(key)
     if sock then
@@ -335,4 +376,16 @@ function RedisDB:execute(cmd, key, ...)
     return self:commit(sock, cmd, key, ...)
 end
 
+--集群模式下所有命令发往key所在的节点,由调用方保证key在同一个slot
+function RedisDB:execute_pipeline(cmds, key)
+    if #cmds == 0 then
+        return true, { n = 0 }, {}
+    end
+    local sock = self:choose_node(key or cmds[1][2])
+    if not sock then
+        return false, "db not connected"
+    end
+    return self:pipeline(sock, cmds)
+end
+
 return RedisDB
@@ -72,6 +72,13 @@ function Socket:set_codec(codec)
     end
 end
 
+--接收缓冲上限,默认16M
+function Socket:set_recv_limit(limit)
+    if self.session then
+        self.session.set_recv_limit(limit)
+    end
+end
+
 function Socket:connect(ip, port, ptype)
     if self.session then
         if self.alive then
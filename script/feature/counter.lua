@@ -67,8 +67,8 @@ function Counter:on_minute()
     end
 end
 
-function Counter:count_increase()
-    self.count = self.count + 1
+function Counter:count_increase(step)
+    self.count = self.count + (step or 1)
     if self.count > self.max then
         self.max = self.count
     end
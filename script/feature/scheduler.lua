@@ -7,6 +7,8 @@ local tunpack            = table.unpack
 local worker_call        = hive.worker_call
 local worker_broadcast   = hive.worker_broadcast
 local worker_update      = hive.worker_update
+local pool_call          = hive.worker_pool_call
+local dispatch_key       = hive.dispatch_key
 
 local FLAG_REQ           = hive.enum("FlagMask", "REQ")
 local FLAG_RES           = hive.enum("FlagMask", "RES")
@@ -39,6 +41,37 @@ function Scheduler:startup(name, entry)
     return ok
 end
 
+--启动线程池,count个线程执行相同入口,线程名为name_1...name_count
+function Scheduler:startup_pool(name, entry, count)
+    local ok, res = pcall(hive.worker_pool_startup, name, entry, count)
+    if not ok or not res then
+        log_err("[Scheduler][startup_pool] startup failed: {}", res)
+        return false
+    end
+    log_info("[Scheduler][startup_pool] startup {}*{}: {}", name, count, entry)
+    return true
+end
+
+--消息长度达到size时,参数中的table延迟到访问字段时才解码,0为关闭
+--bson/json/worker编码会自动还原延迟解码的table,其他C模块使用前需先调用hive.worker_lazy_load
+function Scheduler:lazy_decode(size)
+    hive.worker_lazy_decode(size)
+end
+
+--访问线程池,mode见DispatchMode
+function Scheduler:pool_call(name, mode, key, rpc, ...)
+    local session_id = thread_mgr:build_session_id()
+    if pool_call(name, mode, dispatch_key(key), session_id, FLAG_REQ, "master", rpc, ...) then
+        return thread_mgr:yield(session_id, rpc, THREAD_RPC_TIMEOUT)
+    end
+    return false, "call failed!"
+end
+
+--通知线程池,返回是否投递成功和目标队列积压数
+function Scheduler:pool_send(name, mode, key, rpc, ...)
+    return pool_call(name, mode, dispatch_key(key), 0, FLAG_REQ, "master", rpc, ...)
+end
+
 --访问其他线程任务
 function Scheduler:broadcast(rpc, ...)
     worker_broadcast(0, FLAG_REQ, "master", rpc, ...)
@@ -53,9 +86,9 @@ function Scheduler:call(name, rpc, ...)
     return false, "call failed!"
 end
 
---访问其他线程任务
+--访问其他线程任务,返回是否投递成功和目标队列积压数
 function Scheduler:send(name, rpc, ...)
-    worker_call(name, 0, FLAG_REQ, "master", rpc, ...)
+    return worker_call(name, 0, FLAG_REQ, "master", rpc, ...)
 end
 
 --事件分发
@@ -33,7 +33,11 @@ end
 --初始化网络
 local function init_network()
     local max_conn = environ.number("HIVE_MAX_CONN", 4096)
-    luabus.init_socket_mgr(max_conn)
+    local edge_mode = environ.status("HIVE_EDGE_MODE")
+    local io_uring = environ.status("HIVE_IO_URING")
+    luabus.init_socket_mgr(max_conn, edge_mode, io_uring)
+    --消息到达时唤醒wait
+    luabus.watch_wakeup(hive.wakeup_fd())
 end
 
 --初始化统计
@@ -117,7 +121,7 @@ hive.run = function()
     hxpcall(function()
         local sclock_ms = lclock_ms()
         hive.update()
-        luabus.wait(10)
+        luabus.wait(update_mgr:wait_ms(lclock_ms()))
         local now_ms, clock_ms = ltime()
         update_mgr:update(nil, now_ms, clock_ms)
         --时间告警
@@ -177,7 +181,21 @@ hive.call_worker = function(name, rpc, ...)
     return false, "call failed!"
 end
 
---通知其他线程
+--访问线程池
+hive.call_pool = function(name, mode, key, rpc, ...)
+    local session_id = thread_mgr:build_session_id()
+    if hive.pool_call(name, mode, hive.dispatch_key(key), session_id, FLAG_REQ, TITLE, rpc, ...) then
+        return thread_mgr:yield(session_id, rpc, THREAD_RPC_TIMEOUT)
+    end
+    return false, "call failed!"
+end
+
+--通知线程池
+hive.send_pool = function(name, mode, key, rpc, ...)
+    return hive.pool_call(name, mode, hive.dispatch_key(key), 0, FLAG_REQ, TITLE, rpc, ...)
+end
+
+--通知其他线程,返回是否投递成功和目标队列积压数
 hive.send_worker = function(name, rpc, ...)
-    hive.call(name, 0, FLAG_REQ, TITLE, rpc, ...)
+    return hive.call(name, 0, FLAG_REQ, TITLE, rpc, ...)
 end
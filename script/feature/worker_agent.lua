@@ -2,9 +2,9 @@ local send_worker = hive.send_worker
 local call_worker = hive.call_worker
 local log_err     = logger.err
 local TITLE       = hive.title
-local hhash       = hive.hash
 local scheduler   = hive.load("scheduler")
-local sformat     = string.format
+
+local DISPATCH_HASH = hive.enum("DispatchMode", "HASH")
 
 local WorkerAgent = class()
 local prop        = property(WorkerAgent)
@@ -19,9 +19,7 @@ function WorkerAgent:startup(path, thread_num)
     if scheduler then
         if thread_num and thread_num > 1 then
             self.thread_num = thread_num
-            for i = 1, self.thread_num do
-                scheduler:startup(sformat("%s_%d", self.service, i), path)
-            end
+            scheduler:startup_pool(self.service, path, thread_num)
         else
             scheduler:startup(self.service, path)
         end
@@ -50,30 +48,27 @@ function WorkerAgent:call(rpc, ...)
     return false, "can't call self!"
 end
 
-function WorkerAgent:hash_service(hash_key)
-    return sformat("%s_%d", self.service, hhash(hash_key, self.thread_num))
+--线程池派发,mode见DispatchMode
+function WorkerAgent:send_pool(mode, key, rpc, ...)
+    if scheduler then
+        return scheduler:pool_send(self.service, mode, key, rpc, ...)
+    end
+    return hive.send_pool(self.service, mode, key, rpc, ...)
 end
 
-function WorkerAgent:send_hash(hash_key, rpc, ...)
+function WorkerAgent:call_pool(mode, key, rpc, ...)
     if scheduler then
-        return scheduler:send(self:hash_service(hash_key), rpc, ...)
+        return scheduler:pool_call(self.service, mode, key, rpc, ...)
     end
-    if TITLE ~= self.service then
-        return send_worker(self:hash_service(hash_key), rpc, ...)
-    end
-    log_err("[WorkerAgent][send] why send self:{}", rpc)
-    return false, "can't send self!"
+    return hive.call_pool(self.service, mode, key, rpc, ...)
+end
+
+function WorkerAgent:send_hash(hash_key, rpc, ...)
+    return self:send_pool(DISPATCH_HASH, hash_key, rpc, ...)
 end
 
 function WorkerAgent:call_hash(hash_key, rpc, ...)
-    if scheduler then
-        return scheduler:call(self:hash_service(hash_key), rpc, ...)
-    end
-    if TITLE ~= self.service then
-        return call_worker(self:hash_service(hash_key), rpc, ...)
-    end
-    log_err("[WorkerAgent][call] why call self:{}", rpc)
-    return false, "can't call self!"
+    return self:call_pool(DISPATCH_HASH, hash_key, rpc, ...)
 end
 
 return WorkerAgent
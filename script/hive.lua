@@ -114,6 +114,17 @@ function hive.hash(key, mod)
     return hash_code(key, mod)
 end
 
+--线程池派发key: 字符串按hash_code转为整数,同一key始终派发到同一线程
+function hive.dispatch_key(key)
+    if type(key) == "number" then
+        return key
+    end
+    if key == nil then
+        return 0
+    end
+    return hash_code(key)
+end
+
 function hive.defer(handler)
     local Defer = import("feature/defer.lua")
     return Defer(handler)
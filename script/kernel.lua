@@ -31,9 +31,13 @@ end
 --初始化网络
 local function init_network()
     local max_conn = environ.number("HIVE_MAX_CONN", 4096)
+    local edge_mode = environ.status("HIVE_EDGE_MODE")
+    local io_uring = environ.status("HIVE_IO_URING")
     local rpc_key  = environ.get("HIVE_RPC_KEY", "hive2022")
-    luabus.init_socket_mgr(max_conn)
+    luabus.init_socket_mgr(max_conn, edge_mode, io_uring)
     luabus.set_rpc_key(rpc_key)
+    --worker消息到达时唤醒wait
+    luabus.watch_wakeup(hive.worker_wakeup_fd())
 end
 
 --初始化统计
@@ -187,7 +191,7 @@ end
 hive.run  = function()
     local sclock_ms = lclock_ms()
     scheduler:update()
-    luabus.wait(10)
+    luabus.wait(update_mgr:wait_ms(lclock_ms()))
     --系统更新
     local now_ms, clock_ms = ltime()
     update_mgr:update(scheduler, now_ms, clock_ms)
@@ -21,6 +21,13 @@ function EventMgr:on_frame()
     end
 end
 
+--有帧事件时下一帧立即处理
+function EventMgr:wait_ms()
+    if next(self.fevent_set) then
+        return 0
+    end
+end
+
 function EventMgr:on_second()
     local handlers = self.sevent_set
     self.sevent_set = {}
@@ -2,6 +2,7 @@
 local log_err         = logger.err
 local log_info        = logger.info
 local ipairs          = ipairs
+local mmax            = math.max
 local tpack           = table.pack
 local tunpack         = table.unpack
 local new_guid        = codec.guid_new
@@ -10,6 +11,7 @@ local lnow_ms         = timer.now_ms
 local lcron_next      = timer.cron_next
 local ltinsert        = timer.insert
 local ltupdate        = timer.update
+local lnext_expire    = timer.next_expire
 
 --定时器精度，20ms
 local TIMER_ACCURYACY = 20
@@ -57,6 +59,12 @@ function TimerMgr:on_frame(clock_ms)
     end
 end
 
+--距离下一个定时器到期的毫秒数
+function TimerMgr:wait_ms(clock_ms)
+    local ticks = mmax(lnext_expire(), 1)
+    return ticks * TIMER_ACCURYACY - self.escape_ms - (clock_ms - self.last_ms)
+end
+
 function TimerMgr:once(period, cb, ...)
     return self:register(period, period, 1, cb, ...)
 end
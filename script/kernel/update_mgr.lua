@@ -1,6 +1,7 @@
 --update_mgr.lua
 local ltime         = timer.time
 local pairs         = pairs
+local mmax          = math.max
 local odate         = os.date
 local log_info      = logger.info
 local log_warn      = logger.warn
@@ -18,6 +19,7 @@ local event_mgr     = hive.get("event_mgr")
 local gc_mgr        = hive.get("gc_mgr")
 
 local FAST_MS       = hive.enum("PeriodTime", "FAST_MS")
+local FRAME_MS      = 10
 local ServiceStatus = enum("ServiceStatus")
 
 local UpdateMgr     = singleton()
@@ -135,6 +137,22 @@ function UpdateMgr:update(scheduler, now_ms, clock_ms)
     self:update_by_time(now, clock_ms)
 end
 
+--网络等待的超时: 取快帧和各帧对象下一次需要处理的最早时间
+--帧对象可实现wait_ms(clock_ms), 返回nil表示不需要帧驱动, 未实现的按FRAME_MS轮询
+function UpdateMgr:wait_ms(clock_ms)
+    local timeout = self.next_frame - clock_ms
+    for obj in pairs(self.frame_objs) do
+        local wait_ms = FRAME_MS
+        if obj.wait_ms then
+            wait_ms = obj:wait_ms(clock_ms)
+        end
+        if wait_ms and wait_ms < timeout then
+            timeout = wait_ms
+        end
+    end
+    return mmax(timeout, 0)
+end
+
 function UpdateMgr:update_by_time(now, clock_ms)
     --5秒更新
     local time = odate("*t", now)
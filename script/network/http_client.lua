@@ -17,6 +17,8 @@ local update_mgr        = hive.get("update_mgr")
 
 local HTTP_CALL_TIMEOUT = hive.enum("NetwkTime", "HTTP_CALL_TIMEOUT")
 
+local POLL_MS           = 10
+
 local HttpClient        = singleton()
 local prop              = property(HttpClient)
 prop:reader("contexts", {})
@@ -44,6 +46,13 @@ function HttpClient:on_quit()
     curlm_mgr.destory()
 end
 
+--有请求时按POLL_MS轮询curl
+function HttpClient:wait_ms()
+    if next(self.contexts) then
+        return POLL_MS
+    end
+end
+
 function HttpClient:on_frame(clock_ms)
     if next(self.contexts) then
         curlm_mgr.update()
@@ -10,6 +10,7 @@ local b64_decode       = crypt.b64_decode
 local lz4_encode       = crypt.lz4_encode
 local lz4_decode       = crypt.lz4_decode
 local eproto_type      = luabus.eproto_type
+local lbroadcast       = luabus.broadcast_head
 
 local event_mgr        = hive.get("event_mgr")
 local thread_mgr       = hive.get("thread_mgr")
@@ -45,6 +46,7 @@ prop:reader("command_cds", {})          --CMD定制CD
 prop:accessor("coder", nil)             --编解码对象
 prop:accessor("log_client_msg", nil)    --消息日志函数
 prop:accessor("timeout", NETWORK_TIMEOUT)
+prop:accessor("reuseport", false)       --多线程共享端口(SO_REUSEPORT),每个线程独立监听
 
 function NetServer:__init(session_type)
     self.session_type = session_type
@@ -61,14 +63,14 @@ function NetServer:setup(ip, port, induce)
         return
     end
     local real_port = induce and (port + hive.index - 1) or port
-    self.listener   = luabus.listen(ip, real_port, self.proto_type)
+    self.listener   = luabus.listen(ip, real_port, self.proto_type, self.reuseport)
     if not self.listener then
         log_err("[NetServer][setup] failed to listen: {}:{} type={}", ip, real_port, self.proto_type)
         signal_quit()
         return
     end
     self.ip, self.port = ip, real_port
-    log_info("[NetServer][setup] start listen at: {}:{} type={}", ip, real_port, self.proto_type)
+    log_info("[NetServer][setup] start listen at: {}:{} type={} reuseport={}", ip, real_port, self.proto_type, self.reuseport)
     -- 安装回调
     self.listener.on_accept = function(session)
         thread_mgr:fork(function()
@@ -132,18 +134,27 @@ function NetServer:broadcast(cmd_id, data, filter)
         log_err("[NetServer][broadcast] encode failed! cmd_id:{},data:{}", cmd_id, data)
         return false
     end
-    for _, session in pairs(self.sessions) do
+    local tokens = {}
+    for token, session in pairs(self.sessions) do
         if not filter or filter(session) then
-            local send_len = session.call_head(cmd_id, pflag, 0, body)
-            if send_len > 0 then
-                proxy_agent:statistics("on_proto_send", cmd_id, send_len)
-            elseif send_len < 0 then
-                log_err("[NetServer][broadcast] call_pack failed! code:{},cmd_id:{},len:{}", send_len, cmd_id, #body)
-            end
+            tokens[#tokens + 1] = token
         end
     end
+    --在luabus中完成扇出,消息体只编码拷贝一次
+    local send_count, fails, send_len = lbroadcast(tokens, cmd_id, pflag, 0, body)
+    if send_count < 0 then
+        log_err("[NetServer][broadcast] call_pack failed! code:{},cmd_id:{},len:{}", send_count, cmd_id, #body)
+        return false
+    end
+    --按实际发送的连接数统计一次
+    if send_count > 0 then
+        proxy_agent:statistics("on_proto_send", cmd_id, send_len, send_count)
+    end
+    if #fails > 0 then
+        log_warn("[NetServer][broadcast] send failed! cmd_id:{},tokens:{}", cmd_id, fails)
+    end
     if self.log_client_msg then
-        self.log_client_msg({}, cmd_id, data, 0, #body, false)
+        self.log_client_msg({}, cmd_id, data, 0, send_len, false)
     end
     return true
 end
@@ -78,6 +78,31 @@ function MongoMgr:find(db_name, coll_name, selector, fields, sortor, limit, skip
     return MONGO_FAILED, "mongo db not exist"
 end
 
+--流式遍历: 文档逐条解码后交给handler, 返回遍历的文档数
+function MongoMgr:scan(db_name, coll_name, selector, fields, handler, batch_size)
+    local mongodb = self:get_db(db_name)
+    if mongodb then
+        local ok, cursor = mongodb:cursor(coll_name, selector, fields, nil, nil, nil, batch_size)
+        if not ok then
+            log_err("[MongoMgr][scan] execute {} failed, because: {}", tpack(coll_name, selector, fields), cursor)
+            return MONGO_FAILED, cursor
+        end
+        while true do
+            local dok, doc = cursor:next()
+            if not dok then
+                log_err("[MongoMgr][scan] execute {} failed, because: {}", tpack(coll_name, selector, fields), doc)
+                return MONGO_FAILED, doc
+            end
+            if not doc then
+                break
+            end
+            handler(doc)
+        end
+        return SUCCESS, cursor:get_count()
+    end
+    return MONGO_FAILED, "mongo db not exist"
+end
+
 function MongoMgr:find_one(db_name, coll_name, selector, fields)
     local mongodb = self:get_db(db_name)
     if mongodb then
@@ -126,6 +151,31 @@ function MongoMgr:update(db_name, coll_name, obj, selector, upsert, multi)
     return MONGO_FAILED, sformat("mongo db:%s not exist", db_name)
 end
 
+--批量写, 返回每个文档的结果(true或错误信息)
+function MongoMgr:bulk_update(db_name, coll_name, updates)
+    local mongodb = self:get_db(db_name)
+    if mongodb then
+        local ok, results = mongodb:bulk_update(coll_name, updates)
+        if not ok then
+            log_err("[MongoMgr][bulk_update] execute {} failed, count: {}", coll_name, #updates)
+        end
+        return ok and SUCCESS or MONGO_FAILED, results
+    end
+    return MONGO_FAILED, sformat("mongo db:%s not exist", db_name)
+end
+
+function MongoMgr:bulk_insert(db_name, coll_name, docs)
+    local mongodb = self:get_db(db_name)
+    if mongodb then
+        local ok, results = mongodb:bulk_insert(coll_name, docs)
+        if not ok then
+            log_err("[MongoMgr][bulk_insert] execute {} failed, count: {}", coll_name, #docs)
+        end
+        return ok and SUCCESS or MONGO_FAILED, results
+    end
+    return MONGO_FAILED, sformat("mongo db:%s not exist", db_name)
+end
+
 function MongoMgr:unsafe_update(db_name, coll_name, obj, selector, upsert, multi)
     local mongodb = self:get_db(db_name)
     if mongodb then
@@ -35,10 +35,16 @@ function MysqlMgr:get_db(db_id)
     return self.mysql_dbs[db_id or MAIN_DBID]
 end
 
-function MysqlMgr:query(db_id, primary_id, sql)
+--columnar: 行数据以数组返回
+function MysqlMgr:query(db_id, primary_id, sql, columnar)
     local mysqldb = self:get_db(db_id)
     if mysqldb and mysqldb:set_executer(primary_id) then
-        local ok, res_oe = mysqldb:query(sql)
+        local ok, res_oe
+        if columnar then
+            ok, res_oe = mysqldb:query_columnar(sql)
+        else
+            ok, res_oe = mysqldb:query(sql)
+        end
         if not ok then
             log_err("[MysqlMgr][query] query {} failed, because: {}", sql, res_oe)
         end
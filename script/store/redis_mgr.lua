@@ -59,6 +59,20 @@ function RedisMgr:execute(db_name, primary_id, cmd, ...)
     return REDIS_FAILED, sformat("redis db [%s] not exist", db_name)
 end
 
+--cmds: { {cmd, key, ...}, ... }
+--请求送达并收到回复即返回SUCCESS, 各命令是否成功见oks, 失败命令的res为错误信息
+function RedisMgr:pipeline(db_name, cmds, key)
+    local redisdb = self:get_db(db_name)
+    if redisdb then
+        local ok, res_oe, oks = redisdb:execute_pipeline(cmds, key)
+        if not ok then
+            log_err("[RedisMgr][pipeline] execute {} cmds failed, because: {}", #cmds, res_oe)
+        end
+        return ok and SUCCESS or REDIS_FAILED, res_oe, oks
+    end
+    return REDIS_FAILED, sformat("redis db [%s] not exist", db_name)
+end
+
 hive.redis_mgr = RedisMgr()
 
 return RedisMgr
@@ -2,6 +2,7 @@
 local laoi         = require("laoi")
 local mfloor      = math.floor
 local mceil       = math.ceil
+local sunpack     = string.unpack
 local log_debug   = logger.debug
 
 local AOI_WATCHER = 1  --观察者
@@ -14,9 +15,10 @@ local prop        = property(AoiModel)
 prop:reader("space", nil)
 prop:reader("event_cache", {})
 
---构造函数
-function AoiModel:__init(orginx, orginy, size)
-    self.space = laoi.create(orginx, orginy, size, 16)
+--构造函数, storage为true或"dense"时使用稠密存储的网格, "sparse"时使用稀疏网格(适合大而空旷的地图)
+--threads大于1时dense网格可以多线程批量更新
+function AoiModel:__init(orginx, orginy, size, storage, threads)
+    self.space = laoi.create(orginx, orginy, size, 16, storage, threads)
     self.space:enable_leave_event(true)
 end
 
@@ -46,6 +48,29 @@ function AoiModel:update(id, x, y, view_size)
     self:update_aoi_event()
 end
 
+--批量更新坐标: moves = {id, x, y, id, x, y, ...}, 同帧内的进出事件抵消后再派发
+function AoiModel:update_batch(moves)
+    local enters, leaves = self.space:update_batch(moves)
+    self:batch_events(enters, leaves)
+end
+
+--多线程批量更新坐标, 参数和事件同update_batch, 事件按观察者id排序
+function AoiModel:update_parallel(moves)
+    local enters, leaves = self.space:update_parallel(moves)
+    self:batch_events(enters, leaves)
+end
+
+function AoiModel:batch_events(enters, leaves)
+    for pos = 1, #leaves, 16 do
+        local watcher, marker = sunpack("<i8i8", leaves, pos)
+        self:leave_ev(watcher, marker)
+    end
+    for pos = 1, #enters, 16 do
+        local watcher, marker = sunpack("<i8i8", enters, pos)
+        self:enter_ev(watcher, marker)
+    end
+end
+
 function AoiModel:fire_event(id, eventid, fn)
     self.space:fire_event(id, eventid)
     self:update_aoi_event(fn)
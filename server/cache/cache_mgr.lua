@@ -16,6 +16,7 @@ local CacheType    = enum("CacheType")
 local PeriodTime   = enum("PeriodTime")
 
 local SUCCESS      = KernCode.SUCCESS
+local MONGO_FAILED = KernCode.MONGO_FAILED
 local CAREAD       = CacheType.READ
 local CAWRITE      = CacheType.WRITE
 
@@ -24,6 +25,7 @@ local event_mgr    = hive.get("event_mgr")
 local config_mgr   = hive.get("config_mgr")
 local update_mgr   = hive.get("update_mgr")
 local monitor      = hive.get("monitor")
+local mongo_mgr    = hive.get("mongo_mgr")
 
 local obj_table    = config_mgr:init_table("dbcache", "cache_name")
 
@@ -86,11 +88,13 @@ function CacheMgr:evt_change_service_status(status)
     if not hive.is_runing() then
         log_info("[CacheMgr][evt_change_service_status] enter flush mode,wait stop service:{}", hive.index)
         self.flush = true
+        local batches = {}
         for _, dirty_map in pairs(self.dirty_maps) do
             for _, obj in dirty_map:iterator() do
-                self:save_cache(obj)
+                self:batch_cache(batches, obj)
             end
         end
+        self:save_batches(batches)
         return
     end
     self.flush = false
@@ -124,18 +128,21 @@ end
 
 function CacheMgr:on_fast(clock_ms)
     self.save_count = 0
+    local batches = {}
     for _, dirty_map in pairs(self.dirty_maps) do
         for _, obj in dirty_map:wheel_iterator() do
             if self.flush or obj:need_save(clock_ms) then
-                self:save_cache(obj)
+                self:batch_cache(batches, obj)
             end
             --限流
             if not self.flush and self.save_count > self.save_limit then
                 log_warn("[CacheMgr][on_fast] is very busy:{}/{}", self.save_count, self.save_limit)
-                return
+                goto save
             end
         end
     end
+    ::save::
+    self:save_batches(batches)
 end
 
 --清理超时的记录
@@ -183,6 +190,46 @@ function CacheMgr:save_cache(cache_obj, remove)
     return true
 end
 
+--按库表归并待存盘对象
+function CacheMgr:batch_cache(batches, cache_obj)
+    if cache_obj:get_is_doing() then
+        return
+    end
+    local update = cache_obj:build_update()
+    if not update then
+        return
+    end
+    cache_obj:set_is_doing(true)
+    self:set_dirty(cache_obj, false)
+    local db_name, cache_table = cache_obj:get_db_name(), cache_obj:get_cache_table()
+    local key = db_name .. "." .. cache_table
+    local batch = batches[key]
+    if not batch then
+        batch = { db_name = db_name, cache_table = cache_table, objs = {}, updates = {} }
+        batches[key] = batch
+    end
+    batch.objs[#batch.objs + 1] = cache_obj
+    batch.updates[#batch.updates + 1] = update
+    self.save_count = self.save_count + 1
+end
+
+--每个库表一次批量写, 按文档结果回写各对象状态
+function CacheMgr:save_batches(batches)
+    for _, batch in pairs(batches) do
+        thread_mgr:fork(function()
+            local _, results = mongo_mgr:bulk_update(batch.db_name, batch.cache_table, batch.updates)
+            for i, obj in ipairs(batch.objs) do
+                local res = type(results) == "table" and results[i] or results
+                obj:set_is_doing(false)
+                obj:on_saved(res == true and SUCCESS or MONGO_FAILED, res)
+                if obj:is_dirty() then
+                    self:set_dirty(obj, true)
+                end
+            end
+        end)
+    end
+end
+
 --缓存加载
 function CacheMgr:load_cache_impl(cache_list, conf, primary_key)
     local cache_obj = CacheObj(conf, primary_key)
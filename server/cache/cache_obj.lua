@@ -4,7 +4,6 @@ local VarLock       = import("feature/var_lock.lua")
 
 local log_err       = logger.err
 local check_failed  = hive.failed
-local check_success = hive.success
 
 local KernCode      = enum("KernCode")
 local CacheCode     = enum("CacheCode")
@@ -103,37 +102,41 @@ function CacheObj:save()
         return false
     end
     local _lock<close> = VarLock(self, "is_doing")
-    if self.dirty then
-        if check_success(self:save_impl()) then
-            self.flush = false
-        end
+    local update = self:build_update()
+    if update then
+        local code, res = mongo_mgr:update(self.db_name, self.cache_table, update.u, update.q, true)
+        self:on_saved(code, res)
     end
     return true
 end
 
-function CacheObj:save_impl()
-    if self.dirty then
-        if self.fail_cnt > 0 and hive.now < self.retry_time then
-            return KernCode.MONGO_FAILED
-        end
-        local selector  = { [self.cache_key] = self.primary_value }
-        self.dirty      = false
-        local code, res = mongo_mgr:update(self.db_name, self.cache_table, self.data, selector, true)
-        if check_failed(code) then
-            self.fail_cnt   = self.fail_cnt + 1
-            self.retry_time = hive.now + self.fail_cnt * 60
-            log_err("[CacheObj][save_impl] failed: cnt:{}, {}=> db: {}, table: {},data:{}", self.fail_cnt, res, self.db_name, self.cache_table, self.data)
-            self.dirty = true
-            return code
-        end
-        self.fail_cnt     = 0
-        self.save_cnt     = self.save_cnt + 1
-        self.update_count = 0
-        self.update_time  = hive.clock_ms
-        self.active_tick  = hive.clock_ms
+--生成存盘的update项, 不需要存盘时返回nil
+function CacheObj:build_update()
+    if not self.dirty then
+        return
+    end
+    if self.fail_cnt > 0 and hive.now < self.retry_time then
+        return
+    end
+    self.dirty = false
+    return { q = { [self.cache_key] = self.primary_value }, u = self.data, upsert = true }
+end
+
+function CacheObj:on_saved(code, res)
+    if check_failed(code) then
+        self.fail_cnt   = self.fail_cnt + 1
+        self.retry_time = hive.now + self.fail_cnt * 60
+        log_err("[CacheObj][on_saved] failed: cnt:{}, {}=> db: {}, table: {},data:{}", self.fail_cnt, res, self.db_name, self.cache_table, self.data)
+        self.dirty = true
         return code
     end
-    return SUCCESS
+    self.flush        = false
+    self.fail_cnt     = 0
+    self.save_cnt     = self.save_cnt + 1
+    self.update_count = 0
+    self.update_time  = hive.clock_ms
+    self.active_tick  = hive.clock_ms
+    return code
 end
 
 function CacheObj:update(tab_data, flush)
@@ -23,6 +23,8 @@ hive.startup(function()
     --import("qtest/redis_test.lua")
     --import("qtest/mysql_test.lua")
     --import("qtest/aoi_test.lua")
+    --import("qtest/aoi_bench.lua")
+    --import("qtest/aoi_batch_test.lua")
     --import("qtest/zset_test.lua")
     --import("qtest/prof_test.lua")
     --import("qtest/lrandom_test.lua")
@@ -32,6 +34,8 @@ hive.startup(function()
     --import("qtest/helper_test.lua")
     --import("qtest/tcp_test.lua")
     --import("qtest/udp_test.lua")
+    --import("qtest/netio_test.lua")
+    --import("qtest/worker_test.lua")
     --import("qtest/sync_lock_test.lua")
     --import("qtest/aes_test.lua")
     --import("qtest/luaxml_test.lua")
@@ -0,0 +1,90 @@
+--aoi_batch_test.lua
+--同一组随机移动分别经过update_batch/update_parallel, 以及稠密/稀疏存储
+--每帧的进入/离开事件排序后必须和默认存储的update_batch完全一致
+local laoi      = require("laoi")
+local log_info  = logger.info
+local sformat   = string.format
+local sunpack   = string.unpack
+local tsort     = table.sort
+local tconcat   = table.concat
+local mrandom   = math.random
+local mmax      = math.max
+local mmin      = math.min
+
+local MAP_SIZE  = 2048
+local TILE_SIZE = 16
+local OBJ_COUNT = 1500
+local TICKS     = 30
+local MOVES     = 1200
+
+--事件串("<i8i8"对)排序后拼接
+local function sort_pairs(data)
+    local list = {}
+    for pos = 1, #data, 16 do
+        local watcher, marker = sunpack("<i8i8", data, pos)
+        list[#list + 1] = sformat("%d:%d", watcher, marker)
+    end
+    tsort(list)
+    return tconcat(list, ","), #list
+end
+
+local function run(storage, parallel, threads)
+    math.randomseed(2023)
+    local space = laoi.create(0, 0, MAP_SIZE, TILE_SIZE, storage, threads)
+    space:enable_leave_event(true)
+    local logs, events, xs, ys = {}, {}, {}, {}
+    local ecount = 0
+    for id = 1, OBJ_COUNT do
+        xs[id], ys[id] = mrandom(0, MAP_SIZE - 1), mrandom(0, MAP_SIZE - 1)
+        --部分对象只被观察, 视野大小不一
+        local mode = id % 5 == 0 and 2 or 3
+        local view = mode == 3 and (80 + id % 4 * 40) or 0
+        space:insert(id, xs[id], ys[id], view, view, 1, mode)
+        local count = space:update_event(events)
+        local inserts = {}
+        for i = 1, count, 3 do
+            inserts[#inserts + 1] = sformat("%d:%d:%d", events[i], events[i + 1], events[i + 2])
+        end
+        tsort(inserts)
+        logs[#logs + 1] = tconcat(inserts, ",")
+    end
+    local update = parallel and space.update_parallel or space.update_batch
+    for _ = 1, TICKS do
+        --同一帧内可能重复移动同一对象, 偶尔远距离跳跃
+        local moves = {}
+        for k = 1, MOVES do
+            local id = mrandom(1, OBJ_COUNT)
+            local step = (k % 50 == 0) and 600 or 40
+            xs[id] = mmax(0, mmin(MAP_SIZE - 1, xs[id] + mrandom(-step, step)))
+            ys[id] = mmax(0, mmin(MAP_SIZE - 1, ys[id] + mrandom(-step, step)))
+            moves[#moves + 1], moves[#moves + 2], moves[#moves + 3] = id, xs[id], ys[id]
+        end
+        local enters, leaves = update(space, moves)
+        local elog, ecnt = sort_pairs(enters)
+        local llog, lcnt = sort_pairs(leaves)
+        logs[#logs + 1], logs[#logs + 2] = elog, llog
+        ecount = ecount + ecnt + lcnt
+    end
+    laoi.release(space)
+    return logs, ecount
+end
+
+local baseline, bcount = run(false, false)
+assert(bcount > 0)
+local cases = {
+    { "dense+batch", true, false },
+    { "dense+parallel", "dense", true, 4 },
+    { "sparse+batch", "sparse", false },
+    { "sparse+parallel", "sparse", true, 4 },
+    { "list+parallel", false, true, 4 },
+}
+for _, case in ipairs(cases) do
+    local name, storage, parallel, threads = case[1], case[2], case[3], case[4]
+    local logs, ecount = run(storage, parallel, threads)
+    assert(ecount == bcount, name)
+    assert(#logs == #baseline, name)
+    for i, log in ipairs(logs) do
+        assert(log == baseline[i], sformat("%s diff at %d", name, i))
+    end
+    log_info(sformat("[aoi_batch_test] %s same as list+batch, events:%d", name, ecount))
+end
@@ -0,0 +1,130 @@
+--aoi_bench.lua
+--对比aoi两种网格存储及批量/多线程更新: 5000个同时是观察者和被观察者的对象, 每帧全部移动一次
+--多线程需要按墙上时间统计
+--另外对比稠密和稀疏网格在大而空旷地图上的格子数和耗时
+local laoi      = require("laoi")
+local log_info  = logger.info
+local sformat   = string.format
+local lclock_ms = timer.clock_ms
+local mrandom   = math.random
+
+local MAP_SIZE  = 2048
+local TILE_SIZE = 16
+local VIEW_SIZE = 200
+local OBJ_COUNT = 5000
+local TICKS     = 20
+local STEP      = 12
+--大地图: 对象集中在几个城镇
+local HUGE_SIZE = 16384
+local TOWNS     = 8
+local TOWN_SIZE = 512
+
+local function bench(dense, batch, threads)
+    math.randomseed(1234)
+    local space = laoi.create(0, 0, MAP_SIZE, TILE_SIZE, dense, threads)
+    space:enable_leave_event(true)
+    local events, xs, ys = {}, {}, {}
+    local ecount = 0
+    local start = lclock_ms()
+    for id = 1, OBJ_COUNT do
+        xs[id], ys[id] = mrandom(0, MAP_SIZE - 1), mrandom(0, MAP_SIZE - 1)
+        space:insert(id, xs[id], ys[id], VIEW_SIZE, VIEW_SIZE, 1, 3)
+        ecount = ecount + space:update_event(events) // 3
+    end
+    local insert_time = lclock_ms() - start
+    start = lclock_ms()
+    local moves = {}
+    for _ = 1, TICKS do
+        local n = 0
+        for id = 1, OBJ_COUNT do
+            local x = xs[id] + mrandom(-STEP, STEP)
+            local y = ys[id] + mrandom(-STEP, STEP)
+            if x >= 0 and x < MAP_SIZE and y >= 0 and y < MAP_SIZE then
+                xs[id], ys[id] = x, y
+                if batch then
+                    moves[n + 1], moves[n + 2], moves[n + 3] = id, x, y
+                    n = n + 3
+                else
+                    space:update(id, x, y, VIEW_SIZE, VIEW_SIZE, 1)
+                    ecount = ecount + space:update_event(events) // 3
+                end
+            end
+        end
+        if batch then
+            for i = #moves, n + 1, -1 do
+                moves[i] = nil
+            end
+            local update = threads and space.update_parallel or space.update_batch
+            local enters, leaves = update(space, moves)
+            ecount = ecount + (#enters + #leaves) // 16
+        end
+    end
+    local update_time = lclock_ms() - start
+    start = lclock_ms()
+    local found, out = 0, {}
+    for id = 1, OBJ_COUNT do
+        found = found + (space:query(xs[id], ys[id], VIEW_SIZE, VIEW_SIZE, out) or 0)
+    end
+    local query_time = lclock_ms() - start
+    for id = 1, OBJ_COUNT do
+        space:erase(id)
+    end
+    laoi.release(space)
+    log_info(sformat("[aoi_bench] %s%s%s insert:%dms update(%d ticks):%dms query:%dms events:%d found:%d",
+        dense and "dense" or "list", batch and "+batch" or "", threads and ("+threads" .. threads) or "",
+        insert_time, TICKS, update_time, query_time, ecount, found))
+end
+
+bench(false)
+bench(true)
+bench(true, true)
+bench(true, true, 4)
+
+local function bench_huge(storage)
+    math.randomseed(4321)
+    local start = lclock_ms()
+    local space = laoi.create(0, 0, HUGE_SIZE, TILE_SIZE, storage)
+    local create_time = lclock_ms() - start
+    space:enable_leave_event(true)
+    local towns, xs, ys = {}, {}, {}
+    for i = 1, TOWNS do
+        towns[i] = { mrandom(0, HUGE_SIZE - TOWN_SIZE), mrandom(0, HUGE_SIZE - TOWN_SIZE) }
+    end
+    local events = {}
+    local ecount = 0
+    start = lclock_ms()
+    for id = 1, OBJ_COUNT do
+        local town = towns[id % TOWNS + 1]
+        xs[id], ys[id] = town[1] + mrandom(0, TOWN_SIZE - 1), town[2] + mrandom(0, TOWN_SIZE - 1)
+        space:insert(id, xs[id], ys[id], VIEW_SIZE, VIEW_SIZE, 1, 3)
+        ecount = ecount + space:update_event(events) // 3
+    end
+    local insert_time = lclock_ms() - start
+    start = lclock_ms()
+    local moves = {}
+    for _ = 1, TICKS do
+        local n = 0
+        for id = 1, OBJ_COUNT do
+            local x = xs[id] + mrandom(-STEP, STEP)
+            local y = ys[id] + mrandom(-STEP, STEP)
+            if x >= 0 and x < HUGE_SIZE and y >= 0 and y < HUGE_SIZE then
+                xs[id], ys[id] = x, y
+                moves[n + 1], moves[n + 2], moves[n + 3] = id, x, y
+                n = n + 3
+            end
+        end
+        for i = #moves, n + 1, -1 do
+            moves[i] = nil
+        end
+        local enters, leaves = space:update_batch(moves)
+        ecount = ecount + (#enters + #leaves) // 16
+    end
+    local update_time = lclock_ms() - start
+    local tiles = space:tile_count()
+    laoi.release(space)
+    log_info(sformat("[aoi_bench] huge %s create:%dms insert:%dms update(%d ticks):%dms tiles:%d events:%d",
+        storage, create_time, insert_time, TICKS, update_time, tiles, ecount))
+end
+
+bench_huge("dense")
+bench_huge("sparse")
@@ -37,5 +37,89 @@ log_debug("encode-> aa: {}, {}", #es, lhex_encode(es))
 local da = ldecode(es)
 log_debug("decode-> {}", da)
 
+--encode/decode一致性
+local function table_equal(a, b)
+    if type(a) ~= "table" or type(b) ~= "table" then
+        return a == b
+    end
+    for k, v in pairs(a) do
+        if not table_equal(v, b[k]) then
+            return false
+        end
+    end
+    for k in pairs(b) do
+        if a[k] == nil then
+            return false
+        end
+    end
+    return true
+end
+
+local function check_codec(name, value)
+    local bs = lencode(value)
+    assert(table_equal(value, ldecode(bs)), name)
+    log_debug("check-> {} size: {}", name, #bs)
+end
+
+--长字符串
+check_codec("long_string", { s = string.rep("x", 70000), t = { string.rep("y", 65536) } })
+--超过255个不同的短字符串,超出的部分不再复用
+local refs = {}
+for i = 1, 300 do
+    refs["key_" .. i] = "val_" .. i
+    refs[i] = "key_" .. i
+end
+check_codec("string_ref", refs)
+--序列和hash混合
+check_codec("mixed", { 1, "a", { 2, b = 3 }, true, x = 1, [10] = "ten", [-1] = 0, [2.5] = "f", y = { "z", n = { 1 } } })
+check_codec("holes", { [2] = 1, [3] = 2, [5] = 3 })
+check_codec("empty", { {}, t = {} })
+--varint: 负数和大整数
+check_codec("varint", { -1, -240, 240, 241, 65536, -65537, 1 << 40, -(1 << 40), math.maxinteger, math.mininteger, [math.mininteger] = math.maxinteger })
+--整数数组: 各宽度,带hash部分
+local int8s, int64s = {}, { x = "x", [100] = 1 }
+for i = 1, 20 do
+    int8s[i] = i - 10
+    int64s[i] = (i % 2 == 0) and math.mininteger + i or math.maxinteger - i
+end
+check_codec("int8_array", int8s)
+check_codec("int64_array", int64s)
+check_codec("int_array_hash", { 1000, 2000, 3000, 4000, 5000, 6000, 7000, 8000, 9000, 10000, 11000, 12000, 13000, 14000, 15000, 16000, 70000, a = 1, b = { 1 }, [0] = -1 })
+check_codec("int_array_mixed", { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 1.5 })
+
+--encode/decode性能
+local function bench_codec(name, value)
+    local start = timer.clock_ms()
+    local bs
+    for _ = 1, 1000 do
+        bs = lencode(value)
+    end
+    local ecost = timer.clock_ms() - start
+    start       = timer.clock_ms()
+    local db
+    for _ = 1, 1000 do
+        db = ldecode(bs)
+    end
+    local dcost = timer.clock_ms() - start
+    log_debug("codec-> {} size: {}, encode: {}ms, decode: {}ms", name, #bs, ecost, dcost)
+    return db
+end
+
+--同构table的数组
+local items = {}
+for i = 1, 200 do
+    items[i] = { id = i, name = "item_" .. i, count = i * 3, bind = false, attrs = { 1, 2, 3, 4 } }
+end
+local db = bench_codec("items", { uid = 10001, items = items })
+assert(db.items[200].name == "item_200")
+
+--id列表
+local ids = {}
+for i = 1, 2000 do
+    ids[i] = 100000000 + i * 7
+end
+db = bench_codec("ids", { uid = 10001, ids = ids })
+assert(db.ids[2000] == ids[2000])
+
 --dump
 log_dump("dump-> a: {}", t)
\ No newline at end of file
@@ -32,3 +32,15 @@ timer_mgr:once(2000, function()
         log_debug("db find sort code: {}, v = {}", fcode, v)
     end
 end)
+
+timer_mgr:once(3000, function()
+    local scode, count = mongo_mgr:scan("default", "test_mongo_1", {}, {_id = 0}, function(doc)
+        log_debug("db scan doc: {}", doc)
+    end, 1)
+    log_debug("db scan code: {}, count = {}", scode, count)
+    local bcode, bres = mongo_mgr:bulk_update("default", "test_mongo_1", {
+        { q = {pid = 123456}, u = {pid = 123456, data = {a = 2, b = 3}}, upsert = true },
+        { q = {pid = 123459}, u = {pid = 123459, data = {a = 3, b = 4}}, upsert = true },
+    })
+    log_debug("db bulk_update code: {}, res = {}", bcode, bres)
+end)
@@ -34,4 +34,11 @@ timer_mgr:once(3000, function()
     log_debug("db select code: {}, res_oe = {}", code, res_oe)
     code, res_oe = mysql_mgr:query(MAIN_DBID, MAIN_DBID, "select count(*) as count from test_mysql where pid=123454")
     log_debug("db count code: {}, count = {}", code, res_oe)
+    code, res_oe = mysql_mgr:query(MAIN_DBID, MAIN_DBID, "select * from test_mysql", true)
+    log_debug("db select columnar code: {}, res_oe = {}", code, res_oe)
+    local stmt_id
+    code, stmt_id = mysql_mgr:prepare(MAIN_DBID, "select * from test_mysql where pid = ?")
+    log_debug("db prepare code: {}, stmt_id = {}", code, stmt_id)
+    code, res_oe = mysql_mgr:execute(MAIN_DBID, MAIN_DBID, stmt_id, 123457)
+    log_debug("db execute code: {}, res_oe = {}", code, res_oe)
 end)
\ No newline at end of file
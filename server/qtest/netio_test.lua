@@ -0,0 +1,60 @@
+--netio_test.lua
+--回环压测socket后端,对比epoll与io_uring: 分别以 --io_uring=0 / --io_uring=1 启动
+local log_info    = logger.info
+local sformat     = string.format
+
+local timer_mgr   = hive.get("timer_mgr")
+local eproto_type = luabus.eproto_type
+
+local PORT        = 36301
+local CLIENTS     = 16
+local PIPELINE    = 64
+local DURATION    = 10000
+local PAYLOAD     = string.rep("x", 256)
+
+local recv_count  = 0
+local sessions    = {}
+local clients     = {}
+
+local listener    = luabus.listen("127.0.0.1", PORT, eproto_type.head)
+listener.on_accept = function(session)
+    sessions[#sessions + 1] = session
+    session.on_call_head = function(len, cmd_id, flag, session_id, data)
+        session.call_head(cmd_id, flag, session_id, data)
+    end
+    session.on_error = function(token, err)
+        log_info("[netio] session error: {}", err)
+    end
+end
+
+for i = 1, CLIENTS do
+    local client = luabus.connect("127.0.0.1", tostring(PORT), 1000, eproto_type.head)
+    client.on_connect = function(res)
+        for k = 1, PIPELINE do
+            client.call_head(1001, 0, k, PAYLOAD)
+        end
+    end
+    --每收到一个回包再发一个,保持管线深度
+    client.on_call_head = function(len, cmd_id, flag, session_id, data)
+        recv_count = recv_count + 1
+        client.call_head(cmd_id, flag, session_id, data)
+    end
+    client.on_error = function(token, err)
+        log_info("[netio] client error: {}", err)
+    end
+    clients[i] = client
+end
+
+local start_count = 0
+timer_mgr:loop(1000, function()
+    log_info(sformat("[netio] io_uring:%s, sessions:%d, qps:%d", environ.status("HIVE_IO_URING"), #sessions, recv_count - start_count))
+    start_count = recv_count
+end)
+
+timer_mgr:once(DURATION, function()
+    log_info(sformat("[netio] io_uring:%s, total:%d, avg qps:%d", environ.status("HIVE_IO_URING"), recv_count, recv_count * 1000 // DURATION))
+    for _, client in pairs(clients) do
+        client.close()
+    end
+    listener.close()
+end)
@@ -65,4 +65,7 @@ timer_mgr:once(3000, function()
     log_debug("db zrange withscores code: {}, res = {}", code, res)
     code, res = redis_mgr:execute("default", "zrangebyscore", "zset1", 0, 2)
     log_debug("db zrange zrangebyscore code: {}, res = {}", code, res)
+    local oks
+    code, res, oks = redis_mgr:pipeline("default", { {"set", "aaa", 1}, {"incr", "aaa"}, {"hincrby", "aaa", "f", 1}, {"hgetall", "bb"}, {"exists", "aaa"} })
+    log_debug("db pipeline code: {}, res = {}, oks = {}", code, res, oks)
 end)
\ No newline at end of file
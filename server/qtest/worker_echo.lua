@@ -0,0 +1,74 @@
+--worker_echo.lua
+--worker_test的压测线程
+import("feature/worker.lua")
+
+local DISPATCH = enum("DispatchMode")
+
+local BenchMgr = singleton()
+
+function BenchMgr:__init()
+    local event_mgr = hive.get("event_mgr")
+    self.count = 0
+    self.orders = {}
+    self.disorder = 0
+    event_mgr:add_listener(self, "rpc_bench_echo")
+    event_mgr:add_listener(self, "rpc_bench_count")
+    event_mgr:add_listener(self, "rpc_bench_total")
+    event_mgr:add_listener(self, "rpc_bench_order")
+    event_mgr:add_listener(self, "rpc_bench_snapshot")
+    event_mgr:add_listener(self, "rpc_bench_reflect")
+    event_mgr:add_listener(self, "rpc_bench_encode")
+    event_mgr:add_listener(self, "rpc_bench_self")
+    --大消息延迟解码
+    hive.lazy_decode(64 * 1024)
+end
+
+function BenchMgr:rpc_bench_echo(...)
+    return ...
+end
+
+function BenchMgr:rpc_bench_count()
+    self.count = self.count + 1
+end
+
+function BenchMgr:rpc_bench_total()
+    return self.count, self.disorder, hive.title
+end
+
+--同一key的消息必须按发送顺序到达
+function BenchMgr:rpc_bench_order(key, seq)
+    local last = self.orders[key] or 0
+    if seq ~= last + 1 then
+        self.disorder = self.disorder + 1
+    end
+    self.orders[key] = seq
+end
+
+--只访问快照的少量字段
+function BenchMgr:rpc_bench_snapshot(snapshot)
+    local items = snapshot.items
+    return snapshot.id, items[#items // 2].name, #items
+end
+
+--只访问部分字段后原样返回,延迟解码的table重新编码
+function BenchMgr:rpc_bench_reflect(snapshot)
+    local items = snapshot.items
+    local _ = items[1].name
+    return snapshot
+end
+
+--hash派发回自身被拒绝, round跳过自身
+function BenchMgr:rpc_bench_self(pool, index)
+    local hash_ok = hive.send_pool(pool, DISPATCH.HASH, index - 1, "rpc_bench_echo")
+    local round_ok = hive.send_pool(pool, DISPATCH.ROUND, nil, "rpc_bench_echo")
+    return hash_ok, round_ok
+end
+
+--延迟解码的table直接交给json/bson编码
+function BenchMgr:rpc_bench_encode(snapshot)
+    return json.encode(snapshot), bson.encode(snapshot)
+end
+
+hive.startup(function()
+    hive.bench_mgr = BenchMgr()
+end)
@@ -0,0 +1,112 @@
+--worker_test.lua
+--线程间rpc压测: 固定并发的call往返 + 单向send突发
+local log_info    = logger.info
+local sformat     = string.format
+
+local timer_mgr   = hive.get("timer_mgr")
+local thread_mgr  = hive.get("thread_mgr")
+local scheduler   = hive.get("scheduler")
+
+local FLAG_REQ    = hive.enum("FlagMask", "REQ")
+
+local DISPATCH    = enum("DispatchMode")
+
+local WORKER      = "bench"
+local POOL        = "bench_pool"
+local POOL_SIZE   = 4
+local CONCURRENCY = 64
+local DURATION    = 5000
+local SEND_COUNT  = 50000
+
+scheduler:startup(WORKER, "qtest.worker_echo")
+scheduler:startup_pool(POOL, "qtest.worker_echo", POOL_SIZE)
+
+local call_count  = 0
+local running     = true
+timer_mgr:once(1000, function()
+    for _ = 1, CONCURRENCY do
+        thread_mgr:fork(function()
+            while running do
+                local ok = scheduler:call(WORKER, "rpc_bench_echo", call_count)
+                if not ok then
+                    break
+                end
+                call_count = call_count + 1
+            end
+        end)
+    end
+    timer_mgr:once(DURATION, function()
+        running = false
+        log_info(sformat("[worker_test] call qps:%d", call_count * 1000 // DURATION))
+        --单向突发投递,队列满(背压)时停止
+        local sent, pending = 0, 0
+        local start = timer.clock_ms()
+        for i = 1, SEND_COUNT do
+            local ok, backlog = hive.worker_call(WORKER, 0, FLAG_REQ, "master", "rpc_bench_count", i)
+            if not ok then
+                break
+            end
+            sent, pending = i, backlog
+        end
+        local cost = timer.clock_ms() - start
+        log_info(sformat("[worker_test] send %d cost:%dms, pending:%d", sent, cost, pending))
+        thread_mgr:fork(function()
+            local _, total = scheduler:call(WORKER, "rpc_bench_total")
+            log_info(sformat("[worker_test] worker received:%s", total))
+        end)
+    end)
+end)
+
+--大消息: 整块缓冲移交给目标线程,目标线程只解码访问到的字段
+timer_mgr:once(DURATION + 4000, function()
+    local items = {}
+    for i = 1, 5000 do
+        items[i] = { id = i, name = sformat("item_%d", i), count = i * 3, attrs = { 1, 2, 3, 4 } }
+    end
+    local snapshot = { id = 10001, name = "player", items = items }
+    thread_mgr:fork(function()
+        local start = timer.clock_ms()
+        local ok, id, name, count
+        for _ = 1, 100 do
+            ok, id, name, count = scheduler:call(WORKER, "rpc_bench_snapshot", snapshot)
+        end
+        log_info(sformat("[worker_test] snapshot x100 cost:%dms, res:%s,%s,%s,%s", timer.clock_ms() - start, ok, id, name, count))
+        --延迟解码的table重新编码后内容不变
+        local _, echo = scheduler:call(WORKER, "rpc_bench_reflect", snapshot)
+        local eitems = echo.items
+        assert(echo.id == 10001 and echo.name == "player" and #eitems == #items)
+        for i, item in ipairs(items) do
+            local eitem = eitems[i]
+            assert(eitem.id == item.id and eitem.name == item.name and eitem.count == item.count and #eitem.attrs == 4)
+        end
+        log_info("[worker_test] snapshot reflect ok")
+        --json/bson编码前还原延迟解码的table
+        local _, jstr, bstr = scheduler:call(WORKER, "rpc_bench_encode", snapshot)
+        for _, decoded in ipairs({ json.decode(jstr), bson.decode(bstr) }) do
+            assert(decoded.id == 10001 and #decoded.items == #items and decoded.items[#items].name == items[#items].name)
+        end
+        log_info("[worker_test] snapshot encode ok")
+    end)
+end)
+
+--线程池: 按key派发并校验顺序,再统计各线程的分布
+timer_mgr:once(DURATION + 2000, function()
+    for seq = 1, 1000 do
+        for key = 1, 16 do
+            scheduler:pool_send(POOL, DISPATCH.HASH, key, "rpc_bench_order", key, seq)
+        end
+    end
+    for i = 1, 4000 do
+        scheduler:pool_send(POOL, DISPATCH.ROUND, nil, "rpc_bench_count", i)
+        scheduler:pool_send(POOL, DISPATCH.IDLE, nil, "rpc_bench_count", i)
+    end
+    thread_mgr:fork(function()
+        for i = 1, POOL_SIZE do
+            local _, count, disorder, title = scheduler:call(sformat("%s_%d", POOL, i), "rpc_bench_total")
+            log_info(sformat("[worker_test] pool %s count:%s, disorder:%s", title, count, disorder))
+            assert(disorder == 0)
+            local _, hash_ok, round_ok = scheduler:call(sformat("%s_%d", POOL, i), "rpc_bench_self", POOL, i)
+            assert(not hash_ok and round_ok)
+        end
+    end)
+end)
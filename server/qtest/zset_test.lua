@@ -21,6 +21,15 @@ do
     assert(#res == 3)
     local top4 = rank:range(1, 4)
     logger.warn("top4:{}", top4)
+    local keys, scores, first = rank:range_by_rank(2, 5)
+    assert(first == 2 and #keys == 2 and keys[1] == 20 and scores[2] == 22)
+    keys, scores, first = rank:range_by_score(20, 40)
+    assert(first == 2 and #keys == 2 and keys[1] == 20 and keys[2] == 30)
+    keys, scores, first = rank:range_by_score(math.mininteger, math.maxinteger)
+    assert(first == 1 and #keys == 3 and keys[1] == 10)
+    keys, scores, first = rank:around_key(20, 1)
+    assert(first == 1 and #keys == 3 and keys[3] == 30)
+    assert(not rank:around_key(40, 1))
     local r, score, t = rank:rank(2)
     logger.debug("2 rank:{},score:{},t:{}", r, score, t)
     rank:clear()
@@ -48,6 +57,18 @@ do
     assert(#res == 3)
     local top4 = rank:range(1, 4)
     logger.warn("top4:{}", top4)
+    local keys, scores, first = rank:range_by_rank(2, 5)
+    assert(first == 2 and #keys == 2 and keys[1] == 30 and scores[2] == 33)
+    keys, scores, first = rank:range_by_score(20, 40, 1)
+    assert(first == 2 and #keys == 1 and keys[1] == 30)
+    --边界取反不能溢出
+    keys, scores, first = rank:range_by_score(math.mininteger, math.maxinteger)
+    assert(first == 1 and #keys == 3 and keys[1] == 40 and keys[3] == 20)
+    keys, scores, first = rank:range_by_score(math.mininteger, 22)
+    assert(first == 1 and #keys == 2 and keys[2] == 30)
+    assert(rank:range_by_score(math.mininteger, math.mininteger) == nil)
+    keys, scores, first = rank:around_key(40, 1)
+    assert(first == 1 and #keys == 2 and keys[2] == 30)
     local r, score, t = rank:rank(2)
     logger.debug("2 rank:{},score:{},t:{}", r, score, t)
     rank:clear()
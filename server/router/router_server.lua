@@ -19,6 +19,8 @@ local RouterServer  = singleton()
 local prop          = property(RouterServer)
 prop:accessor("rpc_server", nil)
 prop:accessor("change", false)
+prop:accessor("delay_time", 0)
+prop:accessor("delay_bytes", 0)
 function RouterServer:__init()
     self:setup()
     event_mgr:add_listener(self, "rpc_sync_router_info")
@@ -30,14 +32,18 @@ end
 
 function RouterServer:setup()
     local port      = environ.number("HIVE_ROUTER_PORT", 9001)
+    --转发写合并窗口(毫秒/字节),未配置时使用编译期默认
+    self.delay_time  = environ.number("HIVE_ROUTER_DELAY_TIME", 0)
+    self.delay_bytes = environ.number("HIVE_ROUTER_DELAY_BYTES", 0)
     --启动server
     self.rpc_server = RpcServer(self, "0.0.0.0", port, environ.status("HIVE_ADDR_INDUCE"))
     service.make_node(self.rpc_server:get_port())
     luabus.set_router_id(hive.id)
     --设置服务表
     local services = service.services()
-    for service, service_id in pairs(services) do
-        luabus.set_service_name(service_id, service)
+    for service_name, service_id in pairs(services) do
+        luabus.set_service_name(service_id, service_name)
+        luabus.set_hash_mode(service_id, service.hash_mode(service_id))
     end
 end
 
@@ -51,6 +57,9 @@ end
 --accept事件
 function RouterServer:on_client_accept(client)
     log_info("[RouterServer][on_client_accept] new connection, token={},ip:{}", client.token, client.ip)
+    if self.delay_bytes > 0 then
+        client.set_delay_send(self.delay_time, self.delay_bytes)
+    end
     client.on_forward_error     = function(session_id, error_msg)
         thread_mgr:fork(function()
             client.call(session_id, FlagMask.RES, hive.id, "on_forward_error", false, KernCode.RPC_UNREACHABLE, error_msg)
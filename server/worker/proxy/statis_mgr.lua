@@ -118,19 +118,20 @@ function StatisMgr:on_proto_recv(cmd_id, recv_len)
     self:add_local_count("recv_msg", cmd_id, recv_len)
 end
 
--- 统计proto协议接收(KB)
-function StatisMgr:on_proto_send(cmd_id, send_len)
+-- 统计proto协议接收(KB), 广播时count为发送的连接数
+function StatisMgr:on_proto_send(cmd_id, send_len, count)
+    count = count or 1
     if send_len > MaxMessageLen then
         log_err("[StatisMgr][on_proto_send] the msg is very long,cmd_id:{},len:{}", cmd_id, send_len)
     end
     if self.statis_status then
         if self.influx then
-            local fields = { count = send_len }
+            local fields = { count = send_len * count }
             self:write("network", cmd_id, "proto_send", fields)
         end
-        self.msg_send_count:count_increase()
+        self.msg_send_count:count_increase(count)
     end
-    self:add_local_count("send_msg", cmd_id, send_len)
+    self:add_local_count("send_msg", cmd_id, send_len, count)
 end
 
 -- 统计rpc协议发送(KB)
@@ -217,13 +218,14 @@ function StatisMgr:_calc_cpu_rate()
 end
 
 -- 添加本地计数
-function StatisMgr:add_local_count(name, cmd, len)
+function StatisMgr:add_local_count(name, cmd, len, count)
+    count = count or 1
     local recv_msg = self.local_counts[name][cmd]
     if not recv_msg then
-        self.local_counts[name][cmd] = { count = 1, len = len }
+        self.local_counts[name][cmd] = { count = count, len = len * count }
     else
-        recv_msg.count = recv_msg.count + 1
-        recv_msg.len   = recv_msg.len + len
+        recv_msg.count = recv_msg.count + count
+        recv_msg.len   = recv_msg.len + len * count
     end
 end
 